@@ -0,0 +1,419 @@
+/*
+ * Copyright 2013-2015 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+/*
+ * Load generator for measuring the signing and extending throughput and latency. Every
+ * worker thread uses its own KSI context, as the contexts may not be shared between threads.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#  include <time.h>
+#  include <sys/time.h>
+#endif
+
+#include <ksi/ksi.h>
+
+/* Maximum number of distinct error codes reported. */
+#define MAX_ERRORS 32
+
+enum {
+	OP_SIGN = 0,
+	OP_EXTEND,
+	OP_COUNT
+};
+
+static const char *opNames[OP_COUNT] = { "sign", "extend" };
+
+typedef struct {
+	int code;
+	unsigned long count;
+} ErrorCount;
+
+typedef struct {
+	/** Latencies of the successful operations in microseconds. */
+	double *latency;
+	size_t latency_count;
+	ErrorCount errors[MAX_ERRORS];
+	size_t errors_count;
+} OpStats;
+
+typedef struct {
+	KSI_CTX *ksi;
+	unsigned id;
+	unsigned requests;
+	int doSign;
+	int doExtend;
+	OpStats stats[OP_COUNT];
+} Worker;
+
+static double nowUs(void) {
+#ifdef _WIN32
+	LARGE_INTEGER freq, count;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+
+	return (double)count.QuadPart * 1e6 / (double)freq.QuadPart;
+#elif defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+#else
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+
+	return (double)tv.tv_sec * 1e6 + (double)tv.tv_usec;
+#endif
+}
+
+static void addError(OpStats *stats, int code, unsigned long count) {
+	size_t i;
+
+	for (i = 0; i < stats->errors_count; i++) {
+		if (stats->errors[i].code == code) {
+			stats->errors[i].count += count;
+			return;
+		}
+	}
+
+	/* Everything above the limit is reported with the last code. */
+	if (stats->errors_count == MAX_ERRORS) {
+		stats->errors[MAX_ERRORS - 1].count += count;
+		return;
+	}
+
+	stats->errors[stats->errors_count].code = code;
+	stats->errors[stats->errors_count].count = count;
+	stats->errors_count++;
+}
+
+static void record(OpStats *stats, int res, double started) {
+	if (res == KSI_OK) {
+		stats->latency[stats->latency_count++] = nowUs() - started;
+	} else {
+		addError(stats, res, 1);
+	}
+}
+
+static int createSignature(Worker *w, unsigned n, KSI_Signature **sig) {
+	int res;
+	KSI_DataHash *hsh = NULL;
+	unsigned char data[8];
+	double started;
+
+	/* Every request signs a different hash. */
+	data[0] = (unsigned char)(w->id >> 24);
+	data[1] = (unsigned char)(w->id >> 16);
+	data[2] = (unsigned char)(w->id >> 8);
+	data[3] = (unsigned char)w->id;
+	data[4] = (unsigned char)(n >> 24);
+	data[5] = (unsigned char)(n >> 16);
+	data[6] = (unsigned char)(n >> 8);
+	data[7] = (unsigned char)n;
+
+	res = KSI_DataHash_create(w->ksi, data, sizeof(data), KSI_getHashAlgorithmByName("default"), &hsh);
+	if (res != KSI_OK) goto cleanup;
+
+	started = nowUs();
+	res = KSI_Signature_create(w->ksi, hsh, sig);
+	if (w->doSign) record(&w->stats[OP_SIGN], res, started);
+
+cleanup:
+
+	KSI_DataHash_free(hsh);
+
+	return res;
+}
+
+static void runWorker(Worker *w) {
+	int res;
+	unsigned i;
+	KSI_Signature *sig = NULL;
+	KSI_Signature *ext = NULL;
+	double started;
+
+	for (i = 0; i < w->requests; i++) {
+		/* When only extending, the same signature is extended over and over again. */
+		if (sig == NULL || w->doSign) {
+			KSI_Signature_free(sig);
+			sig = NULL;
+
+			res = createSignature(w, i, &sig);
+			if (res != KSI_OK) {
+				if (!w->doSign) addError(&w->stats[OP_EXTEND], res, 1);
+				continue;
+			}
+		}
+
+		if (w->doExtend) {
+			started = nowUs();
+			res = KSI_Signature_extend(sig, w->ksi, NULL, &ext);
+			record(&w->stats[OP_EXTEND], res, started);
+
+			KSI_Signature_free(ext);
+			ext = NULL;
+		}
+	}
+
+	KSI_Signature_free(sig);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI workerThread(LPVOID arg) {
+	runWorker((Worker *)arg);
+	return 0;
+}
+#else
+static void *workerThread(void *arg) {
+	runWorker((Worker *)arg);
+	return NULL;
+}
+#endif
+
+static int cmpDouble(const void *a, const void *b) {
+	double l = *(const double *)a;
+	double r = *(const double *)b;
+
+	return (l > r) - (l < r);
+}
+
+/* Nearest-rank percentile of a sorted array. */
+static double percentile(const double *sorted, size_t count, double p) {
+	size_t rank = (size_t)(p / 100.0 * (double)count + 0.999999);
+
+	if (rank == 0) rank = 1;
+	if (rank > count) rank = count;
+
+	return sorted[rank - 1];
+}
+
+static void report(Worker *workers, unsigned threads, int op, double elapsedUs) {
+	double *all = NULL;
+	size_t all_count = 0;
+	OpStats total;
+	unsigned long failed = 0;
+	unsigned t;
+	size_t i;
+
+	memset(&total, 0, sizeof(total));
+
+	for (t = 0; t < threads; t++) {
+		all_count += workers[t].stats[op].latency_count;
+	}
+
+	all = malloc((all_count + 1) * sizeof(double));
+	if (all == NULL) {
+		fprintf(stderr, "Out of memory.\n");
+		return;
+	}
+
+	all_count = 0;
+	for (t = 0; t < threads; t++) {
+		OpStats *s = &workers[t].stats[op];
+
+		memcpy(all + all_count, s->latency, s->latency_count * sizeof(double));
+		all_count += s->latency_count;
+
+		for (i = 0; i < s->errors_count; i++) {
+			addError(&total, s->errors[i].code, s->errors[i].count);
+			failed += s->errors[i].count;
+		}
+	}
+
+	qsort(all, all_count, sizeof(double), cmpDouble);
+
+	printf("%s: %lu ok, %lu failed, %.1f req/s\n", opNames[op], (unsigned long)all_count, failed,
+			elapsedUs > 0 ? (double)all_count * 1e6 / elapsedUs : 0.0);
+
+	if (all_count > 0) {
+		printf("  latency ms: min %.2f, p50 %.2f, p90 %.2f, p99 %.2f, p999 %.2f, max %.2f\n",
+				all[0] / 1e3,
+				percentile(all, all_count, 50) / 1e3,
+				percentile(all, all_count, 90) / 1e3,
+				percentile(all, all_count, 99) / 1e3,
+				percentile(all, all_count, 99.9) / 1e3,
+				all[all_count - 1] / 1e3);
+	}
+
+	for (i = 0; i < total.errors_count; i++) {
+		printf("  error 0x%02x (%s): %lu\n", total.errors[i].code, KSI_getErrorString(total.errors[i].code), total.errors[i].count);
+	}
+
+	free(all);
+}
+
+int main(int argc, char **argv) {
+	int res = KSI_UNKNOWN_ERROR;
+	Worker *workers = NULL;
+	unsigned threads = 0;
+	unsigned requests = 0;
+	unsigned started = 0;
+	unsigned t;
+	int op;
+	const char *mode = "both";
+	double begin;
+	double elapsed;
+	KSI_uint64_t sent = 0;
+	KSI_uint64_t received = 0;
+	KSI_uint64_t sentTotal = 0;
+	KSI_uint64_t receivedTotal = 0;
+#ifdef _WIN32
+	HANDLE *ids = NULL;
+#else
+	pthread_t *ids = NULL;
+#endif
+
+	/* Handle command line parameters */
+	if (argc != 7 && argc != 8) {
+		fprintf(stderr, "Usage:\n"
+				"  %s <aggregator-uri> <extender-uri> <user> <pass> <threads> <requests-per-thread> [sign|extend|both]\n", argv[0]);
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	threads = (unsigned)atoi(argv[5]);
+	requests = (unsigned)atoi(argv[6]);
+	if (argc == 8) mode = argv[7];
+
+	if (threads == 0 || requests == 0 || (strcmp(mode, "sign") && strcmp(mode, "extend") && strcmp(mode, "both"))) {
+		fprintf(stderr, "Invalid parameters.\n");
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	workers = calloc(threads, sizeof(Worker));
+	ids = calloc(threads, sizeof(*ids));
+	if (workers == NULL || ids == NULL) {
+		fprintf(stderr, "Out of memory.\n");
+		res = KSI_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+
+	/* The contexts are created up front, as the global initialization is not thread safe. */
+	for (t = 0; t < threads; t++) {
+		Worker *w = &workers[t];
+
+		w->id = t;
+		w->requests = requests;
+		w->doSign = strcmp(mode, "extend") != 0;
+		w->doExtend = strcmp(mode, "sign") != 0;
+
+		for (op = 0; op < OP_COUNT; op++) {
+			w->stats[op].latency = malloc(requests * sizeof(double));
+			if (w->stats[op].latency == NULL) {
+				fprintf(stderr, "Out of memory.\n");
+				res = KSI_OUT_OF_MEMORY;
+				goto cleanup;
+			}
+		}
+
+		res = KSI_CTX_new(&w->ksi);
+		if (res != KSI_OK) {
+			fprintf(stderr, "Unable to create context.\n");
+			goto cleanup;
+		}
+
+		res = KSI_CTX_setAggregator(w->ksi, argv[1], argv[3], argv[4]);
+		if (res != KSI_OK) {
+			fprintf(stderr, "Unable to set aggregator.\n");
+			goto cleanup;
+		}
+
+		res = KSI_CTX_setExtender(w->ksi, argv[2], argv[3], argv[4]);
+		if (res != KSI_OK) {
+			fprintf(stderr, "Unable to set extender.\n");
+			goto cleanup;
+		}
+	}
+
+	printf("Using KSI version: '%s'\n", KSI_getVersion());
+	printf("Running %u thread(s) with %u %s request(s) each.\n", threads, requests, mode);
+
+	begin = nowUs();
+
+	for (started = 0; started < threads; started++) {
+#ifdef _WIN32
+		ids[started] = CreateThread(NULL, 0, workerThread, &workers[started], 0, NULL);
+		if (ids[started] == NULL) break;
+#else
+		if (pthread_create(&ids[started], NULL, workerThread, &workers[started]) != 0) break;
+#endif
+	}
+
+	for (t = 0; t < started; t++) {
+#ifdef _WIN32
+		WaitForSingleObject(ids[t], INFINITE);
+		CloseHandle(ids[t]);
+#else
+		pthread_join(ids[t], NULL);
+#endif
+	}
+
+	elapsed = nowUs() - begin;
+
+	if (started < threads) {
+		fprintf(stderr, "Unable to start all the threads.\n");
+		res = KSI_UNKNOWN_ERROR;
+		goto cleanup;
+	}
+
+	printf("Elapsed: %.3f s\n", elapsed / 1e6);
+
+	for (op = 0; op < OP_COUNT; op++) {
+		if (op == OP_SIGN && !workers[0].doSign) continue;
+		if (op == OP_EXTEND && !workers[0].doExtend) continue;
+		report(workers, threads, op, elapsed);
+	}
+
+	for (t = 0; t < threads; t++) {
+		KSI_CTX_getTransferredBytes(workers[t].ksi, &sent, &received);
+		sentTotal += sent;
+		receivedTotal += received;
+	}
+
+	printf("Bytes sent: %llu, received: %llu\n", (unsigned long long)sentTotal, (unsigned long long)receivedTotal);
+
+	res = KSI_OK;
+
+cleanup:
+
+	if (workers != NULL) {
+		for (t = 0; t < threads; t++) {
+			for (op = 0; op < OP_COUNT; op++) {
+				free(workers[t].stats[op].latency);
+			}
+			KSI_CTX_free(workers[t].ksi);
+		}
+	}
+
+	free(workers);
+	free(ids);
+
+	return res;
+}
@@ -24,6 +24,7 @@
 #include "internal.h"
 #include "net_http.h"
 #include "net_uri.h"
+#include "net_impl.h"
 #include "ctx_impl.h"
 #include "pkitruststore.h"
 
@@ -179,6 +180,14 @@ int KSI_CTX_new(KSI_CTX **context) {
 	}
 	ctx->errors_count = 0;
 	ctx->publicationsFile = NULL;
+	ctx->publicationsFileETag = NULL;
+	ctx->publicationsFileLastModified = NULL;
+	ctx->publicationsFileIfNoneMatch = NULL;
+	ctx->publicationsFileIfModifiedSince = NULL;
+	ctx->publicationsFileTime = 0;
+	ctx->publicationsFileTtl = 0;
+	ctx->publicationsFileReloader = NULL;
+	ctx->retiredPublicationsFiles = NULL;
 	ctx->pkiTruststore = NULL;
 	ctx->netProvider = NULL;
 	ctx->publicationCertEmail_DEPRECATED = NULL;
@@ -187,6 +196,14 @@ int KSI_CTX_new(KSI_CTX **context) {
 	ctx->loggerCtx = NULL;
 	ctx->requestCounter = 0;
 	ctx->certConstraints = NULL;
+	ctx->signCoalescer = NULL;
+	ctx->calendarCache = NULL;
+	ctx->calendarFile = NULL;
+	ctx->aggrConfig = NULL;
+	ctx->requestDeadline = 0;
+	ctx->requestTimeoutMs = 0;
+	ctx->bytesSent = 0;
+	ctx->bytesReceived = 0;
 	KSI_ERR_clearErrors(ctx);
 
 	/* Create global cleanup list as the first thing. */
@@ -287,6 +304,9 @@ static void globalCleanup(KSI_CTX *ctx) {
  */
 void KSI_CTX_free(KSI_CTX *ctx) {
 	if (ctx != NULL) {
+		/* Stop the reloading thread before anything else. */
+		KSI_PublicationsFileReloader_free(ctx->publicationsFileReloader);
+
 		/* Call cleanup methods. */
 		globalCleanup(ctx);
 
@@ -298,10 +318,18 @@ void KSI_CTX_free(KSI_CTX *ctx) {
 		KSI_PKITruststore_free(ctx->pkiTruststore);
 
 		KSI_PublicationsFile_free(ctx->publicationsFile);
+		KSI_List_free(ctx->retiredPublicationsFiles);
+		KSI_free(ctx->publicationsFileETag);
+		KSI_free(ctx->publicationsFileLastModified);
 		KSI_free(ctx->publicationCertEmail_DEPRECATED);
 
 		freeCertConstraintsArray(ctx->certConstraints);
 
+		KSI_SignCoalescer_free(ctx->signCoalescer);
+		KSI_CalendarCache_free(ctx->calendarCache);
+		KSI_CalendarFile_free(ctx->calendarFile);
+		KSI_Config_free(ctx->aggrConfig);
+
 		KSI_free(ctx);
 	}
 }
@@ -325,6 +353,8 @@ int KSI_sendSignRequest(KSI_CTX *ctx, KSI_AggregationReq *request, KSI_RequestHa
 		goto cleanup;
 	}
 
+	ctx->bytesSent += tmp->request_length;
+
 	*handle = tmp;
 	tmp = NULL;
 
@@ -356,6 +386,8 @@ int KSI_sendExtendRequest(KSI_CTX *ctx, KSI_ExtendReq *request, KSI_RequestHandl
 		goto cleanup;
 	}
 
+	ctx->bytesSent += tmp->request_length;
+
 	*handle = tmp;
 	tmp = NULL;
 
@@ -394,12 +426,60 @@ cleanup:
 
 }
 
+/**
+ * Replaces the publications file of the context with the newly received one. The replaced file
+ * is kept until the context is freed, as the verification results may refer to it.
+ */
+static int replacePublicationsFile(KSI_CTX *ctx, const unsigned char *raw, size_t raw_len, char *etag, char *lastModified) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_PublicationsFile *tmp = NULL;
+
+	res = KSI_PublicationsFile_parse(ctx, raw, raw_len, &tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	if (ctx->publicationsFile != NULL) {
+		if (ctx->retiredPublicationsFiles == NULL) {
+			res = KSI_List_new((void (*)(void *))KSI_PublicationsFile_free, &ctx->retiredPublicationsFiles);
+			if (res != KSI_OK) {
+				KSI_pushError(ctx, res, NULL);
+				goto cleanup;
+			}
+		}
+
+		res = KSI_List_append(ctx->retiredPublicationsFiles, ctx->publicationsFile);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	ctx->publicationsFile = tmp;
+	tmp = NULL;
+
+	KSI_free(ctx->publicationsFileETag);
+	KSI_free(ctx->publicationsFileLastModified);
+	ctx->publicationsFileETag = etag;
+	ctx->publicationsFileLastModified = lastModified;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_PublicationsFile_free(tmp);
+
+	return res;
+}
+
 int KSI_receivePublicationsFile(KSI_CTX *ctx, KSI_PublicationsFile **pubFile) {
 	int res = KSI_UNKNOWN_ERROR;
-	KSI_RequestHandle *handle = NULL;
-	const unsigned char *raw = NULL;
+	unsigned char *raw = NULL;
 	size_t raw_len = 0;
-	KSI_PublicationsFile *tmp = NULL;
+	char *etag = NULL;
+	char *lastModified = NULL;
+	KSI_uint64_t now;
 
 	KSI_ERR_clearErrors(ctx);
 	if (ctx == NULL || pubFile == NULL) {
@@ -407,30 +487,69 @@ int KSI_receivePublicationsFile(KSI_CTX *ctx, KSI_PublicationsFile **pubFile) {
 		goto cleanup;
 	}
 
-	/* TODO! Implement mechanism for reloading (e.g cache timeout) */
-	if (ctx->publicationsFile == NULL) {
-		KSI_LOG_debug(ctx, "Receiving publications file.");
-
-		res = KSI_sendPublicationRequest(ctx, NULL, 0, &handle);
+	if (ctx->publicationsFile != NULL && ctx->publicationsFileReloader != NULL) {
+		/* Pick up the file received by the reloading thread, if any. */
+		res = KSI_PublicationsFileReloader_take(ctx->publicationsFileReloader, &raw, &raw_len);
 		if (res != KSI_OK) {
-			KSI_pushError(ctx,res, NULL);
+			KSI_pushError(ctx, res, NULL);
 			goto cleanup;
 		}
 
-		res = KSI_RequestHandle_getResponse(handle, &raw, &raw_len);
+		if (raw != NULL && replacePublicationsFile(ctx, raw, raw_len, NULL, NULL) != KSI_OK) {
+			KSI_LOG_warn(ctx, "Unable to parse the reloaded publications file, using the previous one.");
+			KSI_ERR_clearErrors(ctx);
+		}
+	} else if (ctx->publicationsFile != NULL && ctx->publicationsFileTtl > 0) {
+		now = KSI_getTimeMs();
+		if (now - ctx->publicationsFileTime >= ctx->publicationsFileTtl) {
+			KSI_LOG_debug(ctx, "Revalidating publications file.");
+
+			/* An unreachable server is not retried before the time to live has passed again. */
+			ctx->publicationsFileTime = now;
+
+			res = KSI_fetchPublicationsFile(ctx, ctx->publicationsFileETag, ctx->publicationsFileLastModified, &raw, &raw_len, &etag, &lastModified);
+			if (res == KSI_OK && raw != NULL) {
+				res = replacePublicationsFile(ctx, raw, raw_len, etag, lastModified);
+				if (res == KSI_OK) {
+					etag = NULL;
+					lastModified = NULL;
+				}
+			}
+
+			if (res != KSI_OK) {
+				KSI_LOG_warn(ctx, "Unable to reload the publications file, using the previous one: %s", KSI_getErrorString(res));
+				KSI_ERR_clearErrors(ctx);
+			}
+		}
+	}
+
+	if (ctx->publicationsFile == NULL) {
+		KSI_LOG_debug(ctx, "Receiving publications file.");
+
+		res = KSI_fetchPublicationsFile(ctx, NULL, NULL, &raw, &raw_len, &etag, &lastModified);
 		if (res != KSI_OK) {
 			KSI_pushError(ctx,res, NULL);
 			goto cleanup;
 		}
 
-		res = KSI_PublicationsFile_parse(ctx, raw, raw_len, &tmp);
+		res = replacePublicationsFile(ctx, raw, raw_len, etag, lastModified);
 		if (res != KSI_OK) {
 			KSI_pushError(ctx,res, NULL);
 			goto cleanup;
 		}
-
-		ctx->publicationsFile = tmp;
-		tmp = NULL;
+		etag = NULL;
+		lastModified = NULL;
+
+		ctx->publicationsFileTime = KSI_getTimeMs();
+
+		/* The reloading thread does not need to download the same file again. */
+		if (ctx->publicationsFileReloader != NULL) {
+			res = KSI_PublicationsFileReloader_setValidators(ctx->publicationsFileReloader, ctx->publicationsFileETag, ctx->publicationsFileLastModified);
+			if (res != KSI_OK) {
+				KSI_pushError(ctx,res, NULL);
+				goto cleanup;
+			}
+		}
 
 		KSI_LOG_debug(ctx, "Publications file received.");
 	}
@@ -441,8 +560,9 @@ int KSI_receivePublicationsFile(KSI_CTX *ctx, KSI_PublicationsFile **pubFile) {
 
 cleanup:
 
-	KSI_RequestHandle_free(handle);
-	KSI_PublicationsFile_free(tmp);
+	KSI_free(raw);
+	KSI_free(etag);
+	KSI_free(lastModified);
 
 	return res;
 
@@ -496,6 +616,11 @@ int KSI_createSignature(KSI_CTX *ctx, KSI_DataHash *dataHash, KSI_Signature **si
 	int res = KSI_UNKNOWN_ERROR;
 	KSI_Signature *tmp = NULL;
 
+	/* The coalescer serializes the use of the context itself. */
+	if (ctx != NULL && ctx->signCoalescer != NULL) {
+		return KSI_SignCoalescer_sign(ctx->signCoalescer, dataHash, sig);
+	}
+
 	KSI_ERR_clearErrors(ctx);
 	if (ctx == NULL || dataHash == NULL || sig == NULL) {
 		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
@@ -745,6 +870,10 @@ void *KSI_calloc(size_t num, size_t size) {
 	return calloc(num, size);
 }
 
+void *KSI_realloc(void *ptr, size_t size) {
+	return realloc(ptr, size);
+}
+
 void KSI_free(void *ptr) {
 	free(ptr);
 }
@@ -793,6 +922,14 @@ int KSI_CTX_setExtender(KSI_CTX *ctx, const char *uri, const char *loginId, cons
 	return KSI_CTX_setUri(ctx, uri, loginId, key, KSI_UriClient_setExtender);
 }
 
+int KSI_CTX_addAggregator(KSI_CTX *ctx, const char *uri, const char *loginId, const char *key){
+	return KSI_CTX_setUri(ctx, uri, loginId, key, KSI_UriClient_addAggregator);
+}
+
+int KSI_CTX_addExtender(KSI_CTX *ctx, const char *uri, const char *loginId, const char *key){
+	return KSI_CTX_setUri(ctx, uri, loginId, key, KSI_UriClient_addExtender);
+}
+
 int KSI_CTX_setPublicationUrl(KSI_CTX *ctx, const char *uri){
 	return KSI_CTX_setUri(ctx, uri, uri, uri, KSI_UriClient_setPublicationUrl_wrapper);
 }
@@ -831,6 +968,33 @@ int KSI_CTX_setConnectionTimeoutSeconds(KSI_CTX *ctx, int timeout){
 	return KSI_CTX_setTimeoutSeconds(ctx, timeout, KSI_UriClient_setConnectionTimeoutSeconds);
 }
 
+int KSI_CTX_setRequestHedging(KSI_CTX *ctx, int enable){
+	int res = KSI_UNKNOWN_ERROR;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || ctx->netProvider == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	if (ctx->isCustomNetProvider){
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, "Unable to set hedging after initial network provider replacement.");
+		goto cleanup;
+	}
+
+	res = KSI_UriClient_setHedging((KSI_UriClient*)ctx->netProvider, enable);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx,res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
 int KSI_CTX_setTransferTimeoutSeconds(KSI_CTX *ctx, int timeout){
 	return KSI_CTX_setTimeoutSeconds(ctx, timeout, KSI_UriClient_setTransferTimeoutSeconds);
 }
@@ -908,6 +1072,203 @@ cleanup:
 	return res;
 }
 
+int KSI_CTX_setSignCoalescing(KSI_CTX *ctx, unsigned windowMs, size_t maxBatch) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_SignCoalescer *tmp = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	if (maxBatch > 0) {
+		res = KSI_SignCoalescer_new(ctx, windowMs, maxBatch, &tmp);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	KSI_SignCoalescer_free(ctx->signCoalescer);
+	ctx->signCoalescer = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_SignCoalescer_free(tmp);
+
+	return res;
+}
+
+int KSI_CTX_setCalendarCacheSize(KSI_CTX *ctx, size_t size) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_CalendarCache *tmp = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	if (size > 0) {
+		res = KSI_CalendarCache_new(ctx, size, &tmp);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	KSI_CalendarCache_free(ctx->calendarCache);
+	ctx->calendarCache = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_CalendarCache_free(tmp);
+
+	return res;
+}
+
+int KSI_CTX_setCalendarCacheFile(KSI_CTX *ctx, const char *path) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_CalendarFile *tmp = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	if (path != NULL) {
+		res = KSI_CalendarFile_open(ctx, path, &tmp);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	KSI_CalendarFile_free(ctx->calendarFile);
+	ctx->calendarFile = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_CalendarFile_free(tmp);
+
+	return res;
+}
+
+int KSI_CTX_setPublicationsFileTtl(KSI_CTX *ctx, KSI_uint64_t ttlMs, int background) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_PublicationsFileReloader *tmp = NULL;
+	const char *url = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	if (ttlMs > 0 && background) {
+		res = KSI_NetworkClient_getPublicationUrl(ctx->netProvider, &url);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+
+		if (url == NULL) {
+			KSI_pushError(ctx, res = KSI_PUBLICATIONS_FILE_NOT_CONFIGURED, "The publications file URL has not been configured.");
+			goto cleanup;
+		}
+
+		res = KSI_PublicationsFileReloader_new(ctx, url, ttlMs, &tmp);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+
+		if (ctx->publicationsFile != NULL) {
+			res = KSI_PublicationsFileReloader_setValidators(tmp, ctx->publicationsFileETag, ctx->publicationsFileLastModified);
+			if (res != KSI_OK) {
+				KSI_pushError(ctx, res, NULL);
+				goto cleanup;
+			}
+		}
+	}
+
+	KSI_PublicationsFileReloader_free(ctx->publicationsFileReloader);
+	ctx->publicationsFileReloader = tmp;
+	ctx->publicationsFileTtl = ttlMs;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_PublicationsFileReloader_free(tmp);
+
+	return res;
+}
+
+int KSI_CTX_setRequestDeadline(KSI_CTX *ctx, KSI_uint64_t deadlineMs) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (ctx == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	ctx->requestDeadline = deadlineMs;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_CTX_setRequestTimeoutMs(KSI_CTX *ctx, unsigned timeoutMs) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (ctx == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	ctx->requestTimeoutMs = timeoutMs;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_CTX_getTransferredBytes(KSI_CTX *ctx, KSI_uint64_t *sent, KSI_uint64_t *received) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (ctx == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	if (sent != NULL) *sent = ctx->bytesSent;
+	if (received != NULL) *received = ctx->bytesReceived;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
 int KSI_CTX_setLoggerCallback(KSI_CTX *ctx, KSI_LoggerCallback cb, void *logCtx) {
 	int res = KSI_UNKNOWN_ERROR;
 	if (ctx == NULL) {
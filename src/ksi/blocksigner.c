@@ -0,0 +1,620 @@
+/*
+ * Copyright 2013-2015 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#include <string.h>
+
+#include "internal.h"
+#include "blocksigner.h"
+#include "hashchain.h"
+
+/* The levels of the perfect subtrees, the block may contain up to 2^64 - 1 hash values. */
+#define KSI_BLOCK_SIGNER_MAX_ROOTS 64
+
+typedef struct BlockNode_st BlockNode;
+
+struct BlockNode_st {
+	/** Hash value of the node. */
+	KSI_DataHash *hash;
+	/** Aggregation level of the node, 0 for the leaves. */
+	unsigned level;
+	/** Parent node, \c NULL for the root of the tree. */
+	BlockNode *parent;
+	/** Left child node, \c NULL for the leaves. */
+	BlockNode *left;
+	/** Right child node, \c NULL for the leaves. */
+	BlockNode *right;
+	/** Next node of the block, used for freeing the nodes. */
+	BlockNode *next;
+};
+
+struct KSI_BlockSignerHandle_st {
+	KSI_BlockSigner *signer;
+	/** Leaf node of the hash value. */
+	BlockNode *leaf;
+	/** Next handle of the block. */
+	KSI_BlockSignerHandle *next;
+};
+
+struct KSI_BlockSigner_st {
+	KSI_CTX *ctx;
+	/** Hash algorithm of the local aggregation. */
+	KSI_HashAlgorithm algo_id;
+	/** Hasher reused for all the nodes. */
+	KSI_DataHasher *hasher;
+	/** All the nodes of the block. */
+	BlockNode *nodes;
+	/** Handles of the hash values in the order of adding. */
+	KSI_BlockSignerHandle *handles;
+	/** Last handle in #handles. */
+	KSI_BlockSignerHandle *lastHandle;
+	/** Number of hash values in the block. */
+	size_t count;
+	/** Roots of the perfect subtrees built so far, indexed by their level. */
+	BlockNode *roots[KSI_BLOCK_SIGNER_MAX_ROOTS];
+	/** Root of the closed block. */
+	BlockNode *root;
+	/** Signature of #root, \c NULL until the block is signed. */
+	KSI_Signature *signature;
+};
+
+static void freeBlock(KSI_BlockSigner *signer) {
+	while (signer->nodes != NULL) {
+		BlockNode *node = signer->nodes;
+		signer->nodes = node->next;
+		KSI_DataHash_free(node->hash);
+		KSI_free(node);
+	}
+
+	while (signer->handles != NULL) {
+		KSI_BlockSignerHandle *handle = signer->handles;
+		signer->handles = handle->next;
+		KSI_free(handle);
+	}
+
+	signer->lastHandle = NULL;
+	signer->count = 0;
+	memset(signer->roots, 0, sizeof(signer->roots));
+	signer->root = NULL;
+
+	KSI_Signature_free(signer->signature);
+	signer->signature = NULL;
+}
+
+static int newNode(KSI_BlockSigner *signer, KSI_DataHash *hash, unsigned level, BlockNode **node) {
+	int res = KSI_UNKNOWN_ERROR;
+	BlockNode *tmp = NULL;
+
+	tmp = KSI_new(BlockNode);
+	if (tmp == NULL) {
+		KSI_pushError(signer->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	tmp->hash = hash;
+	tmp->level = level;
+	tmp->parent = NULL;
+	tmp->left = NULL;
+	tmp->right = NULL;
+
+	tmp->next = signer->nodes;
+	signer->nodes = tmp;
+
+	*node = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(tmp);
+
+	return res;
+}
+
+/**
+ * Joins two nodes under a new parent node, the hash value of the parent is
+ * calculated the same way as by the aggregator: hash(left || right || level).
+ */
+static int joinNodes(KSI_BlockSigner *signer, BlockNode *left, BlockNode *right, BlockNode **parent) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_DataHash *hash = NULL;
+	BlockNode *tmp = NULL;
+	const unsigned char *imprint = NULL;
+	size_t imprint_len = 0;
+	unsigned level;
+	unsigned char chr_level;
+
+	level = (left->level > right->level ? left->level : right->level) + 1;
+	if (level > 0xff) {
+		KSI_pushError(signer->ctx, res = KSI_INVALID_ARGUMENT, "Aggregation level of the block exceeds 0xff.");
+		goto cleanup;
+	}
+
+	res = KSI_DataHasher_reset(signer->hasher);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_DataHash_getImprint(left->hash, &imprint, &imprint_len);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_DataHasher_add(signer->hasher, imprint, imprint_len);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_DataHash_getImprint(right->hash, &imprint, &imprint_len);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_DataHasher_add(signer->hasher, imprint, imprint_len);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	chr_level = (unsigned char)level;
+	res = KSI_DataHasher_add(signer->hasher, &chr_level, 1);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_DataHasher_close(signer->hasher, &hash);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = newNode(signer, hash, level, &tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+	hash = NULL;
+
+	tmp->left = left;
+	tmp->right = right;
+	left->parent = tmp;
+	right->parent = tmp;
+
+	*parent = tmp;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_nofree(imprint);
+	KSI_DataHash_free(hash);
+
+	return res;
+}
+
+int KSI_BlockSigner_new(KSI_CTX *ctx, KSI_HashAlgorithm algo_id, KSI_BlockSigner **signer) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_BlockSigner *tmp = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || signer == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	tmp = KSI_new(KSI_BlockSigner);
+	if (tmp == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	tmp->ctx = ctx;
+	tmp->algo_id = algo_id;
+	tmp->hasher = NULL;
+	tmp->nodes = NULL;
+	tmp->handles = NULL;
+	tmp->lastHandle = NULL;
+	tmp->count = 0;
+	memset(tmp->roots, 0, sizeof(tmp->roots));
+	tmp->root = NULL;
+	tmp->signature = NULL;
+
+	res = KSI_DataHasher_open(ctx, algo_id, &tmp->hasher);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	*signer = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_BlockSigner_free(tmp);
+
+	return res;
+}
+
+void KSI_BlockSigner_free(KSI_BlockSigner *signer) {
+	if (signer != NULL) {
+		freeBlock(signer);
+		KSI_DataHasher_free(signer->hasher);
+		KSI_free(signer);
+	}
+}
+
+int KSI_BlockSigner_add(KSI_BlockSigner *signer, KSI_DataHash *hsh, KSI_BlockSignerHandle **handle) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_BlockSignerHandle *tmp = NULL;
+	KSI_DataHash *ref = NULL;
+	BlockNode *node = NULL;
+
+	if (signer == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(signer->ctx);
+
+	if (hsh == NULL) {
+		KSI_pushError(signer->ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	if (signer->root != NULL) {
+		KSI_pushError(signer->ctx, res = KSI_INVALID_ARGUMENT, "The block is already closed.");
+		goto cleanup;
+	}
+
+	tmp = KSI_new(KSI_BlockSignerHandle);
+	if (tmp == NULL) {
+		KSI_pushError(signer->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	tmp->signer = signer;
+	tmp->leaf = NULL;
+	tmp->next = NULL;
+
+	res = KSI_DataHash_clone(hsh, &ref);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = newNode(signer, ref, 0, &node);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+	ref = NULL;
+
+	tmp->leaf = node;
+
+	/* Merge the new leaf with the perfect subtrees of equal level, like a binary counter. */
+	while (signer->roots[node->level] != NULL) {
+		BlockNode *left = signer->roots[node->level];
+
+		if (node->level + 1 >= KSI_BLOCK_SIGNER_MAX_ROOTS) {
+			KSI_pushError(signer->ctx, res = KSI_INVALID_ARGUMENT, "Too many hash values in the block.");
+			goto cleanup;
+		}
+
+		res = joinNodes(signer, left, node, &node);
+		if (res != KSI_OK) {
+			KSI_pushError(signer->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		signer->roots[left->level] = NULL;
+	}
+	signer->roots[node->level] = node;
+
+	if (signer->lastHandle == NULL) {
+		signer->handles = tmp;
+	} else {
+		signer->lastHandle->next = tmp;
+	}
+	signer->lastHandle = tmp;
+	signer->count++;
+
+	if (handle != NULL) *handle = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_DataHash_free(ref);
+	KSI_free(tmp);
+
+	return res;
+}
+
+int KSI_BlockSigner_close(KSI_BlockSigner *signer) {
+	int res = KSI_UNKNOWN_ERROR;
+	BlockNode *root = NULL;
+	size_t i;
+
+	if (signer == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(signer->ctx);
+
+	if (signer->count == 0) {
+		KSI_pushError(signer->ctx, res = KSI_INVALID_ARGUMENT, "The block is empty.");
+		goto cleanup;
+	}
+
+	if (signer->signature != NULL) {
+		KSI_pushError(signer->ctx, res = KSI_INVALID_ARGUMENT, "The block is already signed.");
+		goto cleanup;
+	}
+
+	/* Join the perfect subtrees, starting from the smallest one. A failed signing request
+	 * may be retried with the same root. */
+	if (signer->root == NULL) {
+		for (i = 0; i < KSI_BLOCK_SIGNER_MAX_ROOTS; i++) {
+			if (signer->roots[i] == NULL) continue;
+
+			if (root == NULL) {
+				root = signer->roots[i];
+			} else {
+				res = joinNodes(signer, signer->roots[i], root, &root);
+				if (res != KSI_OK) {
+					KSI_pushError(signer->ctx, res, NULL);
+					goto cleanup;
+				}
+			}
+			signer->roots[i] = NULL;
+		}
+
+		signer->root = root;
+	}
+
+	KSI_LOG_debug(signer->ctx, "Signing a block of %llu hash value(s) with root level %u.", (unsigned long long)signer->count, signer->root->level);
+
+	res = KSI_Signature_createAggregated(signer->ctx, signer->root->hash, signer->root->level, &signer->signature);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_BlockSigner_reset(KSI_BlockSigner *signer) {
+	if (signer == NULL) return KSI_INVALID_ARGUMENT;
+
+	freeBlock(signer);
+
+	return KSI_OK;
+}
+
+size_t KSI_BlockSigner_getCount(const KSI_BlockSigner *signer) {
+	return signer != NULL ? signer->count : 0;
+}
+
+/**
+ * Builds the local aggregation hash chain from the leaf to the root of the block.
+ */
+static int createLocalChain(KSI_BlockSigner *signer, BlockNode *leaf, KSI_AggregationHashChain **chain) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_AggregationHashChain *tmp = NULL;
+	KSI_LIST(KSI_HashChainLink) *links = NULL;
+	KSI_HashChainLink *link = NULL;
+	KSI_DataHash *hash = NULL;
+	KSI_Integer *integer = NULL;
+	BlockNode *node = NULL;
+
+	res = KSI_AggregationHashChain_new(signer->ctx, &tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_HashChainLinkList_new(&links);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	for (node = leaf; node->parent != NULL; node = node->parent) {
+		int isLeft = (node->parent->left == node);
+		BlockNode *sibling = isLeft ? node->parent->right : node->parent->left;
+		unsigned levelCorrection = node->parent->level - node->level - 1;
+
+		res = KSI_HashChainLink_new(signer->ctx, &link);
+		if (res != KSI_OK) {
+			KSI_pushError(signer->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		res = KSI_HashChainLink_setIsLeft(link, isLeft);
+		if (res != KSI_OK) {
+			KSI_pushError(signer->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		res = KSI_DataHash_clone(sibling->hash, &hash);
+		if (res != KSI_OK) {
+			KSI_pushError(signer->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		res = KSI_HashChainLink_setImprint(link, hash);
+		if (res != KSI_OK) {
+			KSI_pushError(signer->ctx, res, NULL);
+			goto cleanup;
+		}
+		hash = NULL;
+
+		/* The level correction compensates the lower height of an unbalanced subtree. */
+		if (levelCorrection > 0) {
+			res = KSI_Integer_new(signer->ctx, levelCorrection, &integer);
+			if (res != KSI_OK) {
+				KSI_pushError(signer->ctx, res, NULL);
+				goto cleanup;
+			}
+
+			res = KSI_HashChainLink_setLevelCorrection(link, integer);
+			if (res != KSI_OK) {
+				KSI_pushError(signer->ctx, res, NULL);
+				goto cleanup;
+			}
+			integer = NULL;
+		}
+
+		res = KSI_HashChainLinkList_append(links, link);
+		if (res != KSI_OK) {
+			KSI_pushError(signer->ctx, res, NULL);
+			goto cleanup;
+		}
+		link = NULL;
+	}
+
+	res = KSI_AggregationHashChain_setChain(tmp, links);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+	links = NULL;
+
+	res = KSI_DataHash_clone(leaf->hash, &hash);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_AggregationHashChain_setInputHash(tmp, hash);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+	hash = NULL;
+
+	res = KSI_Integer_new(signer->ctx, signer->algo_id, &integer);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_AggregationHashChain_setAggrHashId(tmp, integer);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+	integer = NULL;
+
+	*chain = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_Integer_free(integer);
+	KSI_DataHash_free(hash);
+	KSI_HashChainLink_free(link);
+	KSI_HashChainLinkList_free(links);
+	KSI_AggregationHashChain_free(tmp);
+
+	return res;
+}
+
+int KSI_BlockSignerHandle_getSignature(const KSI_BlockSignerHandle *handle, KSI_Signature **sig) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_BlockSigner *signer = NULL;
+	KSI_AggregationHashChain *chain = NULL;
+	KSI_Signature *tmp = NULL;
+
+	if (handle == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	signer = handle->signer;
+	KSI_ERR_clearErrors(signer->ctx);
+
+	if (sig == NULL) {
+		KSI_pushError(signer->ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	if (signer->signature == NULL) {
+		KSI_pushError(signer->ctx, res = KSI_INVALID_ARGUMENT, "The block has not been signed.");
+		goto cleanup;
+	}
+
+	res = KSI_Signature_clone(signer->signature, &tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(signer->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	/* A single hash value is the root of the block itself. */
+	if (handle->leaf->parent != NULL) {
+		res = createLocalChain(signer, handle->leaf, &chain);
+		if (res != KSI_OK) {
+			KSI_pushError(signer->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		res = KSI_Signature_appendAggregationChain(tmp, chain);
+		if (res != KSI_OK) {
+			KSI_pushError(signer->ctx, res, NULL);
+			goto cleanup;
+		}
+		chain = NULL;
+	}
+
+	*sig = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_nofree(signer);
+	KSI_AggregationHashChain_free(chain);
+	KSI_Signature_free(tmp);
+
+	return res;
+}
+
+int KSI_BlockSignerHandle_getHash(const KSI_BlockSignerHandle *handle, KSI_DataHash **hsh) {
+	if (handle == NULL || hsh == NULL) return KSI_INVALID_ARGUMENT;
+
+	*hsh = handle->leaf->hash;
+
+	return KSI_OK;
+}
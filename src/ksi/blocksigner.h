@@ -0,0 +1,124 @@
+/*
+ * Copyright 2013-2015 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#ifndef BLOCKSIGNER_H_
+#define BLOCKSIGNER_H_
+
+#include "ksi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+	/**
+	 * \addtogroup blocksigner KSI Block Signer
+	 * The block signer aggregates a block of hash values into a local hash tree and signs
+	 * the root of the tree with a single aggregation request. A signature for every
+	 * hash value of the block is then composed of the local aggregation hash chain of the
+	 * value and the signature of the root.
+	 * @{
+	 */
+
+	typedef struct KSI_BlockSigner_st KSI_BlockSigner;
+
+	/**
+	 * Handle of a single hash value added to the #KSI_BlockSigner. The handle belongs to the
+	 * block signer and is valid until the block signer is reset or freed.
+	 */
+	typedef struct KSI_BlockSignerHandle_st KSI_BlockSignerHandle;
+
+	/**
+	 * Constructor for an empty block signer.
+	 * \param[in]		ctx			KSI context.
+	 * \param[in]		algo_id		Hash algorithm used for the local aggregation.
+	 * \param[out]		signer		Pointer to the receiving pointer.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note The caller must free the block signer by calling #KSI_BlockSigner_free.
+	 */
+	int KSI_BlockSigner_new(KSI_CTX *ctx, KSI_HashAlgorithm algo_id, KSI_BlockSigner **signer);
+
+	/**
+	 * Cleanup method for the block signer. All the handles of the block signer are freed.
+	 * \param[in]		signer		The block signer to be freed.
+	 */
+	void KSI_BlockSigner_free(KSI_BlockSigner *signer);
+
+	/**
+	 * Adds a hash value to the block. The hash value is aggregated into the local hash tree
+	 * immediately.
+	 * \param[in]		signer		The block signer.
+	 * \param[in]		hsh			Hash value to be signed.
+	 * \param[out]		handle		Pointer to the receiving pointer of the handle, may be \c NULL.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note The hash value won't change ownership and needs to be freed. The handle must not be freed.
+	 */
+	int KSI_BlockSigner_add(KSI_BlockSigner *signer, KSI_DataHash *hsh, KSI_BlockSignerHandle **handle);
+
+	/**
+	 * Closes the block and signs the root of the local hash tree with a single request
+	 * to the aggregator. After this, no more hash values can be added to the block.
+	 * \param[in]		signer		The block signer.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \see #KSI_BlockSignerHandle_getSignature
+	 */
+	int KSI_BlockSigner_close(KSI_BlockSigner *signer);
+
+	/**
+	 * Removes all the hash values, handles and the signature from the block signer, so
+	 * it can be used for the next block.
+	 * \param[in]		signer		The block signer.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_BlockSigner_reset(KSI_BlockSigner *signer);
+
+	/**
+	 * Returns the number of hash values added to the block.
+	 * \param[in]		signer		The block signer.
+	 * \return the number of hash values in the block.
+	 */
+	size_t KSI_BlockSigner_getCount(const KSI_BlockSigner *signer);
+
+	/**
+	 * Composes the signature of the hash value of the handle. The block must be
+	 * closed by #KSI_BlockSigner_close before calling this function.
+	 * \param[in]		handle		Handle of the hash value.
+	 * \param[out]		sig			Pointer to the receiving pointer.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note Every call creates a new signature object, which must be freed by the caller
+	 * with #KSI_Signature_free.
+	 */
+	int KSI_BlockSignerHandle_getSignature(const KSI_BlockSignerHandle *handle, KSI_Signature **sig);
+
+	/**
+	 * Returns the hash value of the handle.
+	 * \param[in]		handle		Handle of the hash value.
+	 * \param[out]		hsh			Pointer to the receiving pointer.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note The returned hash value belongs to the block signer and must not be freed.
+	 */
+	int KSI_BlockSignerHandle_getHash(const KSI_BlockSignerHandle *handle, KSI_DataHash **hsh);
+
+	/**
+	 * @}
+	 */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BLOCKSIGNER_H_ */
@@ -0,0 +1,830 @@
+/*
+ * Copyright 2013-2015 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#include <string.h>
+#include <errno.h>
+
+#ifndef _WIN32
+#  include <sys/types.h>
+#  include <sys/stat.h>
+#  include <sys/mman.h>
+#  include <sys/file.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+#include "internal.h"
+#include "calendar_cache.h"
+#include "hashchain.h"
+#include "crc32.h"
+#include "ctx_impl.h"
+
+typedef struct CacheEntry_st CacheEntry;
+
+struct CacheEntry_st {
+	KSI_uint64_t aggrTime;
+	KSI_uint64_t pubTime;
+	KSI_CalendarHashChain *chain;
+	/** Next entry in the same bucket. */
+	CacheEntry *bucketNext;
+	/** Neighbours in the usage order, most recently used first. */
+	CacheEntry *prev;
+	CacheEntry *next;
+};
+
+struct KSI_CalendarCache_st {
+	KSI_CTX *ctx;
+	/** Maximum number of entries. */
+	size_t capacity;
+	/** Number of entries. */
+	size_t count;
+	/** Hash table of the entries, the number of buckets is a power of two. */
+	CacheEntry **buckets;
+	size_t buckets_len;
+	/** Most recently used entry. */
+	CacheEntry *head;
+	/** Least recently used entry. */
+	CacheEntry *tail;
+};
+
+static KSI_uint64_t hashKey(KSI_uint64_t aggrTime, KSI_uint64_t pubTime) {
+	/* The aggregation times of the chains are mostly consecutive seconds. */
+	return aggrTime ^ (pubTime << 7) ^ (pubTime >> 13);
+}
+
+static size_t bucketOf(const KSI_CalendarCache *cache, KSI_uint64_t aggrTime, KSI_uint64_t pubTime) {
+	return (size_t)hashKey(aggrTime, pubTime) & (cache->buckets_len - 1);
+}
+
+static void detach(KSI_CalendarCache *cache, CacheEntry *e) {
+	if (e->prev != NULL) e->prev->next = e->next;
+	else cache->head = e->next;
+
+	if (e->next != NULL) e->next->prev = e->prev;
+	else cache->tail = e->prev;
+
+	e->prev = NULL;
+	e->next = NULL;
+}
+
+static void pushFront(KSI_CalendarCache *cache, CacheEntry *e) {
+	e->prev = NULL;
+	e->next = cache->head;
+
+	if (cache->head != NULL) cache->head->prev = e;
+	else cache->tail = e;
+
+	cache->head = e;
+}
+
+static CacheEntry *find(KSI_CalendarCache *cache, KSI_uint64_t aggrTime, KSI_uint64_t pubTime) {
+	CacheEntry *e = cache->buckets[bucketOf(cache, aggrTime, pubTime)];
+
+	while (e != NULL && (e->aggrTime != aggrTime || e->pubTime != pubTime)) {
+		e = e->bucketNext;
+	}
+
+	return e;
+}
+
+static void removeEntry(KSI_CalendarCache *cache, CacheEntry *e) {
+	CacheEntry **p = &cache->buckets[bucketOf(cache, e->aggrTime, e->pubTime)];
+
+	while (*p != e) p = &(*p)->bucketNext;
+	*p = e->bucketNext;
+
+	detach(cache, e);
+	cache->count--;
+
+	KSI_CalendarHashChain_free(e->chain);
+	KSI_free(e);
+}
+
+int KSI_CalendarCache_new(KSI_CTX *ctx, size_t capacity, KSI_CalendarCache **cache) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_CalendarCache *tmp = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || capacity == 0 || cache == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	tmp = KSI_new(KSI_CalendarCache);
+	if (tmp == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	tmp->ctx = ctx;
+	tmp->capacity = capacity;
+	tmp->count = 0;
+	tmp->head = NULL;
+	tmp->tail = NULL;
+
+	/* Keep the load factor below one. */
+	tmp->buckets_len = 16;
+	while (tmp->buckets_len < capacity) tmp->buckets_len <<= 1;
+
+	tmp->buckets = KSI_calloc(tmp->buckets_len, sizeof(CacheEntry *));
+	if (tmp->buckets == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	*cache = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_CalendarCache_free(tmp);
+
+	return res;
+}
+
+void KSI_CalendarCache_free(KSI_CalendarCache *cache) {
+	CacheEntry *e = NULL;
+
+	if (cache != NULL) {
+		while ((e = cache->head) != NULL) {
+			cache->head = e->next;
+			KSI_CalendarHashChain_free(e->chain);
+			KSI_free(e);
+		}
+		KSI_free(cache->buckets);
+		KSI_free(cache);
+	}
+}
+
+int KSI_CalendarCache_get(KSI_CalendarCache *cache, const KSI_Integer *aggrTime, const KSI_Integer *pubTime, KSI_CalendarHashChain **chain) {
+	int res = KSI_UNKNOWN_ERROR;
+	CacheEntry *e = NULL;
+
+	if (cache == NULL || aggrTime == NULL || pubTime == NULL || chain == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	*chain = NULL;
+
+	e = find(cache, KSI_Integer_getUInt64(aggrTime), KSI_Integer_getUInt64(pubTime));
+	if (e != NULL) {
+		res = KSI_CalendarHashChain_ref(e->chain);
+		if (res != KSI_OK) goto cleanup;
+
+		detach(cache, e);
+		pushFront(cache, e);
+
+		*chain = e->chain;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_CalendarCache_put(KSI_CalendarCache *cache, KSI_CalendarHashChain *chain) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_Integer *aggrTime = NULL;
+	KSI_Integer *pubTime = NULL;
+	CacheEntry *e = NULL;
+	size_t bucket;
+
+	if (cache == NULL || chain == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	res = KSI_CalendarHashChain_getAggregationTime(chain, &aggrTime);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_CalendarHashChain_getPublicationTime(chain, &pubTime);
+	if (res != KSI_OK) goto cleanup;
+
+	/* Only the chains with both times present can be looked up. */
+	if (aggrTime == NULL || pubTime == NULL) {
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	e = find(cache, KSI_Integer_getUInt64(aggrTime), KSI_Integer_getUInt64(pubTime));
+	if (e != NULL) {
+		removeEntry(cache, e);
+		e = NULL;
+	}
+
+	if (cache->count == cache->capacity) {
+		removeEntry(cache, cache->tail);
+	}
+
+	e = KSI_new(CacheEntry);
+	if (e == NULL) {
+		res = KSI_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+
+	res = KSI_CalendarHashChain_ref(chain);
+	if (res != KSI_OK) goto cleanup;
+
+	e->aggrTime = KSI_Integer_getUInt64(aggrTime);
+	e->pubTime = KSI_Integer_getUInt64(pubTime);
+	e->chain = chain;
+
+	bucket = bucketOf(cache, e->aggrTime, e->pubTime);
+	e->bucketNext = cache->buckets[bucket];
+	cache->buckets[bucket] = e;
+
+	pushFront(cache, e);
+	cache->count++;
+	e = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(e);
+
+	return res;
+}
+
+/* The calendar file starts with the magic followed by a reserved word. Every record consists of
+ * the length of the chain, the aggregation and publication times, the serialized calendar hash
+ * chain and a CRC32 of all the preceding fields of the record. The integers are big-endian. */
+#define CALENDAR_FILE_MAGIC "KSICALC1"
+#define CALENDAR_FILE_HEADER_LEN 12
+#define CALENDAR_RECORD_HEADER_LEN 20
+#define CALENDAR_RECORD_CRC_LEN 4
+
+typedef struct FileEntry_st FileEntry;
+
+struct FileEntry_st {
+	KSI_uint64_t aggrTime;
+	KSI_uint64_t pubTime;
+	/** Offset and length of the serialized chain in the file. */
+	size_t offset;
+	size_t len;
+	FileEntry *bucketNext;
+};
+
+struct KSI_CalendarFile_st {
+	KSI_CTX *ctx;
+	int fd;
+	/** Read-only mapping of the file. */
+	unsigned char *map;
+	size_t map_len;
+	/** End of the last indexed record. */
+	size_t end;
+	/** Index of the records, the number of buckets is a power of two. */
+	FileEntry **buckets;
+	size_t buckets_len;
+	size_t count;
+};
+
+static void writeUInt(unsigned char *buf, KSI_uint64_t val, size_t len) {
+	while (len-- > 0) {
+		buf[len] = (unsigned char)(val & 0xff);
+		val >>= 8;
+	}
+}
+
+static KSI_uint64_t readUInt(const unsigned char *buf, size_t len) {
+	KSI_uint64_t val = 0;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		val = (val << 8) | buf[i];
+	}
+
+	return val;
+}
+
+static FileEntry *findRecord(KSI_CalendarFile *file, KSI_uint64_t aggrTime, KSI_uint64_t pubTime) {
+	FileEntry *e = file->buckets[(size_t)hashKey(aggrTime, pubTime) & (file->buckets_len - 1)];
+
+	while (e != NULL && (e->aggrTime != aggrTime || e->pubTime != pubTime)) {
+		e = e->bucketNext;
+	}
+
+	return e;
+}
+
+static int addRecord(KSI_CalendarFile *file, KSI_uint64_t aggrTime, KSI_uint64_t pubTime, size_t offset, size_t len) {
+	int res = KSI_UNKNOWN_ERROR;
+	FileEntry *e = NULL;
+	FileEntry **buckets = NULL;
+	size_t buckets_len;
+	size_t i;
+	size_t bucket;
+
+	/* The file is append-only, keep the first of the duplicate records. */
+	if (findRecord(file, aggrTime, pubTime) != NULL) {
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	/* Double the index when it is full. */
+	if (file->count == file->buckets_len) {
+		buckets_len = file->buckets_len << 1;
+		buckets = KSI_calloc(buckets_len, sizeof(FileEntry *));
+		if (buckets == NULL) {
+			res = KSI_OUT_OF_MEMORY;
+			goto cleanup;
+		}
+
+		for (i = 0; i < file->buckets_len; i++) {
+			while ((e = file->buckets[i]) != NULL) {
+				file->buckets[i] = e->bucketNext;
+				bucket = (size_t)hashKey(e->aggrTime, e->pubTime) & (buckets_len - 1);
+				e->bucketNext = buckets[bucket];
+				buckets[bucket] = e;
+			}
+		}
+
+		KSI_free(file->buckets);
+		file->buckets = buckets;
+		file->buckets_len = buckets_len;
+		buckets = NULL;
+	}
+
+	e = KSI_new(FileEntry);
+	if (e == NULL) {
+		res = KSI_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+
+	e->aggrTime = aggrTime;
+	e->pubTime = pubTime;
+	e->offset = offset;
+	e->len = len;
+
+	bucket = (size_t)hashKey(aggrTime, pubTime) & (file->buckets_len - 1);
+	e->bucketNext = file->buckets[bucket];
+	file->buckets[bucket] = e;
+	file->count++;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(buckets);
+
+	return res;
+}
+
+#ifndef _WIN32
+
+static int lockFile(KSI_CalendarFile *file, int operation) {
+	while (flock(file->fd, operation) != 0) {
+		if (errno != EINTR) return KSI_IO_ERROR;
+	}
+	return KSI_OK;
+}
+
+/* Maps the current contents of the file and indexes the records appended since the last call.
+ * The caller must hold a lock on the file. */
+static int refresh(KSI_CalendarFile *file) {
+	int res = KSI_UNKNOWN_ERROR;
+	struct stat st;
+	void *map = NULL;
+	size_t size;
+	size_t len;
+	const unsigned char *rec = NULL;
+
+	if (fstat(file->fd, &st) != 0) {
+		KSI_pushError(file->ctx, res = KSI_IO_ERROR, "Unable to stat the calendar file.");
+		goto cleanup;
+	}
+
+	size = (size_t)st.st_size;
+	if (size < file->end) {
+		KSI_pushError(file->ctx, res = KSI_INVALID_FORMAT, "The calendar file has been truncated.");
+		goto cleanup;
+	}
+
+	if (size != file->map_len) {
+		if (file->map != NULL) munmap(file->map, file->map_len);
+		file->map = NULL;
+		file->map_len = 0;
+
+		if (size > 0) {
+			map = mmap(NULL, size, PROT_READ, MAP_SHARED, file->fd, 0);
+			if (map == MAP_FAILED) {
+				KSI_pushError(file->ctx, res = KSI_IO_ERROR, "Unable to map the calendar file.");
+				goto cleanup;
+			}
+			file->map = map;
+			file->map_len = size;
+		}
+	}
+
+	if (file->end == 0 && size >= CALENDAR_FILE_HEADER_LEN) {
+		if (memcmp(file->map, CALENDAR_FILE_MAGIC, strlen(CALENDAR_FILE_MAGIC)) != 0) {
+			KSI_pushError(file->ctx, res = KSI_INVALID_FORMAT, "Not a calendar file.");
+			goto cleanup;
+		}
+		file->end = CALENDAR_FILE_HEADER_LEN;
+	}
+
+	/* Stop at the first incomplete or damaged record, it is left behind by a crashed writer. */
+	while (file->end > 0 && size - file->end >= CALENDAR_RECORD_HEADER_LEN + CALENDAR_RECORD_CRC_LEN) {
+		rec = file->map + file->end;
+		len = (size_t)readUInt(rec, 4);
+
+		if (len > size - file->end - CALENDAR_RECORD_HEADER_LEN - CALENDAR_RECORD_CRC_LEN) break;
+		if (KSI_crc32(rec, CALENDAR_RECORD_HEADER_LEN + len, 0) != readUInt(rec + CALENDAR_RECORD_HEADER_LEN + len, CALENDAR_RECORD_CRC_LEN)) break;
+
+		res = addRecord(file, readUInt(rec + 4, 8), readUInt(rec + 12, 8), file->end + CALENDAR_RECORD_HEADER_LEN, len);
+		if (res != KSI_OK) {
+			KSI_pushError(file->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		file->end += CALENDAR_RECORD_HEADER_LEN + len + CALENDAR_RECORD_CRC_LEN;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+static int writeAll(int fd, const unsigned char *buf, size_t len, size_t offset) {
+	ssize_t c;
+
+	while (len > 0) {
+		c = pwrite(fd, buf, len, (off_t)offset);
+		if (c < 0) {
+			if (errno == EINTR) continue;
+			return KSI_IO_ERROR;
+		}
+		buf += c;
+		len -= (size_t)c;
+		offset += (size_t)c;
+	}
+
+	return KSI_OK;
+}
+
+#endif
+
+int KSI_CalendarFile_open(KSI_CTX *ctx, const char *path, KSI_CalendarFile **file) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_CalendarFile *tmp = NULL;
+#ifndef _WIN32
+	unsigned char header[CALENDAR_FILE_HEADER_LEN];
+	struct stat st;
+	int locked = 0;
+#endif
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || path == NULL || file == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+#ifdef _WIN32
+	KSI_pushError(ctx, res = KSI_UNKNOWN_ERROR, "The calendar file is not supported on this platform.");
+	goto cleanup;
+#else
+	tmp = KSI_new(KSI_CalendarFile);
+	if (tmp == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	tmp->ctx = ctx;
+	tmp->fd = -1;
+	tmp->map = NULL;
+	tmp->map_len = 0;
+	tmp->end = 0;
+	tmp->count = 0;
+	tmp->buckets_len = 64;
+
+	tmp->buckets = KSI_calloc(tmp->buckets_len, sizeof(FileEntry *));
+	if (tmp->buckets == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	tmp->fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (tmp->fd < 0) {
+		KSI_pushError(ctx, res = KSI_IO_ERROR, "Unable to open the calendar file.");
+		goto cleanup;
+	}
+
+	res = lockFile(tmp, LOCK_EX);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, "Unable to lock the calendar file.");
+		goto cleanup;
+	}
+	locked = 1;
+
+	if (fstat(tmp->fd, &st) != 0) {
+		KSI_pushError(ctx, res = KSI_IO_ERROR, "Unable to stat the calendar file.");
+		goto cleanup;
+	}
+
+	/* An empty file has just been created, a shorter header is left by a crashed writer. */
+	if (st.st_size < CALENDAR_FILE_HEADER_LEN) {
+		memset(header, 0, sizeof(header));
+		memcpy(header, CALENDAR_FILE_MAGIC, strlen(CALENDAR_FILE_MAGIC));
+
+		if (ftruncate(tmp->fd, 0) != 0 || writeAll(tmp->fd, header, sizeof(header), 0) != KSI_OK) {
+			KSI_pushError(ctx, res = KSI_IO_ERROR, "Unable to write the calendar file.");
+			goto cleanup;
+		}
+	}
+
+	res = refresh(tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	lockFile(tmp, LOCK_UN);
+	locked = 0;
+
+	*file = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+#endif
+
+cleanup:
+
+#ifndef _WIN32
+	if (locked) lockFile(tmp, LOCK_UN);
+#endif
+	KSI_CalendarFile_free(tmp);
+
+	return res;
+}
+
+void KSI_CalendarFile_free(KSI_CalendarFile *file) {
+	FileEntry *e = NULL;
+	size_t i;
+
+	if (file != NULL) {
+		for (i = 0; file->buckets != NULL && i < file->buckets_len; i++) {
+			while ((e = file->buckets[i]) != NULL) {
+				file->buckets[i] = e->bucketNext;
+				KSI_free(e);
+			}
+		}
+#ifndef _WIN32
+		if (file->map != NULL) munmap(file->map, file->map_len);
+		if (file->fd >= 0) close(file->fd);
+#endif
+		KSI_free(file->buckets);
+		KSI_free(file);
+	}
+}
+
+int KSI_CalendarFile_get(KSI_CalendarFile *file, const KSI_Integer *aggrTime, const KSI_Integer *pubTime, KSI_CalendarHashChain **chain) {
+	int res = KSI_UNKNOWN_ERROR;
+	FileEntry *e = NULL;
+	KSI_CalendarHashChain *tmp = NULL;
+	KSI_Integer *chainAggrTime = NULL;
+	KSI_Integer *chainPubTime = NULL;
+
+	if (file == NULL || aggrTime == NULL || pubTime == NULL || chain == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(file->ctx);
+
+	*chain = NULL;
+
+#ifndef _WIN32
+	e = findRecord(file, KSI_Integer_getUInt64(aggrTime), KSI_Integer_getUInt64(pubTime));
+	if (e == NULL) {
+		/* Pick up the records appended by the other processes. */
+		res = lockFile(file, LOCK_SH);
+		if (res != KSI_OK) {
+			KSI_pushError(file->ctx, res, "Unable to lock the calendar file.");
+			goto cleanup;
+		}
+
+		res = refresh(file);
+		lockFile(file, LOCK_UN);
+		if (res != KSI_OK) goto cleanup;
+
+		e = findRecord(file, KSI_Integer_getUInt64(aggrTime), KSI_Integer_getUInt64(pubTime));
+	}
+#endif
+
+	if (e != NULL) {
+		res = KSI_CalendarHashChain_parse(file->ctx, file->map + e->offset, e->len, &tmp);
+		if (res != KSI_OK) {
+			KSI_pushError(file->ctx, res, "Unable to parse the calendar hash chain from the calendar file.");
+			goto cleanup;
+		}
+
+		res = KSI_CalendarHashChain_getAggregationTime(tmp, &chainAggrTime);
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_CalendarHashChain_getPublicationTime(tmp, &chainPubTime);
+		if (res != KSI_OK) goto cleanup;
+
+		if (!KSI_Integer_equals(chainAggrTime, aggrTime) || !KSI_Integer_equals(chainPubTime, pubTime)) {
+			KSI_pushError(file->ctx, res = KSI_INVALID_FORMAT, "Calendar file record does not match its key.");
+			goto cleanup;
+		}
+
+		*chain = tmp;
+		tmp = NULL;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_CalendarHashChain_free(tmp);
+
+	return res;
+}
+
+int KSI_CalendarFile_put(KSI_CalendarFile *file, KSI_CalendarHashChain *chain) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_Integer *aggrTime = NULL;
+	KSI_Integer *pubTime = NULL;
+	unsigned char *buf = NULL;
+	size_t len;
+	int locked = 0;
+
+	if (file == NULL || chain == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(file->ctx);
+
+	res = KSI_CalendarHashChain_getAggregationTime(chain, &aggrTime);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_CalendarHashChain_getPublicationTime(chain, &pubTime);
+	if (res != KSI_OK) goto cleanup;
+
+	/* Only the chains with both times present can be looked up. */
+	if (aggrTime == NULL || pubTime == NULL || findRecord(file, KSI_Integer_getUInt64(aggrTime), KSI_Integer_getUInt64(pubTime)) != NULL) {
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+#ifdef _WIN32
+	res = KSI_UNKNOWN_ERROR;
+	goto cleanup;
+#else
+	res = KSI_CalendarHashChain_writeBytes(chain, NULL, 0, &len, 0);
+	if (res != KSI_OK) {
+		KSI_pushError(file->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	buf = KSI_malloc(CALENDAR_RECORD_HEADER_LEN + len + CALENDAR_RECORD_CRC_LEN);
+	if (buf == NULL) {
+		KSI_pushError(file->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_CalendarHashChain_writeBytes(chain, buf + CALENDAR_RECORD_HEADER_LEN, len, &len, 0);
+	if (res != KSI_OK) {
+		KSI_pushError(file->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	writeUInt(buf, len, 4);
+	writeUInt(buf + 4, KSI_Integer_getUInt64(aggrTime), 8);
+	writeUInt(buf + 12, KSI_Integer_getUInt64(pubTime), 8);
+	writeUInt(buf + CALENDAR_RECORD_HEADER_LEN + len, KSI_crc32(buf, CALENDAR_RECORD_HEADER_LEN + len, 0), CALENDAR_RECORD_CRC_LEN);
+
+	res = lockFile(file, LOCK_EX);
+	if (res != KSI_OK) {
+		KSI_pushError(file->ctx, res, "Unable to lock the calendar file.");
+		goto cleanup;
+	}
+	locked = 1;
+
+	/* Another process may have appended the same chain meanwhile. */
+	res = refresh(file);
+	if (res != KSI_OK) goto cleanup;
+
+	if (findRecord(file, KSI_Integer_getUInt64(aggrTime), KSI_Integer_getUInt64(pubTime)) != NULL) {
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	/* Drop the damaged tail left by a crashed writer. */
+	if (file->map_len > file->end && ftruncate(file->fd, (off_t)file->end) != 0) {
+		KSI_pushError(file->ctx, res = KSI_IO_ERROR, "Unable to truncate the calendar file.");
+		goto cleanup;
+	}
+
+	res = writeAll(file->fd, buf, CALENDAR_RECORD_HEADER_LEN + len + CALENDAR_RECORD_CRC_LEN, file->end);
+	if (res != KSI_OK) {
+		KSI_pushError(file->ctx, res, "Unable to write the calendar file.");
+		goto cleanup;
+	}
+
+	res = refresh(file);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_OK;
+#endif
+
+cleanup:
+
+#ifndef _WIN32
+	if (locked) lockFile(file, LOCK_UN);
+#endif
+	KSI_free(buf);
+
+	return res;
+}
+
+int KSI_getCachedCalendarChain(KSI_CTX *ctx, const KSI_Integer *aggrTime, const KSI_Integer *pubTime, KSI_CalendarHashChain **chain) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_CalendarHashChain *tmp = NULL;
+
+	if (ctx == NULL || aggrTime == NULL || pubTime == NULL || chain == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	if (ctx->calendarCache != NULL) {
+		res = KSI_CalendarCache_get(ctx->calendarCache, aggrTime, pubTime, &tmp);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	if (tmp == NULL && ctx->calendarFile != NULL) {
+		res = KSI_CalendarFile_get(ctx->calendarFile, aggrTime, pubTime, &tmp);
+		if (res != KSI_OK) goto cleanup;
+
+		if (tmp != NULL && ctx->calendarCache != NULL) {
+			res = KSI_CalendarCache_put(ctx->calendarCache, tmp);
+			if (res != KSI_OK) goto cleanup;
+		}
+	}
+
+	*chain = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_CalendarHashChain_free(tmp);
+
+	return res;
+}
+
+int KSI_cacheCalendarChain(KSI_CTX *ctx, KSI_CalendarHashChain *chain) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (ctx == NULL || chain == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	if (ctx->calendarCache != NULL) {
+		res = KSI_CalendarCache_put(ctx->calendarCache, chain);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	if (ctx->calendarFile != NULL) {
+		res = KSI_CalendarFile_put(ctx->calendarFile, chain);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_isCalendarCacheEnabled(KSI_CTX *ctx) {
+	return ctx != NULL && (ctx->calendarCache != NULL || ctx->calendarFile != NULL);
+}
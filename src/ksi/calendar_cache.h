@@ -0,0 +1,146 @@
+/*
+ * Copyright 2013-2015 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#ifndef CALENDAR_CACHE_H_
+#define CALENDAR_CACHE_H_
+
+#include "ksi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/**
+	 * The calendar cache keeps the verified calendar hash chains received from the extender.
+	 * As all the signatures of the same aggregation round share the calendar hash chain, an
+	 * extension request is answered from the cache when a chain from the same aggregation time
+	 * to the same publication time has already been received. The least recently used chain
+	 * is dropped when the cache is full.
+	 */
+	typedef struct KSI_CalendarCache_st KSI_CalendarCache;
+
+	/**
+	 * Constructor for the calendar cache.
+	 * \param[in]		ctx			KSI context.
+	 * \param[in]		capacity	Maximum number of calendar hash chains in the cache.
+	 * \param[out]		cache		Pointer to the receiving pointer.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_CalendarCache_new(KSI_CTX *ctx, size_t capacity, KSI_CalendarCache **cache);
+
+	/**
+	 * Cleanup method for the calendar cache.
+	 * \param[in]		cache		The calendar cache.
+	 */
+	void KSI_CalendarCache_free(KSI_CalendarCache *cache);
+
+	/**
+	 * Looks up the calendar hash chain from \c aggrTime to \c pubTime.
+	 * \param[in]		cache		The calendar cache.
+	 * \param[in]		aggrTime	Aggregation time of the chain.
+	 * \param[in]		pubTime		Publication time of the chain.
+	 * \param[out]		chain		Pointer to the receiving pointer, set to \c NULL if the chain is not cached.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note The returned chain is a new reference and must be freed by the caller.
+	 */
+	int KSI_CalendarCache_get(KSI_CalendarCache *cache, const KSI_Integer *aggrTime, const KSI_Integer *pubTime, KSI_CalendarHashChain **chain);
+
+	/**
+	 * Adds a verified calendar hash chain to the cache. The chain is keyed by its aggregation
+	 * and publication time.
+	 * \param[in]		cache		The calendar cache.
+	 * \param[in]		chain		Calendar hash chain, the cache keeps a reference to it.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_CalendarCache_put(KSI_CalendarCache *cache, KSI_CalendarHashChain *chain);
+
+	/**
+	 * The calendar file is a persistent, append-only store of the verified calendar hash chains
+	 * shared by all the processes on a host. The file is memory-mapped for reading; the readers
+	 * share a lock while indexing the new records and a single writer appends under an exclusive
+	 * lock. Every record carries a checksum, a record torn by a crash is dropped by the next writer.
+	 */
+	typedef struct KSI_CalendarFile_st KSI_CalendarFile;
+
+	/**
+	 * Opens or creates the calendar file.
+	 * \param[in]		ctx			KSI context.
+	 * \param[in]		path		Path to the calendar file.
+	 * \param[out]		file		Pointer to the receiving pointer.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_CalendarFile_open(KSI_CTX *ctx, const char *path, KSI_CalendarFile **file);
+
+	/**
+	 * Unmaps and closes the calendar file.
+	 * \param[in]		file		The calendar file.
+	 */
+	void KSI_CalendarFile_free(KSI_CalendarFile *file);
+
+	/**
+	 * Looks up the calendar hash chain from \c aggrTime to \c pubTime, including the chains
+	 * appended by other processes since the last lookup.
+	 * \param[in]		file		The calendar file.
+	 * \param[in]		aggrTime	Aggregation time of the chain.
+	 * \param[in]		pubTime		Publication time of the chain.
+	 * \param[out]		chain		Pointer to the receiving pointer, set to \c NULL if the chain is not stored.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note The returned chain must be freed by the caller.
+	 */
+	int KSI_CalendarFile_get(KSI_CalendarFile *file, const KSI_Integer *aggrTime, const KSI_Integer *pubTime, KSI_CalendarHashChain **chain);
+
+	/**
+	 * Appends a verified calendar hash chain to the file, unless a chain with the same aggregation
+	 * and publication time is already stored.
+	 * \param[in]		file		The calendar file.
+	 * \param[in]		chain		Calendar hash chain.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_CalendarFile_put(KSI_CalendarFile *file, KSI_CalendarHashChain *chain);
+
+	/**
+	 * Looks up the calendar hash chain from the caches of the context: first from the memory
+	 * and then from the calendar file. A chain found in the file is added to the memory cache.
+	 * \param[in]		ctx			KSI context.
+	 * \param[in]		aggrTime	Aggregation time of the chain.
+	 * \param[in]		pubTime		Publication time of the chain.
+	 * \param[out]		chain		Pointer to the receiving pointer, set to \c NULL if the chain is not cached.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_getCachedCalendarChain(KSI_CTX *ctx, const KSI_Integer *aggrTime, const KSI_Integer *pubTime, KSI_CalendarHashChain **chain);
+
+	/**
+	 * Adds a verified calendar hash chain to the caches of the context.
+	 * \param[in]		ctx			KSI context.
+	 * \param[in]		chain		Calendar hash chain.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_cacheCalendarChain(KSI_CTX *ctx, KSI_CalendarHashChain *chain);
+
+	/**
+	 * Returns non-zero, if any of the calendar caches of the context is enabled.
+	 * \param[in]		ctx			KSI context.
+	 */
+	int KSI_isCalendarCacheEnabled(KSI_CTX *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CALENDAR_CACHE_H_ */
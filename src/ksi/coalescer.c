@@ -0,0 +1,390 @@
+/*
+ * Copyright 2013-2015 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#  include <time.h>
+#  include <errno.h>
+#endif
+
+#include "internal.h"
+#include "ctx_impl.h"
+#include "blocksigner.h"
+#include "coalescer.h"
+
+#ifdef _WIN32
+	typedef CRITICAL_SECTION CoalescerMutex;
+	typedef CONDITION_VARIABLE CoalescerCond;
+#else
+	typedef pthread_mutex_t CoalescerMutex;
+	typedef pthread_cond_t CoalescerCond;
+#endif
+
+typedef struct Batch_st Batch;
+
+struct Batch_st {
+	/** Block signer of the batch. */
+	KSI_BlockSigner *signer;
+	/** Number of callers still waiting for their signature from this batch. */
+	size_t members;
+	/** Set when no more hash values can be added to the batch. */
+	int closed;
+	/** Set when the batch has been signed or the signing failed. */
+	int done;
+	/** Status code of signing the batch. */
+	int status;
+};
+
+struct KSI_SignCoalescer_st {
+	KSI_CTX *ctx;
+	/** Requested time window of a batch in milliseconds. */
+	unsigned windowMs;
+	/** Requested maximum size of a batch. */
+	size_t maxBatch;
+	/** Batch accepting new hash values, \c NULL if there is none. */
+	Batch *open;
+	/** Protects all the fields of the coalescer and every use of #ctx. */
+	CoalescerMutex lock;
+	/** Signalled when a batch is closed or signed. */
+	CoalescerCond cond;
+};
+
+static void mutexInit(CoalescerMutex *m) {
+#ifdef _WIN32
+	InitializeCriticalSection(m);
+#else
+	pthread_mutex_init(m, NULL);
+#endif
+}
+
+static void mutexDestroy(CoalescerMutex *m) {
+#ifdef _WIN32
+	DeleteCriticalSection(m);
+#else
+	pthread_mutex_destroy(m);
+#endif
+}
+
+static void mutexLock(CoalescerMutex *m) {
+#ifdef _WIN32
+	EnterCriticalSection(m);
+#else
+	pthread_mutex_lock(m);
+#endif
+}
+
+static void mutexUnlock(CoalescerMutex *m) {
+#ifdef _WIN32
+	LeaveCriticalSection(m);
+#else
+	pthread_mutex_unlock(m);
+#endif
+}
+
+static void condInit(CoalescerCond *c) {
+#ifdef _WIN32
+	InitializeConditionVariable(c);
+#else
+	pthread_cond_init(c, NULL);
+#endif
+}
+
+static void condDestroy(CoalescerCond *c) {
+#ifdef _WIN32
+	/* Windows condition variables need no cleanup. */
+	(void)c;
+#else
+	pthread_cond_destroy(c);
+#endif
+}
+
+static void condBroadcast(CoalescerCond *c) {
+#ifdef _WIN32
+	WakeAllConditionVariable(c);
+#else
+	pthread_cond_broadcast(c);
+#endif
+}
+
+static void condWait(CoalescerCond *c, CoalescerMutex *m) {
+#ifdef _WIN32
+	SleepConditionVariableCS(c, m, INFINITE);
+#else
+	pthread_cond_wait(c, m);
+#endif
+}
+
+/* Returns the current time in milliseconds from an arbitrary starting point. */
+static KSI_uint64_t nowMs(void) {
+#ifdef _WIN32
+	return (KSI_uint64_t)GetTickCount64();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (KSI_uint64_t)ts.tv_sec * 1000 + (KSI_uint64_t)ts.tv_nsec / 1000000;
+#endif
+}
+
+/* Waits until signalled or until #deadline (as returned by #nowMs) has passed. */
+static void condWaitUntil(CoalescerCond *c, CoalescerMutex *m, KSI_uint64_t deadline) {
+	KSI_uint64_t now = nowMs();
+
+	if (now >= deadline) return;
+
+#ifdef _WIN32
+	SleepConditionVariableCS(c, m, (DWORD)(deadline - now));
+#else
+	{
+		struct timespec ts;
+		ts.tv_sec = (time_t)(deadline / 1000);
+		ts.tv_nsec = (long)(deadline % 1000) * 1000000;
+		pthread_cond_timedwait(c, m, &ts);
+	}
+#endif
+}
+
+static void Batch_free(Batch *batch) {
+	if (batch != NULL) {
+		KSI_BlockSigner_free(batch->signer);
+		KSI_free(batch);
+	}
+}
+
+static int Batch_new(KSI_CTX *ctx, KSI_HashAlgorithm algo_id, Batch **batch) {
+	int res = KSI_UNKNOWN_ERROR;
+	Batch *tmp = NULL;
+
+	tmp = KSI_new(Batch);
+	if (tmp == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	tmp->signer = NULL;
+	tmp->members = 0;
+	tmp->closed = 0;
+	tmp->done = 0;
+	tmp->status = KSI_UNKNOWN_ERROR;
+
+	res = KSI_BlockSigner_new(ctx, algo_id, &tmp->signer);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	*batch = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	Batch_free(tmp);
+
+	return res;
+}
+
+/**
+ * Applies the limits of the last configuration reported by the aggregator to the
+ * requested window and batch size. The batch size is limited by the maximum level
+ * of the aggregator, as a batch of n values adds ceil(log2(n)) levels to the tree.
+ */
+static void getLimits(KSI_SignCoalescer *coalescer, unsigned *windowMs, size_t *maxBatch, KSI_HashAlgorithm *algo_id) {
+	KSI_Config *conf = coalescer->ctx->aggrConfig;
+	KSI_Integer *maxLevel = NULL;
+	KSI_Integer *aggrPeriod = NULL;
+	KSI_Integer *aggrAlgo = NULL;
+
+	*windowMs = coalescer->windowMs;
+	*maxBatch = coalescer->maxBatch;
+	*algo_id = KSI_HASHALG_SHA2_256;
+
+	if (conf == NULL) return;
+
+	KSI_Config_getMaxLevel(conf, &maxLevel);
+	KSI_Config_getAggrPeriod(conf, &aggrPeriod);
+	KSI_Config_getAggrAlgo(conf, &aggrAlgo);
+
+	if (maxLevel != NULL && KSI_Integer_getUInt64(maxLevel) < sizeof(size_t) * 8 - 1) {
+		size_t levelLimit = (size_t)1 << KSI_Integer_getUInt64(maxLevel);
+		if (*maxBatch > levelLimit) *maxBatch = levelLimit;
+	}
+
+	/* There is no point in waiting longer than the aggregation round. */
+	if (aggrPeriod != NULL && KSI_Integer_getUInt64(aggrPeriod) > 0 && KSI_Integer_getUInt64(aggrPeriod) < *windowMs) {
+		*windowMs = (unsigned)KSI_Integer_getUInt64(aggrPeriod);
+	}
+
+	if (aggrAlgo != NULL && KSI_Integer_getUInt64(aggrAlgo) <= 0xff && KSI_isHashAlgorithmSupported((KSI_HashAlgorithm)KSI_Integer_getUInt64(aggrAlgo))) {
+		*algo_id = (KSI_HashAlgorithm)KSI_Integer_getUInt64(aggrAlgo);
+	}
+}
+
+int KSI_SignCoalescer_new(KSI_CTX *ctx, unsigned windowMs, size_t maxBatch, KSI_SignCoalescer **coalescer) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_SignCoalescer *tmp = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || maxBatch == 0 || coalescer == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	tmp = KSI_new(KSI_SignCoalescer);
+	if (tmp == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	tmp->ctx = ctx;
+	tmp->windowMs = windowMs;
+	tmp->maxBatch = maxBatch;
+	tmp->open = NULL;
+	mutexInit(&tmp->lock);
+	condInit(&tmp->cond);
+
+	*coalescer = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_SignCoalescer_free(tmp);
+
+	return res;
+}
+
+void KSI_SignCoalescer_free(KSI_SignCoalescer *coalescer) {
+	if (coalescer != NULL) {
+		condDestroy(&coalescer->cond);
+		mutexDestroy(&coalescer->lock);
+		KSI_free(coalescer);
+	}
+}
+
+int KSI_SignCoalescer_sign(KSI_SignCoalescer *coalescer, KSI_DataHash *hsh, KSI_Signature **sig) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_CTX *ctx = NULL;
+	Batch *batch = NULL;
+	KSI_BlockSignerHandle *handle = NULL;
+	KSI_Signature *tmp = NULL;
+	unsigned windowMs;
+	size_t maxBatch;
+	KSI_HashAlgorithm algo_id;
+	int isLeader = 0;
+
+	if (coalescer == NULL || hsh == NULL || sig == NULL) {
+		return KSI_INVALID_ARGUMENT;
+	}
+
+	ctx = coalescer->ctx;
+
+	mutexLock(&coalescer->lock);
+
+	KSI_ERR_clearErrors(ctx);
+
+	getLimits(coalescer, &windowMs, &maxBatch, &algo_id);
+
+	/* The first caller of a batch opens it and signs it later. */
+	if (coalescer->open == NULL) {
+		res = Batch_new(ctx, algo_id, &coalescer->open);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+		isLeader = 1;
+	}
+
+	batch = coalescer->open;
+
+	res = KSI_BlockSigner_add(batch->signer, hsh, &handle);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		/* A leader must not leave an empty batch behind. */
+		if (isLeader) {
+			coalescer->open = NULL;
+			Batch_free(batch);
+		}
+		batch = NULL;
+		goto cleanup;
+	}
+
+	batch->members++;
+
+	if (KSI_BlockSigner_getCount(batch->signer) >= maxBatch) {
+		batch->closed = 1;
+		coalescer->open = NULL;
+		condBroadcast(&coalescer->cond);
+	}
+
+	if (isLeader) {
+		KSI_uint64_t deadline = nowMs() + windowMs;
+
+		while (!batch->closed && nowMs() < deadline) {
+			condWaitUntil(&coalescer->cond, &coalescer->lock, deadline);
+		}
+
+		batch->closed = 1;
+		if (coalescer->open == batch) coalescer->open = NULL;
+
+		/* The request is sent while holding the lock, as the context is shared by the callers. */
+		KSI_ERR_clearErrors(ctx);
+		batch->status = KSI_BlockSigner_close(batch->signer);
+		batch->done = 1;
+
+		condBroadcast(&coalescer->cond);
+	} else {
+		while (!batch->done) {
+			condWait(&coalescer->cond, &coalescer->lock);
+		}
+	}
+
+	res = batch->status;
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_BlockSignerHandle_getSignature(handle, &tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	*sig = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	/* The last caller of the batch frees it. */
+	if (batch != NULL && --batch->members == 0) {
+		Batch_free(batch);
+	}
+
+	mutexUnlock(&coalescer->lock);
+
+	KSI_Signature_free(tmp);
+
+	return res;
+}
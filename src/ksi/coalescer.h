@@ -0,0 +1,67 @@
+/*
+ * Copyright 2013-2015 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#ifndef COALESCER_H_
+#define COALESCER_H_
+
+#include "ksi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/**
+	 * The sign coalescer collects the hash values of concurrent #KSI_createSignature
+	 * calls into a #KSI_BlockSigner and signs them with a single aggregation request.
+	 */
+	typedef struct KSI_SignCoalescer_st KSI_SignCoalescer;
+
+	/**
+	 * Constructor for the sign coalescer.
+	 * \param[in]		ctx			KSI context.
+	 * \param[in]		windowMs	Time in milliseconds a batch waits for more hash values.
+	 * \param[in]		maxBatch	Maximum number of hash values in a batch.
+	 * \param[out]		coalescer	Pointer to the receiving pointer.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_SignCoalescer_new(KSI_CTX *ctx, unsigned windowMs, size_t maxBatch, KSI_SignCoalescer **coalescer);
+
+	/**
+	 * Cleanup method for the sign coalescer. There must not be any callers waiting in
+	 * #KSI_SignCoalescer_sign.
+	 * \param[in]		coalescer	The sign coalescer.
+	 */
+	void KSI_SignCoalescer_free(KSI_SignCoalescer *coalescer);
+
+	/**
+	 * Adds the hash value to the current batch, waits until the batch is signed and
+	 * returns the individual signature of the hash value. This function may be called
+	 * concurrently from several threads.
+	 * \param[in]		coalescer	The sign coalescer.
+	 * \param[in]		hsh			Hash value to be signed.
+	 * \param[out]		sig			Pointer to the receiving pointer.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_SignCoalescer_sign(KSI_SignCoalescer *coalescer, KSI_DataHash *hsh, KSI_Signature **sig);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* COALESCER_H_ */
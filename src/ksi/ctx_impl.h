@@ -21,6 +21,9 @@
 #define CTX_IMPL_H_
 
 #include "types.h"
+#include "coalescer.h"
+#include "calendar_cache.h"
+#include "pubfile_reloader.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -64,6 +67,26 @@ extern "C" {
 
 		KSI_PublicationsFile *publicationsFile;
 
+		/** Validators received with #publicationsFile, \c NULL if not known. */
+		char *publicationsFileETag;
+		char *publicationsFileLastModified;
+
+		/** Validators of the next publications file request, \c NULL for an unconditional request. */
+		const char *publicationsFileIfNoneMatch;
+		const char *publicationsFileIfModifiedSince;
+
+		/** Time #publicationsFile was received or revalidated, as returned by #KSI_getTimeMs. */
+		KSI_uint64_t publicationsFileTime;
+
+		/** Time to live of #publicationsFile in milliseconds, 0 if it is never reloaded. */
+		KSI_uint64_t publicationsFileTtl;
+
+		/** Reloads #publicationsFile on a background thread, \c NULL if it is reloaded by the caller. */
+		KSI_PublicationsFileReloader *publicationsFileReloader;
+
+		/** Publications files replaced by a reload, the verification results may still refer to them. */
+		KSI_List *retiredPublicationsFiles;
+
 		/** This field is kept only for compatibility - will be removed in the future. */
 		char *publicationCertEmail_DEPRECATED;
 
@@ -78,6 +101,30 @@ extern "C" {
 
 		/** A NULL-terminated array of key-value pairs of OID and expected values for publications file certificate verification. */
 		KSI_CertConstraint *certConstraints;
+
+		/** Coalescer of the #KSI_createSignature calls, \c NULL if coalescing is not enabled. */
+		KSI_SignCoalescer *signCoalescer;
+
+		/** Cache of the calendar hash chains received from the extender, \c NULL if caching is disabled. */
+		KSI_CalendarCache *calendarCache;
+
+		/** Calendar file shared with the other processes, \c NULL if not used. */
+		KSI_CalendarFile *calendarFile;
+
+		/** Last configuration reported by the aggregator, \c NULL if not received. */
+		KSI_Config *aggrConfig;
+
+		/** Absolute deadline of the requests, 0 if there is none. */
+		KSI_uint64_t requestDeadline;
+
+		/** Time budget of a single request in milliseconds, 0 if there is none. */
+		unsigned requestTimeoutMs;
+
+		/** Number of bytes in the requests created by this context. */
+		KSI_uint64_t bytesSent;
+
+		/** Number of bytes in the responses received by this context. */
+		KSI_uint64_t bytesReceived;
 	};
 
 #ifdef __cplusplus
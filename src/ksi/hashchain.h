@@ -184,6 +184,7 @@ extern "C" {
 	int KSI_CalendarHashChain_setHashChain(KSI_CalendarHashChain *t, KSI_LIST(KSI_HashChainLink) *hashChain);
 	KSI_DEFINE_REF(KSI_CalendarHashChain);
 	KSI_DEFINE_WRITE_BYTES(KSI_CalendarHashChain);
+	KSI_DEFINE_OBJECT_PARSE(KSI_CalendarHashChain);
 
 /**
  * @}
@@ -39,6 +39,7 @@
 #define KSI_IMPL_CURL			1
 #define KSI_IMPL_WININET		2
 #define KSI_IMPL_WINHTTP		3
+#define KSI_IMPL_NATIVE			6
  /**
   * Crypto implementations.
   */
@@ -301,6 +301,9 @@ int KSI_IO_readSocket(int fd, void *buf, size_t size, size_t *readCount) {
 			goto cleanup;
 		}
 
+		/* The peer has closed the connection. */
+		if (c == 0) break;
+
 		/* Do this check just to be safe. */
 		if ((size_t) c > len) {
 			res = KSI_BUFFER_OVERFLOW;
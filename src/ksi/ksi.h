@@ -360,7 +360,18 @@ void *KSI_malloc(size_t size);
 void *KSI_calloc(size_t num, size_t size);
 
 /**
- * Free memory allocated by #KSI_malloc or #KSI_calloc.
+ * Changes the size of the memory block allocated by #KSI_malloc, #KSI_calloc or #KSI_realloc.
+ * \param[in]	ptr		Pointer to the memory block (may be \c NULL).
+ * \param[in]	size	New size of the block.
+ *
+ * \return Pointer to the reallocated memory, or \c NULL if an error occurred - in this case the
+ * original block is left untouched.
+ * \note The caller needs to free the allocated memory with #KSI_free.
+ */
+void *KSI_realloc(void *ptr, size_t size);
+
+/**
+ * Free memory allocated by #KSI_malloc, #KSI_calloc or #KSI_realloc.
  * \param[in]	ptr		Pointer to the memory to be freed.
  */
 void KSI_free(void *ptr);
@@ -408,6 +419,26 @@ int KSI_sendPublicationRequest(KSI_CTX *ctx, const unsigned char *request, size_
  */
 int KSI_receivePublicationsFile(KSI_CTX *ctx, KSI_PublicationsFile **pubFile);
 
+/**
+ * Sets the time to live of the publications file received by #KSI_receivePublicationsFile. Once it
+ * has passed, the file is revalidated with a conditional request (\c If-None-Match and
+ * \c If-Modified-Since), so an unchanged file is neither downloaded nor parsed again. If the
+ * revalidation fails, the previous file is used until the time to live has passed again. With
+ * \c background set, the file is revalidated on a separate thread and #KSI_receivePublicationsFile
+ * only picks up the newest received file, so the caller never waits for a download after the
+ * first one. By default the publications file is received once and never reloaded.
+ * \param[in]	ctx			KSI context.
+ * \param[in]	ttlMs		Time to live of the publications file in milliseconds, 0 disables reloading.
+ * \param[in]	background	Non-zero to revalidate the file on a background thread.
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ * \note The replaced publications files are kept until the context is freed, as the verification
+ * results may refer to them.
+ * \note The background thread downloads the file from the publications file URL of the network
+ * provider at the time of this call.
+ * \note This function must not be called while any other thread is using the context.
+ */
+int KSI_CTX_setPublicationsFileTtl(KSI_CTX *ctx, KSI_uint64_t ttlMs, int background);
+
 /**
  * Verify the PKI signature of the publications file using the context.
  * \param[in]		ctx			KSI context.
@@ -481,6 +512,84 @@ int KSI_CTX_setLoggerCallback(KSI_CTX *ctx, KSI_LoggerCallback cb, void *logCtx)
  */
 int KSI_CTX_setRequestHeaderCallback(KSI_CTX *ctx, KSI_RequestHeaderCallback cb);
 
+/**
+ * Enables coalescing of the #KSI_createSignature calls. The hash values of the calls made
+ * within \c windowMs milliseconds, but no more than \c maxBatch of them, are aggregated
+ * locally and signed with a single aggregation request. Every caller still receives its
+ * own signature. The window and the batch size are reduced further according to the
+ * aggregation period and the maximum aggregation level, if the aggregator has reported its
+ * configuration. While coalescing is enabled, #KSI_createSignature may be called concurrently
+ * from several threads with the same context; other functions using the context still must
+ * not be called concurrently.
+ * \param[in]	ctx			KSI context.
+ * \param[in]	windowMs	Time in milliseconds to wait for more hash values to a batch.
+ * \param[in]	maxBatch	Maximum number of hash values in a batch, 0 disables coalescing.
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ * \note This function must not be called while any other thread is using the context.
+ */
+int KSI_CTX_setSignCoalescing(KSI_CTX *ctx, unsigned windowMs, size_t maxBatch);
+
+/**
+ * Sets the number of calendar hash chains kept in the context. All the signatures from the same
+ * aggregation round share the calendar hash chain, so extending them to the same publication
+ * is answered from the cache without sending a new request to the extender. Only the verified
+ * chains to an explicit publication time are cached, as the head of the calendar keeps moving.
+ * The cache is disabled by default.
+ * \param[in]	ctx			KSI context.
+ * \param[in]	size		Maximum number of calendar hash chains, 0 disables the cache.
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ * \note Any cached chains are dropped.
+ */
+int KSI_CTX_setCalendarCacheSize(KSI_CTX *ctx, size_t size);
+
+/**
+ * Sets the calendar file of the context. The file keeps the verified calendar hash chains across
+ * restarts and is shared by all the processes using the same path, so a chain received by one
+ * of them is not requested from the extender again. The file is memory-mapped and only grows;
+ * the chains found in the file are also kept in the memory cache, if it is enabled with
+ * #KSI_CTX_setCalendarCacheSize. The calendar file is disabled by default.
+ * \param[in]	ctx			KSI context.
+ * \param[in]	path		Path to the calendar file, created if it does not exist; \c NULL closes the file.
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ * \note The calendar file is not supported on Windows.
+ */
+int KSI_CTX_setCalendarCacheFile(KSI_CTX *ctx, const char *path);
+
+/**
+ * Sets an absolute deadline for all the following requests of the context, e.g. for a
+ * #KSI_createSignature, #KSI_extendSignature or #KSI_verifySignature call as a whole. The
+ * deadline covers resolving the host names, connecting, sending and receiving; once it has
+ * passed, the requests fail with a timeout error.
+ * \param[in]	ctx			KSI context.
+ * \param[in]	deadlineMs	Deadline as returned by #KSI_getTimeMs plus the time budget in
+ * 							milliseconds, 0 to remove the deadline.
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ * \see #KSI_RequestHandle_setDeadline
+ */
+int KSI_CTX_setRequestDeadline(KSI_CTX *ctx, KSI_uint64_t deadlineMs);
+
+/**
+ * Sets the time budget of every single request of the context. Unlike the transfer and
+ * connection timeouts, which limit the individual network operations, the budget limits
+ * the request from resolving the host name until the whole response has been received.
+ * \param[in]	ctx			KSI context.
+ * \param[in]	timeoutMs	Time budget in milliseconds, 0 to remove the limit.
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ * \note If #KSI_CTX_setRequestDeadline is also set, the earlier of the two applies.
+ */
+int KSI_CTX_setRequestTimeoutMs(KSI_CTX *ctx, unsigned timeoutMs);
+
+/**
+ * Returns the number of bytes the context has sent in aggregation and extension requests and
+ * received in their responses. Only the PDUs are counted, the transport framing (e.g. HTTP
+ * headers) and the requests repeated by the network client are not included.
+ * \param[in]	ctx			KSI context.
+ * \param[out]	sent		Receives the number of bytes sent, may be \c NULL.
+ * \param[out]	received	Receives the number of bytes received, may be \c NULL.
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ */
+int KSI_CTX_getTransferredBytes(KSI_CTX *ctx, KSI_uint64_t *sent, KSI_uint64_t *received);
+
 /**
  * Setter for publications file url.
  * \param[in]	ctx		KSI_context.
@@ -509,6 +618,38 @@ int KSI_CTX_setExtender(KSI_CTX *ctx, const char *uri, const char *loginId, cons
  */
 int KSI_CTX_setAggregator(KSI_CTX *ctx, const char *uri, const char *loginId, const char *key);
 
+/**
+ * Adds an aggregator endpoint. If several aggregator endpoints are configured, every request
+ * is routed to the fastest healthy endpoint and fails over to the others on errors.
+ * \param[in]	ctx		KSI context.
+ * \param[in]	uri		Aggregation service URI.
+ * \param[in]	loginId	The login id for the service.
+ * \param[in]	key		Key for the loginId.
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ * \see #KSI_UriClient_addAggregator
+ */
+int KSI_CTX_addAggregator(KSI_CTX *ctx, const char *uri, const char *loginId, const char *key);
+
+/**
+ * Adds an extender endpoint.
+ * \param[in]	ctx		KSI context.
+ * \param[in]	uri		Extending service URI.
+ * \param[in]	loginId	The login id for the service.
+ * \param[in]	key		Key for the loginId.
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ * \see #KSI_UriClient_addExtender
+ */
+int KSI_CTX_addExtender(KSI_CTX *ctx, const char *uri, const char *loginId, const char *key);
+
+/**
+ * Enables or disables hedged requests to the aggregator and extender endpoints.
+ * \param[in]	ctx		KSI context.
+ * \param[in]	enable	Non-zero to enable hedged requests.
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ * \see #KSI_UriClient_setHedging
+ */
+int KSI_CTX_setRequestHedging(KSI_CTX *ctx, int enable);
+
 /**
  * Setter for transfer timeout.
  * \param[in]	ctx		KSI context.
@@ -1330,52 +1330,75 @@ static int extendUnextended(TimeMapper *tm, void *fctx) {
 
 			/* Only continue, if there is such a publication available. */
 			if (pubRec != NULL) {
+				KSI_CTX *ctx = tm->calendarChain->ctx;
 				KSI_CalendarHashChain *chn = NULL;
 
 				/* Add the publication to the container. */
 				res = addPublication(pubRec, helper->tmList);
 				if (res != KSI_OK) goto cleanup;
 
-				/* Create a new extension request. */
-				res = KSI_ExtendReq_new(tm->calendarChain->ctx, &req);
-				if (res != KSI_OK) goto cleanup;
-
-				/* Create a reference to aggregation time. */
-				res = KSI_Integer_ref(aggregationTime = tm->calendarChain->aggregationTime);
-				if (res != KSI_OK) goto cleanup;
-
-				/* Create reference to publication time. */
-				res = KSI_Integer_ref(publicationTime = pubRec->publishedData->time);
-				if (res != KSI_OK) goto cleanup;
-
-				/* Populate the aggregation time. */
-				res = KSI_ExtendReq_setAggregationTime(req, aggregationTime);
-				if (res != KSI_OK) goto cleanup;
-
-				/* Populate the publication time. */
-				res = KSI_ExtendReq_setPublicationTime(req, publicationTime);
-				if (res != KSI_OK) goto cleanup;
-
-				/* FIXME! The caller should not be bothered with request id - this must be done within the network client. */
-				res = KSI_Integer_new(tm->calendarChain->ctx, ++tm->calendarChain->ctx->requestCounter, &reqId);
-				if (res != KSI_OK) goto cleanup;
-				res = KSI_ExtendReq_setRequestId(req, reqId);
-				if (res != KSI_OK) goto cleanup;
-
-				/* Send the extension request. */
-				res = KSI_sendExtendRequest(tm->calendarChain->ctx, req, &handle);
-				if (res != KSI_OK) goto cleanup;
-
-				/* Call a blocking call to receive the response. */
-				res = KSI_RequestHandle_getExtendResponse(handle, &resp);
-				if (res != KSI_OK) goto cleanup;
+				/* The round may already have been extended to the same publication. */
+				if (KSI_isCalendarCacheEnabled(ctx) && tm->calendarChain->aggregationTime != NULL) {
+					res = KSI_getCachedCalendarChain(ctx, tm->calendarChain->aggregationTime, pubRec->publishedData->time, &chn);
+					if (res != KSI_OK) goto cleanup;
+				}
 
-				/* Extract the calendar chain from the extension request. */
-				res = KSI_ExtendResp_getCalendarHashChain(resp, &chn);
-				if (res != KSI_OK) goto cleanup;
+				if (chn == NULL) {
+					/* Create a new extension request. */
+					res = KSI_ExtendReq_new(ctx, &req);
+					if (res != KSI_OK) goto cleanup;
+
+					/* Create a reference to aggregation time. */
+					res = KSI_Integer_ref(aggregationTime = tm->calendarChain->aggregationTime);
+					if (res != KSI_OK) goto cleanup;
+
+					/* Create reference to publication time. */
+					res = KSI_Integer_ref(publicationTime = pubRec->publishedData->time);
+					if (res != KSI_OK) goto cleanup;
+
+					/* Populate the aggregation time. */
+					res = KSI_ExtendReq_setAggregationTime(req, aggregationTime);
+					if (res != KSI_OK) goto cleanup;
+
+					/* Populate the publication time. */
+					res = KSI_ExtendReq_setPublicationTime(req, publicationTime);
+					if (res != KSI_OK) goto cleanup;
+
+					/* FIXME! The caller should not be bothered with request id - this must be done within the network client. */
+					res = KSI_Integer_new(ctx, ++ctx->requestCounter, &reqId);
+					if (res != KSI_OK) goto cleanup;
+					res = KSI_ExtendReq_setRequestId(req, reqId);
+					if (res != KSI_OK) goto cleanup;
+
+					/* Send the extension request. */
+					res = KSI_sendExtendRequest(ctx, req, &handle);
+					if (res != KSI_OK) goto cleanup;
+
+					/* Call a blocking call to receive the response. */
+					res = KSI_RequestHandle_getExtendResponse(handle, &resp);
+					if (res != KSI_OK) goto cleanup;
+
+					/* Extract the calendar chain from the extension request. */
+					res = KSI_ExtendResp_getCalendarHashChain(resp, &chn);
+					if (res != KSI_OK) goto cleanup;
+
+					/* Keep a reference, as the cached chains are not owned by a response. */
+					res = KSI_CalendarHashChain_ref(chn);
+					if (res != KSI_OK) goto cleanup;
+
+					/* Only the chains verified against the request are cached. */
+					if (KSI_isCalendarCacheEnabled(ctx) && KSI_ExtendResp_verifyWithRequest(resp, req) == KSI_OK) {
+						res = KSI_cacheCalendarChain(ctx, chn);
+						if (res != KSI_OK) {
+							KSI_CalendarHashChain_free(chn);
+							goto cleanup;
+						}
+					}
+				}
 
 				/* Add the response calendar chain to the multi signature. */
 				res = addCalendarChain(chn, helper->tmList);
+				KSI_CalendarHashChain_free(chn);
 				if (res != KSI_OK) goto cleanup;
 			}
 		}
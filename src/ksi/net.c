@@ -18,16 +18,47 @@
  */
 
 #include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <time.h>
+
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <sys/time.h>
+#endif
 
 #include "http_parser.h"
 #include "internal.h"
 #include "net_impl.h"
 #include "tlv.h"
+#include "tlv_template.h"
 #include "ctx_impl.h"
 
+KSI_IMPORT_TLV_TEMPLATE(KSI_ExtendPdu);
+KSI_IMPORT_TLV_TEMPLATE(KSI_AggregationPdu);
+
 KSI_IMPLEMENT_GET_CTX(KSI_NetworkClient);
 KSI_IMPLEMENT_GET_CTX(KSI_RequestHandle);
 
+KSI_uint64_t KSI_getTimeMs(void) {
+#ifdef _WIN32
+	return (KSI_uint64_t)GetTickCount64();
+#elif defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (KSI_uint64_t)ts.tv_sec * 1000 + (KSI_uint64_t)ts.tv_nsec / 1000000;
+#else
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+
+	return (KSI_uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+#endif
+}
+
 static int setStringParam(char **param, const char *val) {
 	char *tmp = NULL;
 	int res = KSI_UNKNOWN_ERROR;
@@ -93,6 +124,30 @@ int KSI_RequestHandle_new(KSI_CTX *ctx, const unsigned char *request, size_t req
 
 	tmp->response = NULL;
 	tmp->response_length = 0;
+	tmp->responseTlv = NULL;
+
+	tmp->readResponse = NULL;
+	tmp->perform = NULL;
+	tmp->getPollInfo = NULL;
+	tmp->completionCb = NULL;
+	tmp->completionCbData = NULL;
+	tmp->completed = 0;
+	tmp->status = KSI_OK;
+	tmp->responseConsumer = NULL;
+	tmp->responseConsumerData = NULL;
+
+	/* Requests of the high-level calls inherit the deadline of the context. */
+	tmp->deadline = ctx->requestDeadline;
+	if (ctx->requestTimeoutMs > 0) {
+		KSI_uint64_t deadline = KSI_getTimeMs() + ctx->requestTimeoutMs;
+		if (tmp->deadline == 0 || deadline < tmp->deadline) tmp->deadline = deadline;
+	}
+
+	tmp->ifNoneMatch = NULL;
+	tmp->ifModifiedSince = NULL;
+	tmp->etag = NULL;
+	tmp->lastModified = NULL;
+	tmp->notModified = 0;
 
 	tmp->client = NULL;
 
@@ -141,7 +196,15 @@ void KSI_RequestHandle_free(KSI_RequestHandle *handle) {
 			handle->implCtx_free(handle->implCtx);
 		}
 		KSI_free(handle->request);
-		KSI_free(handle->response);
+		KSI_free(handle->ifNoneMatch);
+		KSI_free(handle->ifModifiedSince);
+		KSI_free(handle->etag);
+		KSI_free(handle->lastModified);
+		if (handle->responseTlv != NULL) {
+			KSI_TLV_free(handle->responseTlv);
+		} else {
+			KSI_free(handle->response);
+		}
 		KSI_free(handle);
 	}
 }
@@ -281,9 +344,7 @@ int KSI_RequestHandle_setResponse(KSI_RequestHandle *handle, const unsigned char
 		memcpy(resp, response, response_len);
 	}
 
-	handle->response = resp;
-	handle->response_length = response_len;
-
+	KSI_RequestHandle_setResponseBuffer(handle, resp, response_len);
 	resp = NULL;
 
 	res = KSI_OK;
@@ -295,6 +356,121 @@ cleanup:
 	return res;
 }
 
+void KSI_RequestHandle_setResponseBuffer(KSI_RequestHandle *handle, unsigned char *response, size_t response_len) {
+	if (handle == NULL) return;
+
+	/* The previous response is owned by the parsed TLV, if it has been parsed. */
+	if (handle->responseTlv != NULL) {
+		KSI_TLV_free(handle->responseTlv);
+		handle->responseTlv = NULL;
+	} else {
+		KSI_free(handle->response);
+	}
+
+	handle->response = response;
+	handle->response_length = response_len;
+}
+
+/* Compares the header names ignoring the case. */
+static int headerNameEquals(const char *name, size_t name_len, const char *expected) {
+	size_t i;
+
+	if (name_len != strlen(expected)) return 0;
+
+	for (i = 0; i < name_len; i++) {
+		if (tolower((unsigned char)name[i]) != tolower((unsigned char)expected[i])) return 0;
+	}
+
+	return 1;
+}
+
+int KSI_RequestHandle_setResponseHeader(KSI_RequestHandle *handle, const char *name, size_t name_len, const char *value, size_t value_len) {
+	int res = KSI_UNKNOWN_ERROR;
+	char **target = NULL;
+	char *tmp = NULL;
+
+	if (handle == NULL || name == NULL || (value == NULL && value_len != 0)) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	if (headerNameEquals(name, name_len, "ETag")) {
+		target = &handle->etag;
+	} else if (headerNameEquals(name, name_len, "Last-Modified")) {
+		target = &handle->lastModified;
+	} else {
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	while (value_len > 0 && isspace((unsigned char)value[0])) {
+		value++;
+		value_len--;
+	}
+	while (value_len > 0 && isspace((unsigned char)value[value_len - 1])) value_len--;
+
+	tmp = KSI_malloc(value_len + 1);
+	if (tmp == NULL) {
+		res = KSI_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+	if (value_len > 0) memcpy(tmp, value, value_len);
+	tmp[value_len] = '\0';
+
+	KSI_free(*target);
+	*target = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(tmp);
+
+	return res;
+}
+
+/**
+ * Parses the response of the handle into the PDU object. The response buffer is handed over to
+ * the parsed TLV instead of being copied, and the TLV is kept by the handle for later calls.
+ */
+static int parseResponsePdu(KSI_RequestHandle *handle, unsigned tag, const KSI_TlvTemplate *tmpl, void *pdu) {
+	int res = KSI_UNKNOWN_ERROR;
+	const unsigned char *raw = NULL;
+	size_t len = 0;
+
+	res = KSI_RequestHandle_getResponse(handle, &raw, &len);
+	if (res != KSI_OK) {
+		KSI_pushError(handle->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	if (handle->responseTlv == NULL) {
+		res = KSI_TLV_parseBlob2(handle->ctx, handle->response, handle->response_length, 1, &handle->responseTlv);
+		if (res != KSI_OK) {
+			KSI_pushError(handle->ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	if (KSI_TLV_getTag(handle->responseTlv) != tag) {
+		KSI_pushError(handle->ctx, res = KSI_INVALID_FORMAT, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_TlvTemplate_extract(handle->ctx, pdu, handle->responseTlv, tmpl);
+	if (res != KSI_OK) {
+		KSI_pushError(handle->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
 int KSI_RequestHandle_setImplContext(KSI_RequestHandle *handle, void *netCtx, void (*netCtx_free)(void *)) {
 	int res;
 
@@ -402,6 +578,12 @@ int KSI_RequestHandle_getResponse(KSI_RequestHandle *handle, const unsigned char
 	}
 
 
+	/* A failed non-blocking request is not retried. */
+	if (handle->completed && handle->status != KSI_OK) {
+		KSI_pushError(handle->ctx, res = handle->status, "Request has failed.");
+		goto cleanup;
+	}
+
 	if (handle->response == NULL) {
 		KSI_LOG_debug(handle->ctx, "Waiting for response.");
 		res = receiveResponse(handle);
@@ -421,6 +603,183 @@ cleanup:
 	return res;
 }
 
+void KSI_RequestHandle_complete(KSI_RequestHandle *handle, int status) {
+	if (handle == NULL || handle->completed) return;
+
+	handle->completed = 1;
+	handle->status = status;
+
+	if (handle->completionCb != NULL) {
+		handle->completionCb(handle, status, handle->completionCbData);
+	}
+}
+
+int KSI_RequestHandle_setDeadline(KSI_RequestHandle *handle, KSI_uint64_t deadlineMs) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (handle == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	handle->deadline = deadlineMs;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_RequestHandle_getDeadline(const KSI_RequestHandle *handle, KSI_uint64_t *deadlineMs) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (handle == NULL || deadlineMs == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	*deadlineMs = handle->deadline;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_RequestHandle_remainingMs(const KSI_RequestHandle *handle, int timeoutMs) {
+	KSI_uint64_t now;
+	int remaining;
+
+	if (handle == NULL || handle->deadline == 0) return timeoutMs;
+
+	now = KSI_getTimeMs();
+	if (now >= handle->deadline) return 0;
+
+	remaining = handle->deadline - now > INT_MAX ? INT_MAX : (int)(handle->deadline - now);
+
+	return timeoutMs < 0 || remaining < timeoutMs ? remaining : timeoutMs;
+}
+
+int KSI_RequestHandle_isExpired(const KSI_RequestHandle *handle) {
+	return handle != NULL && handle->deadline != 0 && KSI_getTimeMs() >= handle->deadline;
+}
+
+int KSI_RequestHandle_getPollInfo(KSI_RequestHandle *handle, int *fd, int *events, int *timeoutMs) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (handle == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(handle->ctx);
+
+	if (fd == NULL || events == NULL || timeoutMs == NULL) {
+		KSI_pushError(handle->ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	/* Nothing to wait for - the caller should perform the request right away. */
+	*fd = -1;
+	*events = 0;
+	*timeoutMs = 0;
+
+	if (!handle->completed && handle->response == NULL && handle->getPollInfo != NULL) {
+		res = handle->getPollInfo(handle, fd, events, timeoutMs);
+		if (res != KSI_OK) {
+			KSI_pushError(handle->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		/* Wake up in time to fail the request at its deadline. */
+		*timeoutMs = KSI_RequestHandle_remainingMs(handle, *timeoutMs);
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_RequestHandle_perform(KSI_RequestHandle *handle, int events) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (handle == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(handle->ctx);
+
+	if (!handle->completed) {
+		if (handle->response != NULL) {
+			res = KSI_OK;
+		} else if (handle->perform != NULL) {
+			res = handle->perform(handle, events);
+		} else {
+			/* Fall back to the blocking read. */
+			res = receiveResponse(handle);
+		}
+
+		if (res == KSI_ASYNC_NOT_FINISHED) {
+			if (!KSI_RequestHandle_isExpired(handle)) goto cleanup;
+			/* The transport is left as is, it is cleaned up together with the handle. */
+			KSI_pushError(handle->ctx, res = KSI_NETWORK_RECIEVE_TIMEOUT, "Request deadline has passed.");
+		}
+
+		KSI_RequestHandle_complete(handle, res);
+	}
+
+	res = handle->status;
+	if (res != KSI_OK) {
+		KSI_pushError(handle->ctx, res, NULL);
+		goto cleanup;
+	}
+
+cleanup:
+
+	return res;
+}
+
+int KSI_RequestHandle_setCompletionCallback(KSI_RequestHandle *handle, KSI_RequestHandleCompletionCallback cb, void *userData) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (handle == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	handle->completionCb = cb;
+	handle->completionCbData = userData;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_RequestHandle_setResponseConsumer(KSI_RequestHandle *handle, KSI_RequestHandleResponseConsumer fn, void *userData) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (handle == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	handle->responseConsumer = fn;
+	handle->responseConsumerData = userData;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
 int pdu_verify_hmac(KSI_CTX *ctx, KSI_DataHash *hmac,const char *key, int (*calculateHmac)(void*, int, const char*, KSI_DataHash**) ,void *PDU){
 	int res;
 	KSI_DataHash *actualHmac = NULL;
@@ -495,8 +854,16 @@ int KSI_RequestHandle_getExtendResponse(KSI_RequestHandle *handle, KSI_ExtendRes
 
 	KSI_LOG_logBlob(handle->ctx, KSI_LOG_DEBUG, "Parsing extend response from", raw, len);
 
+	handle->ctx->bytesReceived += len;
+
+	res = KSI_ExtendPdu_new(handle->ctx, &pdu);
+	if (res != KSI_OK) {
+		KSI_pushError(handle->ctx, res, NULL);
+		goto cleanup;
+	}
+
 	/*Get response PDU*/
-	res = KSI_ExtendPdu_parse(handle->ctx, raw, len, &pdu);
+	res = parseResponsePdu(handle, 0x300, KSI_TLV_TEMPLATE(KSI_ExtendPdu), pdu);
 	if(res != KSI_OK){
 		int networkStatus = handle->client->getStausCode ? handle->client->getStausCode(handle->client) : 0;
 
@@ -623,8 +990,16 @@ int KSI_RequestHandle_getAggregationResponse(KSI_RequestHandle *handle, KSI_Aggr
 
 	KSI_LOG_logBlob(handle->ctx, KSI_LOG_DEBUG, "Parsing aggregation response from", raw, len);
 
+	handle->ctx->bytesReceived += len;
+
+	res = KSI_AggregationPdu_new(handle->ctx, &pdu);
+	if (res != KSI_OK) {
+		KSI_pushError(handle->ctx, res, NULL);
+		goto cleanup;
+	}
+
 	/*Get PDU object*/
-	res = KSI_AggregationPdu_parse(handle->ctx, raw, len, &pdu);
+	res = parseResponsePdu(handle, 0x200, KSI_TLV_TEMPLATE(KSI_AggregationPdu), pdu);
 	if(res != KSI_OK){
 		int networkStatus = handle->client->getStausCode ? handle->client->getStausCode(handle->client) : 0;
 
@@ -766,6 +1141,28 @@ cleanup:
 	return res;
 }
 
+int KSI_NetworkClient_getPublicationUrl(KSI_NetworkClient *client, const char **url) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (client == NULL || url == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	*url = NULL;
+
+	if (client->getPublicationUrl != NULL) {
+		res = client->getPublicationUrl(client, url);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
 int KSI_NetworkClient_init(KSI_CTX *ctx, KSI_NetworkClient *client) {
 	int res = KSI_UNKNOWN_ERROR;
 
@@ -784,6 +1181,7 @@ int KSI_NetworkClient_init(KSI_CTX *ctx, KSI_NetworkClient *client) {
 	client->sendPublicationRequest = NULL;
 	client->sendSignRequest = NULL;
 	client->getStausCode = NULL;
+	client->getPublicationUrl = NULL;
 
 	res = KSI_OK;
 
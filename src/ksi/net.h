@@ -141,6 +141,119 @@ extern "C" {
 	 */
 	int KSI_RequestHandle_getResponse(KSI_RequestHandle *handle, const unsigned char **response, size_t *response_len);
 
+	/**
+	 * Network events used by the non-blocking request handle interface.
+	 * \see #KSI_RequestHandle_getPollInfo, #KSI_RequestHandle_perform
+	 */
+	enum KSI_NetEvent_en {
+		/** The socket is readable. */
+		KSI_NET_EVENT_READ = 0x01,
+		/** The socket is writable. */
+		KSI_NET_EVENT_WRITE = 0x02
+	};
+
+	/**
+	 * Completion callback of a non-blocking request.
+	 * \param[in]		handle			Network handle.
+	 * \param[in]		status			Status of the request (#KSI_OK, when the response was received).
+	 * \param[in]		userData		Pointer passed to #KSI_RequestHandle_setCompletionCallback.
+	 * \note The callback must not free the handle.
+	 */
+	typedef void (*KSI_RequestHandleCompletionCallback)(KSI_RequestHandle *handle, int status, void *userData);
+
+	/**
+	 * Returns what the handle is waiting for, so it can be driven by an external event loop. The
+	 * caller should wait until one of the \c events occurs on \c fd or \c timeoutMs milliseconds
+	 * have passed and then call #KSI_RequestHandle_perform.
+	 * \param[in]		handle			Network handle.
+	 * \param[out]		fd				Socket descriptor to wait on, -1 if there is nothing to wait for.
+	 * \param[out]		events			Bitmask of #KSI_NetEvent_en values to wait for.
+	 * \param[out]		timeoutMs		Maximum time to wait in milliseconds, -1 for no limit, 0 to call #KSI_RequestHandle_perform immediately.
+	 *
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note Handles sharing a pipelined connection report the same descriptor. Performing any of them
+	 * routes the received responses to all of them.
+	 */
+	int KSI_RequestHandle_getPollInfo(KSI_RequestHandle *handle, int *fd, int *events, int *timeoutMs);
+
+	/**
+	 * Advances a non-blocking request without waiting. If the network client does not support
+	 * non-blocking requests, the call will block until the response is received.
+	 * \param[in]		handle			Network handle.
+	 * \param[in]		events			Bitmask of #KSI_NetEvent_en values that occurred, 0 on timeout.
+	 *
+	 * \return #KSI_ASYNC_NOT_FINISHED while the request is in progress, #KSI_OK when the response is
+	 * available via #KSI_RequestHandle_getResponse, otherwise an error code.
+	 */
+	int KSI_RequestHandle_perform(KSI_RequestHandle *handle, int events);
+
+	/**
+	 * Sets the callback to be called once the request has completed - either the response has been
+	 * received or the request has failed.
+	 * \param[in]		handle			Network handle.
+	 * \param[in]		cb				Completion callback, \c NULL to remove.
+	 * \param[in]		userData		Pointer passed to the callback.
+	 *
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_RequestHandle_setCompletionCallback(KSI_RequestHandle *handle, KSI_RequestHandleCompletionCallback cb, void *userData);
+
+	/**
+	 * Consumer of the response body, called for every chunk of the response as it arrives.
+	 * \param[in]		handle			Network handle.
+	 * \param[in]		chunk			Pointer to the received data.
+	 * \param[in]		chunk_len		Length of the received data.
+	 * \param[in]		userData		Pointer passed to #KSI_RequestHandle_setResponseConsumer.
+	 *
+	 * \return #KSI_OK to continue receiving, any other value aborts the request.
+	 */
+	typedef int (*KSI_RequestHandleResponseConsumer)(KSI_RequestHandle *handle, const unsigned char *chunk, size_t chunk_len, void *userData);
+
+	/**
+	 * Sets a consumer for streaming the response body, e.g. directly into a parser. When a consumer is
+	 * set, the response is not buffered and #KSI_RequestHandle_getResponse returns an empty response.
+	 * \param[in]		handle			Network handle.
+	 * \param[in]		fn				Response consumer, \c NULL to buffer the response.
+	 * \param[in]		userData		Pointer passed to the consumer.
+	 *
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note Must be set before the response starts to arrive. Streaming is currently supported only
+	 * by the libcurl based and the native HTTP clients, other transports buffer the response regardless.
+	 */
+	int KSI_RequestHandle_setResponseConsumer(KSI_RequestHandle *handle, KSI_RequestHandleResponseConsumer fn, void *userData);
+
+	/**
+	 * Returns the current time in milliseconds from an arbitrary starting point. The clock is
+	 * monotonic where the platform provides one, and is the time base of the request deadlines.
+	 */
+	KSI_uint64_t KSI_getTimeMs(void);
+
+	/**
+	 * Sets the absolute deadline of the request. The deadline covers the whole request - resolving
+	 * the host name, connecting, sending the request and receiving the response. Once it has passed,
+	 * the request fails with a timeout error, regardless of the timeouts of the network client.
+	 * \param[in]		handle			Network handle.
+	 * \param[in]		deadlineMs		Deadline as returned by #KSI_getTimeMs plus the time budget
+	 * 									in milliseconds, 0 to remove the deadline.
+	 *
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note Handles inherit the deadline set by #KSI_CTX_setRequestDeadline or
+	 * #KSI_CTX_setRequestTimeoutMs when they are created. A deadline set afterwards is enforced
+	 * by the network client while it waits for the response, but the host name resolution of
+	 * the TCP client is blocking and can only be checked before and after it.
+	 */
+	int KSI_RequestHandle_setDeadline(KSI_RequestHandle *handle, KSI_uint64_t deadlineMs);
+
+	/**
+	 * Returns the absolute deadline of the request, 0 if the request has no deadline.
+	 * \param[in]		handle			Network handle.
+	 * \param[out]		deadlineMs		Pointer to the receiving variable.
+	 *
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \see #KSI_RequestHandle_setDeadline
+	 */
+	int KSI_RequestHandle_getDeadline(const KSI_RequestHandle *handle, KSI_uint64_t *deadlineMs);
+
 	/**
 	 * TODO!
 	 */
@@ -54,6 +54,11 @@ static int setIntParam(int *param, int val) {
 	return KSI_OK;
 }
 
+static int setSizeParam(size_t *param, size_t val) {
+	*param = val;
+	return KSI_OK;
+}
+
 static int prepareRequest(
 		KSI_NetworkClient *client,
 		void *pdu,
@@ -209,6 +214,23 @@ static int preparePublicationsFileRequest(KSI_NetworkClient *client, KSI_Request
 		goto cleanup;
 	}
 
+	/* Revalidate the publications file the context already has. */
+	if (client->ctx->publicationsFileIfNoneMatch != NULL) {
+		res = setStringParam(&tmp->ifNoneMatch, client->ctx->publicationsFileIfNoneMatch);
+		if (res != KSI_OK) {
+			KSI_pushError(client->ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	if (client->ctx->publicationsFileIfModifiedSince != NULL) {
+		res = setStringParam(&tmp->ifModifiedSince, client->ctx->publicationsFileIfModifiedSince);
+		if (res != KSI_OK) {
+			KSI_pushError(client->ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
 	res = http->sendRequest(client, tmp, http->urlPublication);
 	if (res != KSI_OK) {
 		KSI_pushError(client->ctx, res, NULL);
@@ -222,6 +244,8 @@ static int preparePublicationsFileRequest(KSI_NetworkClient *client, KSI_Request
 
 cleanup:
 
+	KSI_RequestHandle_free(tmp);
+
 	return res;
 }
 
@@ -241,6 +265,11 @@ void KSI_HttpClient_free(KSI_HttpClient *http) {
 	KSI_NetworkClient_free((KSI_NetworkClient*)http);
 }
 
+static int getPublicationUrl(KSI_NetworkClient *client, const char **url) {
+	*url = ((KSI_HttpClient *)client)->urlPublication;
+	return KSI_OK;
+}
+
 static int getHttpStatusCode(KSI_NetworkClient *client){
 	KSI_HttpClient *http = (KSI_HttpClient*)client;
 	return http->httpStatus;
@@ -271,11 +300,13 @@ int KSI_HttpClient_init(KSI_CTX *ctx, KSI_HttpClient *client) {
 	client->urlPublication = NULL;
 	client->urlAggregator = NULL;
 	client->httpStatus = 0;
+	client->maxPipelineDepth = 0;
 
 	client->parent.sendExtendRequest = prepareExtendRequest;
 	client->parent.sendSignRequest = prepareAggregationRequest;
 	client->parent.sendPublicationRequest = preparePublicationsFileRequest;
 	client->parent.getStausCode = getHttpStatusCode;
+	client->parent.getPublicationUrl = getPublicationUrl;
 	client->parent.implFree = (void (*)(void *))httpClient_free;
 
 
@@ -352,6 +383,7 @@ cleanup:
 KSI_NET_IMPLEMENT_SETTER(PublicationUrl, const char *, urlPublication, setStringParam);
 KSI_NET_IMPLEMENT_SETTER(ConnectTimeoutSeconds, int, connectionTimeoutSeconds, setIntParam);
 KSI_NET_IMPLEMENT_SETTER(ReadTimeoutSeconds, int, readTimeoutSeconds, setIntParam);
+KSI_NET_IMPLEMENT_SETTER(MaxPipelineDepth, size_t, maxPipelineDepth, setSizeParam);
 
 int KSI_HttpClient_setExtender(KSI_HttpClient *client, const char *url, const char *user, const char *pass) {
 	int res = KSI_UNKNOWN_ERROR;
@@ -84,6 +84,17 @@ int KSI_HttpClient_setConnectTimeoutSeconds(KSI_HttpClient *client, int val);
  */
 int KSI_HttpClient_setReadTimeoutSeconds(KSI_HttpClient *client, int val);
 
+/**
+ * Setter for the maximum number of requests sent on a keep-alive connection before their
+ * responses have arrived. The default 0 disables pipelining.
+ * \param[in]	client		Pointer to the http client.
+ * \param[in]	val			Maximum number of requests in flight.
+ * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+ * \note Only the native HTTP client (configure option \c --with-net-provider=native) pipelines
+ * the requests, the other implementations ignore this setting.
+ */
+int KSI_HttpClient_setMaxPipelineDepth(KSI_HttpClient *client, size_t val);
+
 /**
  * Setter for the http client extender parameters.
  * \param[in]	client		Pointer to http client.
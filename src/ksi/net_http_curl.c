@@ -29,13 +29,49 @@
 
 static size_t curlGlobal_initCount = 0;
 
-typedef struct CurlNetHandleCtx_st {
+/** Maximum number of idle easy handles kept for reuse by a single client. */
+#define CURL_MAX_IDLE_HANDLES 8
+
+typedef struct CurlNetHandleCtx_st CurlNetHandleCtx;
+
+typedef struct CurlClientCtx_st {
+	/** Multi handle running all the transfers of the client, it also holds the connection cache. */
+	CURLM *multi;
+	/** Shared TLS session and DNS cache. */
+	CURLSH *share;
+	/** Idle easy handles kept for reuse. */
+	CURL *idle[CURL_MAX_IDLE_HANDLES];
+	/** Number of handles in #idle. */
+	size_t idleCount;
+	/** Transfers added to #multi. */
+	CurlNetHandleCtx *active;
+} CurlClientCtx;
+
+struct CurlNetHandleCtx_st {
 	KSI_CTX *ctx;
+	/** The handle this context belongs to. */
+	KSI_RequestHandle *handle;
+	/** Client running the transfer, \c NULL if the client has been freed. */
+	CurlClientCtx *client;
+	/** Easy handle of the transfer, \c NULL when not running. */
 	CURL *curl;
+	/** Received response body. */
 	unsigned char *raw;
-    unsigned len;
+	/** Number of bytes in #raw. */
+	size_t len;
+	/** Capacity of #raw. */
+	size_t raw_size;
     char *url;
-} CurlNetHandleCtx;
+    /** Request headers of a conditional request, \c NULL if there are none. */
+    struct curl_slist *headers;
+    /** Set once the transfer has finished. */
+    int done;
+    /** Status of the finished transfer. */
+    int status;
+    char curlErr[CURL_ERROR_SIZE];
+    /** Next transfer in #CurlClientCtx::active. */
+    CurlNetHandleCtx *next;
+};
 
 static int curlGlobal_init(void) {
 	int res = KSI_UNKNOWN_ERROR;
@@ -62,115 +98,349 @@ static void curlGlobal_cleanup(void) {
 	curl_global_cleanup();
 }
 
+/**
+ * Returns the easy handle to the pool of idle handles. The handle keeps its connections
+ * and TLS sessions for the following transfers.
+ */
+static void releaseEasyHandle(CurlClientCtx *cc, CURL *curl) {
+	if (curl == NULL) return;
+
+	if (cc == NULL || cc->idleCount >= CURL_MAX_IDLE_HANDLES) {
+		curl_easy_cleanup(curl);
+		return;
+	}
+
+	curl_easy_reset(curl);
+	cc->idle[cc->idleCount++] = curl;
+}
+
+/**
+ * Removes the transfer from the multi handle and from the list of active transfers.
+ */
+static void detachTransfer(CurlNetHandleCtx *nc) {
+	CurlNetHandleCtx **pp = NULL;
+
+	if (nc->client == NULL) return;
+
+	if (nc->curl != NULL) {
+		curl_multi_remove_handle(nc->client->multi, nc->curl);
+		releaseEasyHandle(nc->client, nc->curl);
+		nc->curl = NULL;
+	}
+
+	for (pp = &nc->client->active; *pp != NULL; pp = &(*pp)->next) {
+		if (*pp == nc) {
+			*pp = nc->next;
+			break;
+		}
+	}
+
+	nc->next = NULL;
+	nc->client = NULL;
+}
+
 static void CurlNetHandleCtx_free(CurlNetHandleCtx *handleCtx) {
 	if (handleCtx != NULL) {
+		detachTransfer(handleCtx);
+		curl_slist_free_all(handleCtx->headers);
 		KSI_free(handleCtx->url);
 		KSI_free(handleCtx->raw);
 		KSI_free(handleCtx);
 	}
 }
 
+static void CurlClientCtx_free(CurlClientCtx *cc) {
+	if (cc != NULL) {
+		/* Abort the transfers that are still running. */
+		while (cc->active != NULL) {
+			CurlNetHandleCtx *nc = cc->active;
+			detachTransfer(nc);
+			if (!nc->done) {
+				nc->done = 1;
+				nc->status = KSI_NETWORK_ERROR;
+				strncpy(nc->curlErr, "Network client has been freed.", sizeof(nc->curlErr));
+			}
+		}
+
+		while (cc->idleCount > 0) {
+			curl_easy_cleanup(cc->idle[--cc->idleCount]);
+		}
+
+		if (cc->multi != NULL) curl_multi_cleanup(cc->multi);
+		if (cc->share != NULL) curl_share_cleanup(cc->share);
+		KSI_free(cc);
+	}
+}
+
 static size_t receiveDataFromLibCurl(void *ptr, size_t size, size_t nmemb, void *stream) {
 	size_t bytesCount = 0;
-	unsigned char *tmp_buffer = NULL;
+	size_t chunkLen = size * nmemb;
 	CurlNetHandleCtx *nc = (CurlNetHandleCtx *) stream;
+	KSI_RequestHandle *handle = nc->handle;
 
 	KSI_LOG_debug(nc->ctx, "Curl: Receive data size=%lld, nmemb=%lld", size, nmemb);
 
-	bytesCount = nc->len + size * nmemb;
-	if (bytesCount > UINT_MAX) {
+	/* Hand the data over to the consumer instead of buffering it. */
+	if (handle->responseConsumer != NULL) {
+		if (handle->responseConsumer(handle, (const unsigned char *)ptr, chunkLen, handle->responseConsumerData) != KSI_OK) {
+			KSI_snprintf(nc->curlErr, sizeof(nc->curlErr), "Response consumer failed.");
+			goto cleanup;
+		}
+		bytesCount = chunkLen;
 		goto cleanup;
 	}
-	tmp_buffer = KSI_calloc(bytesCount, 1);
-	if (tmp_buffer == NULL) goto cleanup;
 
-	memcpy(tmp_buffer, nc->raw, nc->len);
-	memcpy(tmp_buffer + nc->len, ptr, size * nmemb);
+	if (nc->len + chunkLen < nc->len) goto cleanup;
 
-	KSI_free(nc->raw);
-	nc->raw = tmp_buffer;
-	nc->len = (unsigned)bytesCount;
-	tmp_buffer = NULL;
+	if (nc->len + chunkLen > nc->raw_size) {
+		size_t newSize = nc->raw_size * 2;
+		unsigned char *tmp = NULL;
 
-	bytesCount = size * nmemb;
+		/* Allocate the whole body at once, if the length is known. */
+		if (nc->raw == NULL) {
+			double contentLength = -1;
+			if (curl_easy_getinfo(nc->curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD, &contentLength) == CURLE_OK && contentLength > 0 && contentLength < (double)UINT_MAX) {
+				newSize = (size_t)contentLength;
+			}
+		}
+
+		if (newSize < nc->len + chunkLen) newSize = nc->len + chunkLen;
+
+		tmp = KSI_realloc(nc->raw, newSize);
+		if (tmp == NULL) goto cleanup;
+
+		nc->raw = tmp;
+		nc->raw_size = newSize;
+	}
+
+	memcpy(nc->raw + nc->len, ptr, chunkLen);
+	nc->len += chunkLen;
+
+	bytesCount = chunkLen;
 
 cleanup:
 
-	KSI_free(tmp_buffer);
 	return bytesCount;
 }
 
-static int curlReceive(KSI_RequestHandle *handle) {
+static size_t receiveHeaderFromLibCurl(char *ptr, size_t size, size_t nmemb, void *stream) {
+	size_t len = size * nmemb;
+	CurlNetHandleCtx *nc = (CurlNetHandleCtx *) stream;
+	const char *colon = NULL;
+
+	/* The status line starts a new response, e.g. after a redirect. */
+	if (len >= 5 && strncmp(ptr, "HTTP/", 5) == 0) {
+		KSI_free(nc->handle->etag);
+		nc->handle->etag = NULL;
+		KSI_free(nc->handle->lastModified);
+		nc->handle->lastModified = NULL;
+		return len;
+	}
+
+	colon = memchr(ptr, ':', len);
+	if (colon != NULL) {
+		if (KSI_RequestHandle_setResponseHeader(nc->handle, ptr, (size_t)(colon - ptr), colon + 1, len - (size_t)(colon - ptr) - 1) != KSI_OK) return 0;
+	}
+
+	return len;
+}
+
+/**
+ * Finalizes a finished transfer and completes the request handle.
+ */
+static void transferDone(CurlNetHandleCtx *nc, CURLcode result) {
+	KSI_HttpClient *http = (KSI_HttpClient *)nc->handle->client;
+	long httpCode = 0;
+
+	if (result == CURLE_OK || result == CURLE_HTTP_RETURNED_ERROR) {
+		if (result == CURLE_HTTP_RETURNED_ERROR && curl_easy_getinfo(nc->curl, CURLINFO_HTTP_CODE, &httpCode) == CURLE_OK) {
+			KSI_LOG_debug(nc->ctx, "Received HTTP error code %d. Curl error '%s'.", httpCode, nc->curlErr);
+			http->httpStatus = httpCode;
+		}
+
+		if (result == CURLE_OK && curl_easy_getinfo(nc->curl, CURLINFO_RESPONSE_CODE, &httpCode) == CURLE_OK && httpCode == 304) {
+			nc->handle->notModified = 1;
+		}
+
+		/* Pass the received buffer to the handle. */
+		KSI_RequestHandle_setResponseBuffer(nc->handle, nc->raw, nc->len);
+		nc->raw = NULL;
+		nc->len = 0;
+		nc->raw_size = 0;
+
+		nc->status = KSI_OK;
+	} else if (result == CURLE_OPERATION_TIMEDOUT) {
+		nc->status = KSI_NETWORK_RECIEVE_TIMEOUT;
+	} else {
+		nc->status = KSI_NETWORK_ERROR;
+	}
+
+	nc->done = 1;
+
+	detachTransfer(nc);
+
+	KSI_RequestHandle_complete(nc->handle, nc->status);
+}
+
+/**
+ * Runs all the transfers of the client as far as possible without blocking.
+ */
+static int curlMultiPerform(CurlClientCtx *cc, KSI_CTX *ctx) {
 	int res = KSI_UNKNOWN_ERROR;
-	char curlErr[CURL_ERROR_SIZE];
-	CurlNetHandleCtx *implCtx = NULL;
-	KSI_HttpClient *http = NULL;
+	int running = 0;
+	int left = 0;
+	CURLMsg *msg = NULL;
 
-	if (handle == NULL || handle->client == NULL || handle->implCtx == NULL) {
+	if (curl_multi_perform(cc->multi, &running) != CURLM_OK) {
+		KSI_pushError(ctx, res = KSI_NETWORK_ERROR, "Unable to perform the transfers.");
+		goto cleanup;
+	}
+
+	while ((msg = curl_multi_info_read(cc->multi, &left)) != NULL) {
+		CurlNetHandleCtx *nc = NULL;
+
+		if (msg->msg != CURLMSG_DONE) continue;
+
+		if (curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&nc) == CURLE_OK && nc != NULL) {
+			transferDone(nc, msg->data.result);
+		}
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/**
+ * Aborts the transfer, if the deadline of the request has passed. Curl enforces the deadline
+ * known at the time the transfer was started, this catches a deadline set afterwards.
+ */
+static void checkDeadline(CurlNetHandleCtx *nc) {
+	if (nc->done || !KSI_RequestHandle_isExpired(nc->handle)) return;
+
+	detachTransfer(nc);
+	nc->done = 1;
+	nc->status = KSI_NETWORK_RECIEVE_TIMEOUT;
+	KSI_snprintf(nc->curlErr, sizeof(nc->curlErr), "Request deadline has passed.");
+}
+
+static int curlPerform(KSI_RequestHandle *handle, int events) {
+	int res = KSI_UNKNOWN_ERROR;
+	CurlNetHandleCtx *nc = NULL;
+
+	/* Curl keeps track of its sockets itself. */
+	(void)events;
+
+	if (handle == NULL || handle->implCtx == NULL) {
 		res = KSI_INVALID_ARGUMENT;
 		goto cleanup;
 	}
-	KSI_ERR_clearErrors(handle->ctx);
 
-	http = (KSI_HttpClient *)handle->client;
+	nc = handle->implCtx;
 
-	implCtx = handle->implCtx;
+	if (!nc->done && nc->client != NULL) {
+		res = curlMultiPerform(nc->client, handle->ctx);
+		if (res != KSI_OK) {
+			KSI_pushError(handle->ctx, res, NULL);
+			goto cleanup;
+		}
+		checkDeadline(nc);
+	}
 
-    curl_easy_setopt(implCtx->curl, CURLOPT_ERRORBUFFER, curlErr);
-    if (http->agentName != NULL) {
-    	curl_easy_setopt(implCtx->curl, CURLOPT_USERAGENT, http->agentName);
-    }
+	if (!nc->done) {
+		res = KSI_ASYNC_NOT_FINISHED;
+		goto cleanup;
+	}
 
-	if (handle->request != NULL) {
-		curl_easy_setopt(implCtx->curl, CURLOPT_POST, 1);
-		curl_easy_setopt(implCtx->curl, CURLOPT_POSTFIELDS, (char *)handle->request);
-		curl_easy_setopt(implCtx->curl, CURLOPT_POSTFIELDSIZE, (long)handle->request_length);
-	} else {
-		curl_easy_setopt(implCtx->curl, CURLOPT_POST, 0);
+	res = nc->status;
+	if (res != KSI_OK) {
+		KSI_pushError(handle->ctx, res, nc->curlErr);
+		goto cleanup;
 	}
 
-    curl_easy_setopt(implCtx->curl, CURLOPT_WRITEDATA, implCtx);
+cleanup:
 
-    curl_easy_setopt(implCtx->curl, CURLOPT_CONNECTTIMEOUT, http->connectionTimeoutSeconds);
-    curl_easy_setopt(implCtx->curl, CURLOPT_TIMEOUT, http->readTimeoutSeconds);
+	return res;
+}
 
-	curl_easy_setopt(implCtx->curl, CURLOPT_URL, implCtx->url);
+static int curlGetPollInfo(KSI_RequestHandle *handle, int *fd, int *events, int *timeoutMs) {
+	CurlNetHandleCtx *nc = handle->implCtx;
+	long timeout = -1;
 
-    res = curl_easy_perform(implCtx->curl);
-    if (res != CURLE_OK) {
-    	long httpCode;
-    	if (res == CURLE_HTTP_RETURNED_ERROR && curl_easy_getinfo(implCtx->curl, CURLINFO_HTTP_CODE, &httpCode) == CURLE_OK) {
-    		KSI_LOG_debug(handle->ctx, "Received HTTP error code %d. Curl error '%s'.", httpCode, curlErr);
-			http->httpStatus = httpCode;
-		} else {
-    		KSI_pushError(handle->ctx, res = KSI_NETWORK_ERROR, curlErr);
-			goto cleanup;
-    	}
+	/* The transfers may use several sockets, so only the timeout is reported. */
+	*fd = -1;
+	*events = 0;
+	*timeoutMs = 0;
+
+	if (nc->client != NULL && !nc->done) {
+		curl_multi_timeout(nc->client->multi, &timeout);
+		/* Without a timeout from curl, check the sockets at a reasonable interval. */
+		if (timeout < 0 || timeout > 100) timeout = 100;
+		*timeoutMs = (int)timeout;
 	}
 
-    res = KSI_RequestHandle_setResponse(handle, implCtx->raw, implCtx->len);
-    if (res != KSI_OK) {
-    	KSI_pushError(handle->ctx, res, NULL);
-    	goto cleanup;
-    }
+	return KSI_OK;
+}
 
-    /* Cleanup on success.*/
-    KSI_free(implCtx->raw);
-    implCtx->raw = NULL;
-    implCtx->len = 0;
+static int curlReceive(KSI_RequestHandle *handle) {
+	int res = KSI_UNKNOWN_ERROR;
+	CurlNetHandleCtx *nc = NULL;
 
-    res = KSI_OK;
+	if (handle == NULL || handle->client == NULL || handle->implCtx == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(handle->ctx);
+
+	nc = handle->implCtx;
+
+	/* Run all the transfers of the client until this one has finished. */
+	while (!nc->done && nc->client != NULL) {
+		int numfds = 0;
+
+		res = curlMultiPerform(nc->client, handle->ctx);
+		if (res != KSI_OK) {
+			KSI_pushError(handle->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		checkDeadline(nc);
+		if (nc->done) break;
+
+		if (curl_multi_wait(nc->client->multi, NULL, 0, KSI_RequestHandle_remainingMs(handle, 1000), &numfds) != CURLM_OK) {
+			KSI_pushError(handle->ctx, res = KSI_NETWORK_ERROR, "Unable to wait for the transfers.");
+			goto cleanup;
+		}
+	}
+
+	if (nc->status != KSI_OK) {
+		KSI_pushError(handle->ctx, res = nc->status, nc->curlErr);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
 
 cleanup:
 
 	return res;
 }
 
+/**
+ * Takes an idle easy handle from the pool, or creates a new one.
+ */
+static CURL *acquireEasyHandle(CurlClientCtx *cc) {
+	if (cc->idleCount > 0) return cc->idle[--cc->idleCount];
+	return curl_easy_init();
+}
 
 static int sendRequest(KSI_NetworkClient *client, KSI_RequestHandle *handle, char *url) {
 	int res = KSI_UNKNOWN_ERROR;
 	CurlNetHandleCtx *implCtx = NULL;
 	KSI_HttpClient *http = (KSI_HttpClient *)client;
+	CurlClientCtx *cc = NULL;
+	CURL *curl = NULL;
 	size_t len;
 
 	if (client == NULL || handle == NULL || url == NULL) {
@@ -179,6 +449,8 @@ static int sendRequest(KSI_NetworkClient *client, KSI_RequestHandle *handle, cha
 	}
 	KSI_ERR_clearErrors(client->ctx);
 
+	cc = http->implCtx;
+
 	implCtx = KSI_new(CurlNetHandleCtx);
 	if (implCtx == NULL) {
 		KSI_pushError(client->ctx, res = KSI_OUT_OF_MEMORY, NULL);
@@ -186,13 +458,24 @@ static int sendRequest(KSI_NetworkClient *client, KSI_RequestHandle *handle, cha
 	}
 
 	implCtx->ctx = handle->ctx;
-	implCtx->curl = http->implCtx;
+	implCtx->handle = handle;
+	implCtx->client = NULL;
+	implCtx->curl = NULL;
 	implCtx->len = 0;
 	implCtx->raw = NULL;
+	implCtx->raw_size = 0;
+	implCtx->url = NULL;
+	implCtx->headers = NULL;
+	implCtx->done = 0;
+	implCtx->status = KSI_OK;
+	implCtx->curlErr[0] = '\0';
+	implCtx->next = NULL;
 
 	KSI_LOG_debug(handle->ctx, "Curl: Sending request to: %s", url);
 
 	handle->readResponse = curlReceive;
+	handle->perform = curlPerform;
+	handle->getPollInfo = curlGetPollInfo;
 	handle->client = client;
 
 	len = strlen(url) + 1;
@@ -203,6 +486,89 @@ static int sendRequest(KSI_NetworkClient *client, KSI_RequestHandle *handle, cha
 	}
 	strncpy(implCtx->url, url, len);
 
+	curl = acquireEasyHandle(cc);
+	if (curl == NULL) {
+		KSI_pushError(client->ctx, res = KSI_OUT_OF_MEMORY, "Unable to init CURL");
+		goto cleanup;
+	}
+
+	curl_easy_setopt(curl, CURLOPT_VERBOSE, 0);
+	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, receiveDataFromLibCurl);
+	curl_easy_setopt(curl, CURLOPT_WRITEDATA, implCtx);
+	curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 1);
+	/* Signals can not be used for timeouts in multi-threaded applications. */
+	curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1);
+	curl_easy_setopt(curl, CURLOPT_SHARE, cc->share);
+	curl_easy_setopt(curl, CURLOPT_PRIVATE, (char *)implCtx);
+	curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, implCtx->curlErr);
+	if (http->agentName != NULL) {
+		curl_easy_setopt(curl, CURLOPT_USERAGENT, http->agentName);
+	}
+
+	if (handle->ifNoneMatch != NULL || handle->ifModifiedSince != NULL) {
+		char header[1024];
+		struct curl_slist *list = NULL;
+
+		if (handle->ifNoneMatch != NULL) {
+			KSI_snprintf(header, sizeof(header), "If-None-Match: %s", handle->ifNoneMatch);
+			list = curl_slist_append(implCtx->headers, header);
+			if (list == NULL) {
+				KSI_pushError(client->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+				goto cleanup;
+			}
+			implCtx->headers = list;
+		}
+
+		if (handle->ifModifiedSince != NULL) {
+			KSI_snprintf(header, sizeof(header), "If-Modified-Since: %s", handle->ifModifiedSince);
+			list = curl_slist_append(implCtx->headers, header);
+			if (list == NULL) {
+				KSI_pushError(client->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+				goto cleanup;
+			}
+			implCtx->headers = list;
+		}
+
+		curl_easy_setopt(curl, CURLOPT_HTTPHEADER, implCtx->headers);
+	}
+	curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, receiveHeaderFromLibCurl);
+	curl_easy_setopt(curl, CURLOPT_HEADERDATA, implCtx);
+
+	if (handle->request != NULL) {
+		curl_easy_setopt(curl, CURLOPT_POST, 1);
+		curl_easy_setopt(curl, CURLOPT_POSTFIELDS, (char *)handle->request);
+		curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)handle->request_length);
+	} else {
+		curl_easy_setopt(curl, CURLOPT_POST, 0);
+	}
+
+	curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, http->connectionTimeoutSeconds);
+	curl_easy_setopt(curl, CURLOPT_TIMEOUT, http->readTimeoutSeconds);
+
+	/* The total timeout of curl covers the name resolution and the connect as well. */
+	if (handle->deadline != 0) {
+		int remaining = KSI_RequestHandle_remainingMs(handle, http->readTimeoutSeconds > 0 ? http->readTimeoutSeconds * 1000 : -1);
+		if (remaining == 0) {
+			KSI_pushError(client->ctx, res = KSI_NETWORK_CONNECTION_TIMEOUT, "Request deadline has passed.");
+			goto cleanup;
+		}
+		curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, (long)remaining);
+	}
+
+	curl_easy_setopt(curl, CURLOPT_URL, implCtx->url);
+
+	/* The transfer is started by the next perform on any of the client's handles. */
+	if (curl_multi_add_handle(cc->multi, curl) != CURLM_OK) {
+		KSI_pushError(client->ctx, res = KSI_NETWORK_ERROR, "Unable to add the transfer.");
+		goto cleanup;
+	}
+
+	implCtx->curl = curl;
+	implCtx->client = cc;
+	implCtx->next = cc->active;
+	cc->active = implCtx;
+	curl = NULL;
+
     res = KSI_RequestHandle_setImplContext(handle, implCtx, (void (*)(void *))CurlNetHandleCtx_free);
     if (res != KSI_OK) {
     	KSI_pushError(handle->ctx, res, NULL);
@@ -215,6 +581,7 @@ static int sendRequest(KSI_NetworkClient *client, KSI_RequestHandle *handle, cha
 
 cleanup:
 
+	if (curl != NULL) releaseEasyHandle(cc, curl);
 	CurlNetHandleCtx_free(implCtx);
 
 	return res;
@@ -222,7 +589,7 @@ cleanup:
 
 int KSI_HttpClientImpl_init(KSI_HttpClient *http) {
 	int res = KSI_UNKNOWN_ERROR;
-	CURL *curl = NULL;
+	CurlClientCtx *cc = NULL;
 
 	if (http == NULL) {
 		res = KSI_INVALID_ARGUMENT;
@@ -234,21 +601,6 @@ int KSI_HttpClientImpl_init(KSI_HttpClient *http) {
 		goto cleanup;
 	}
 
-	curl = curl_easy_init();
-	if (curl == NULL) {
-		KSI_pushError(http->parent.ctx, res = KSI_OUT_OF_MEMORY, "Unable to init CURL");
-		goto cleanup;
-	}
-
-    curl_easy_setopt(curl, CURLOPT_VERBOSE, 0);
-	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, receiveDataFromLibCurl);
-	curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 1);
-	http->implCtx = curl;
-	http->implCtx_free = curl_easy_cleanup;
-	curl = NULL;
-
-	http->sendRequest = sendRequest;
-
 	/* Register global init and cleanup methods. */
 	res = KSI_CTX_registerGlobals(http->parent.ctx, curlGlobal_init, curlGlobal_cleanup);
 	if (res != KSI_OK) {
@@ -256,11 +608,36 @@ int KSI_HttpClientImpl_init(KSI_HttpClient *http) {
 		goto cleanup;
 	}
 
+	cc = KSI_new(CurlClientCtx);
+	if (cc == NULL) {
+		KSI_pushError(http->parent.ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	cc->idleCount = 0;
+	cc->active = NULL;
+	cc->multi = curl_multi_init();
+	cc->share = curl_share_init();
+	if (cc->multi == NULL || cc->share == NULL) {
+		KSI_pushError(http->parent.ctx, res = KSI_OUT_OF_MEMORY, "Unable to init CURL");
+		goto cleanup;
+	}
+
+	/* Reuse TLS sessions and resolved addresses across all the transfers of the client. */
+	curl_share_setopt(cc->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+	curl_share_setopt(cc->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+
+	http->implCtx = cc;
+	http->implCtx_free = (void (*)(void *))CurlClientCtx_free;
+	cc = NULL;
+
+	http->sendRequest = sendRequest;
+
 	res = KSI_OK;
 
 cleanup:
 
-	if (curl != NULL) curl_easy_cleanup(curl);
+	CurlClientCtx_free(cc);
 
 	return res;
 
@@ -34,6 +34,8 @@ extern "C" {
 		int connectionTimeoutSeconds;
 		int readTimeoutSeconds;
 		int httpStatus;
+		/** Maximum number of requests in flight on a connection, 0 disables pipelining. */
+		size_t maxPipelineDepth;
 		char *urlAggregator;
 		char *urlExtender;
 		char *urlPublication;
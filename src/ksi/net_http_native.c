@@ -0,0 +1,287 @@
+/*
+ * Copyright 2013-2015 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#include "internal.h"
+
+#if KSI_NET_HTTP_IMPL==KSI_IMPL_NATIVE
+
+#include <string.h>
+
+#include "net_http_impl.h"
+#include "net_tcp_impl.h"
+#include "net_impl.h"
+#include "http_parser.h"
+
+/** Default port of the http scheme. */
+#define HTTP_DEFAULT_PORT 80
+
+typedef struct NativeClientCtx_st {
+	/** TCP client providing the pooled and pipelined connections, created with the first request. */
+	KSI_TcpClient *tcp;
+} NativeClientCtx;
+
+static void NativeClientCtx_free(NativeClientCtx *nc) {
+	if (nc != NULL) {
+		KSI_TcpClient_free(nc->tcp);
+		KSI_free(nc);
+	}
+}
+
+/**
+ * Splits the URL into the host, port and the request target (path and query).
+ */
+static int splitUrl(KSI_CTX *ctx, const char *url, char **host, unsigned *port, char **target) {
+	int res = KSI_UNKNOWN_ERROR;
+	struct http_parser_url parser;
+	char *tmpHost = NULL;
+	char *tmpTarget = NULL;
+	size_t len;
+	size_t end;
+
+	memset(&parser, 0, sizeof(parser));
+
+	if (http_parser_parse_url(url, strlen(url), 0, &parser) != 0 || !(parser.field_set & (1 << UF_HOST))) {
+		KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Unable to parse the URL.");
+		goto cleanup;
+	}
+
+	if (!(parser.field_set & (1 << UF_SCHEMA)) || parser.field_data[UF_SCHEMA].len != 4 ||
+			strncmp(url + parser.field_data[UF_SCHEMA].off, "http", 4) != 0) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, "The native HTTP client supports only the http scheme.");
+		goto cleanup;
+	}
+
+	len = parser.field_data[UF_HOST].len;
+	tmpHost = KSI_malloc(len + 1);
+	if (tmpHost == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+	memcpy(tmpHost, url + parser.field_data[UF_HOST].off, len);
+	tmpHost[len] = '\0';
+
+	if (parser.field_set & (1 << UF_PATH)) {
+		/* The target runs from the path until the fragment, which is not sent. */
+		end = (parser.field_set & (1 << UF_FRAGMENT)) ? (size_t)parser.field_data[UF_FRAGMENT].off - 1 : strlen(url);
+		len = end - parser.field_data[UF_PATH].off;
+
+		tmpTarget = KSI_malloc(len + 1);
+		if (tmpTarget == NULL) {
+			KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+			goto cleanup;
+		}
+		memcpy(tmpTarget, url + parser.field_data[UF_PATH].off, len);
+		tmpTarget[len] = '\0';
+	} else {
+		res = KSI_strdup("/", &tmpTarget);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	*port = (parser.field_set & (1 << UF_PORT)) ? parser.port : HTTP_DEFAULT_PORT;
+	*host = tmpHost;
+	tmpHost = NULL;
+	*target = tmpTarget;
+	tmpTarget = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(tmpHost);
+	KSI_free(tmpTarget);
+
+	return res;
+}
+
+/**
+ * Serializes the HTTP/1.1 request. A request handle without a request body is sent as a GET
+ * request, otherwise the body is posted.
+ */
+static int buildRequest(KSI_HttpClient *http, KSI_RequestHandle *handle, const char *host, unsigned port, const char *target, unsigned char **raw, size_t *raw_len) {
+	int res = KSI_UNKNOWN_ERROR;
+	unsigned char *tmp = NULL;
+	size_t size;
+	size_t len;
+	const char *agent = http->agentName != NULL ? http->agentName : "";
+	/* An IPv6 address must be enclosed in brackets. */
+	const char *open = strchr(host, ':') != NULL ? "[" : "";
+	const char *close = strchr(host, ':') != NULL ? "]" : "";
+	/* Validators of a conditional request. */
+	const char *ifNoneMatch = handle->ifNoneMatch != NULL ? handle->ifNoneMatch : "";
+	const char *ifModifiedSince = handle->ifModifiedSince != NULL ? handle->ifModifiedSince : "";
+	char portStr[16];
+
+	portStr[0] = '\0';
+	if (port != HTTP_DEFAULT_PORT) KSI_snprintf(portStr, sizeof(portStr), ":%u", port);
+
+	size = strlen(target) + strlen(host) + strlen(agent) + strlen(ifNoneMatch) + strlen(ifModifiedSince) + 320 + handle->request_length;
+	tmp = KSI_malloc(size);
+	if (tmp == NULL) {
+		KSI_pushError(http->parent.ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	if (handle->request != NULL) {
+		len = KSI_snprintf((char *)tmp, size,
+				"POST %s HTTP/1.1\r\n"
+				"Host: %s%s%s%s\r\n"
+				"User-Agent: %s\r\n"
+				"Content-Type: application/ksi-request\r\n"
+				"Content-Length: %lu\r\n"
+				"Connection: keep-alive\r\n"
+				"\r\n",
+				target, open, host, close, portStr, agent, (unsigned long)handle->request_length);
+	} else {
+		len = KSI_snprintf((char *)tmp, size,
+				"GET %s HTTP/1.1\r\n"
+				"Host: %s%s%s%s\r\n"
+				"User-Agent: %s\r\n"
+				"%s%s%s"
+				"%s%s%s"
+				"Connection: keep-alive\r\n"
+				"\r\n",
+				target, open, host, close, portStr, agent,
+				*ifNoneMatch ? "If-None-Match: " : "", ifNoneMatch, *ifNoneMatch ? "\r\n" : "",
+				*ifModifiedSince ? "If-Modified-Since: " : "", ifModifiedSince, *ifModifiedSince ? "\r\n" : "");
+	}
+
+	if (len == 0 || len + handle->request_length >= size) {
+		KSI_pushError(http->parent.ctx, res = KSI_BUFFER_OVERFLOW, "Unable to serialize the HTTP request.");
+		goto cleanup;
+	}
+
+	if (handle->request != NULL) {
+		memcpy(tmp + len, handle->request, handle->request_length);
+		len += handle->request_length;
+	}
+
+	*raw = tmp;
+	*raw_len = len;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(tmp);
+
+	return res;
+}
+
+static int sendRequest(KSI_NetworkClient *client, KSI_RequestHandle *handle, char *url) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_HttpClient *http = (KSI_HttpClient *)client;
+	NativeClientCtx *nc = NULL;
+	char *host = NULL;
+	char *target = NULL;
+	unsigned port = 0;
+	unsigned char *raw = NULL;
+	size_t raw_len = 0;
+
+	if (client == NULL || handle == NULL || url == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(client->ctx);
+
+	nc = http->implCtx;
+
+	KSI_LOG_debug(handle->ctx, "Native: Sending request to: %s", url);
+
+	/* The TCP client owns an HTTP client itself, so it can not be created together with this one. */
+	if (nc->tcp == NULL) {
+		res = KSI_TcpClient_new(client->ctx, &nc->tcp);
+		if (res != KSI_OK) {
+			KSI_pushError(client->ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	nc->tcp->transferTimeoutSeconds = http->readTimeoutSeconds;
+	nc->tcp->maxPipelineDepth = http->maxPipelineDepth;
+
+	res = splitUrl(client->ctx, url, &host, &port, &target);
+	if (res != KSI_OK) {
+		KSI_pushError(client->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = buildRequest(http, handle, host, port, target, &raw, &raw_len);
+	if (res != KSI_OK) {
+		KSI_pushError(client->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	handle->client = client;
+
+	/* The ownership of the serialized request is passed to the TCP client. */
+	res = KSI_TcpClient_sendHttpRequest(nc->tcp, handle, host, port, raw, raw_len, &http->httpStatus);
+	raw = NULL;
+	if (res != KSI_OK) {
+		KSI_pushError(client->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(host);
+	KSI_free(target);
+	KSI_free(raw);
+
+	return res;
+}
+
+int KSI_HttpClientImpl_init(KSI_HttpClient *http) {
+	int res = KSI_UNKNOWN_ERROR;
+	NativeClientCtx *nc = NULL;
+
+	if (http == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	nc = KSI_new(NativeClientCtx);
+	if (nc == NULL) {
+		KSI_pushError(http->parent.ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	nc->tcp = NULL;
+
+	http->implCtx = nc;
+	http->implCtx_free = (void (*)(void *))NativeClientCtx_free;
+	nc = NULL;
+
+	http->sendRequest = sendRequest;
+
+	res = KSI_OK;
+
+cleanup:
+
+	NativeClientCtx_free(nc);
+
+	return res;
+}
+
+#endif
@@ -26,7 +26,7 @@
 extern "C" {
 #endif
 
-	#define KSI_NETWORK_CLIENT_INIT(ctx)  (KSI_NetworkClient) {(ctx), NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL}
+	#define KSI_NETWORK_CLIENT_INIT(ctx)  (KSI_NetworkClient) {(ctx), NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL}
 
 	struct KSI_NetworkClient_st {
 		KSI_CTX *ctx;
@@ -35,6 +35,8 @@ extern "C" {
 		int (*sendExtendRequest)(KSI_NetworkClient *, KSI_ExtendReq *, KSI_RequestHandle **);
 		int (*sendPublicationRequest)(KSI_NetworkClient *, KSI_RequestHandle **);
 		int (*getStausCode)(KSI_NetworkClient *);
+		/** Returns the publications file URL, \c NULL if the client can not tell it. */
+		int (*getPublicationUrl)(KSI_NetworkClient *, const char **);
 	
 		/** Aggregator user. */
 		char *aggrUser;
@@ -62,9 +64,42 @@ extern "C" {
 		unsigned char *response;
 		/** Length of the response. */
 		size_t response_length;
+		/** Parsed response, owns the memory of #response once set. */
+		KSI_TLV *responseTlv;
 
 		int (*readResponse)(KSI_RequestHandle *);
 
+		/** Non-blocking step function, \c NULL if the transport supports only blocking reads. */
+		int (*perform)(KSI_RequestHandle *, int events);
+		/** Returns the descriptor, events and timeout the non-blocking request is waiting for. */
+		int (*getPollInfo)(KSI_RequestHandle *, int *fd, int *events, int *timeoutMs);
+
+		/** Completion callback of the non-blocking request. */
+		KSI_RequestHandleCompletionCallback completionCb;
+		/** User data for #completionCb. */
+		void *completionCbData;
+		/** Set once the request has completed. */
+		int completed;
+		/** Final status of the completed request. */
+		int status;
+
+		/** Consumer of the streamed response body, \c NULL if the response is buffered. */
+		KSI_RequestHandleResponseConsumer responseConsumer;
+		/** User data for #responseConsumer. */
+		void *responseConsumerData;
+
+		/** Absolute deadline of the request as returned by #KSI_getTimeMs, 0 if there is none. */
+		KSI_uint64_t deadline;
+
+		/** Validators of a conditional HTTP request, \c NULL if not sent. */
+		char *ifNoneMatch;
+		char *ifModifiedSince;
+		/** Validators of the received HTTP response, \c NULL if not present. */
+		char *etag;
+		char *lastModified;
+		/** Set if the server answered the conditional request with 304 Not Modified. */
+		int notModified;
+
 		KSI_NetworkClient *client;
 
 		/** Additional context for the transport layer. */
@@ -72,6 +107,61 @@ extern "C" {
 		void (*implCtx_free)(void *);
 	};
 
+	/**
+	 * Marks the request as completed and calls the completion callback. Should be called only by the
+	 * network provider implementation, when a response is routed to a handle other than the one
+	 * being performed.
+	 * \param[in]		handle			Network handle.
+	 * \param[in]		status			Status of the request.
+	 */
+	void KSI_RequestHandle_complete(KSI_RequestHandle *handle, int status);
+
+	/**
+	 * Sets the response of the handle without copying it. The ownership of the buffer is
+	 * passed to the handle, and further on to the parsed response TLV, so the network provider
+	 * should receive the response straight into a buffer allocated with #KSI_malloc.
+	 * \param[in]		handle			Network handle.
+	 * \param[in]		response		Pointer to the response buffer.
+	 * \param[in]		response_len	Length of the response.
+	 */
+	void KSI_RequestHandle_setResponseBuffer(KSI_RequestHandle *handle, unsigned char *response, size_t response_len);
+
+	/**
+	 * Limits the time the network provider may wait for the request by its deadline.
+	 * \param[in]		handle			Network handle.
+	 * \param[in]		timeoutMs		Timeout of the operation in milliseconds, -1 for no limit.
+	 *
+	 * \return The smaller of \c timeoutMs and the time left until the deadline, 0 if the deadline
+	 * has passed and -1 if neither limits the wait.
+	 */
+	int KSI_RequestHandle_remainingMs(const KSI_RequestHandle *handle, int timeoutMs);
+
+	/**
+	 * Returns the URL the publications file is downloaded from by the network client.
+	 * \param[in]		client			Network client.
+	 * \param[out]		url				Pointer to the receiving pointer, set to \c NULL if not configured.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_NetworkClient_getPublicationUrl(KSI_NetworkClient *client, const char **url);
+
+	/**
+	 * Passes a header of the HTTP response to the handle. The validators of the response, the
+	 * \c ETag and \c Last-Modified headers, are kept; the other headers are ignored.
+	 * \param[in]		handle			Network handle.
+	 * \param[in]		name			Name of the header, not terminated.
+	 * \param[in]		name_len		Length of the name.
+	 * \param[in]		value			Value of the header, not terminated.
+	 * \param[in]		value_len		Length of the value.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_RequestHandle_setResponseHeader(KSI_RequestHandle *handle, const char *name, size_t name_len, const char *value, size_t value_len);
+
+	/**
+	 * Returns non-zero if the handle has a deadline and it has passed.
+	 * \param[in]		handle			Network handle.
+	 */
+	int KSI_RequestHandle_isExpired(const KSI_RequestHandle *handle);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,481 @@
+/*
+ * Copyright 2013-2015 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#include <string.h>
+#include <stdio.h>
+
+#ifdef _WIN32
+#  include <winsock2.h>
+#  include <ws2tcpip.h>
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#  include <netdb.h>
+#endif
+
+#include "internal.h"
+#include "net.h"
+#include "net_resolver.h"
+
+/* Time after which a cached entry is refreshed in the background. */
+#define RESOLVER_TTL_MS (60 * 1000)
+/* Time after which a failed background refresh is retried. */
+#define RESOLVER_RETRY_MS (5 * 1000)
+/* Time after which an entry that could not be refreshed is no longer used. */
+#define RESOLVER_EXPIRE_MS (15 * 60 * 1000)
+/* Maximum number of hosts in the cache. */
+#define RESOLVER_MAX_ENTRIES 64
+
+#ifdef _WIN32
+	typedef CRITICAL_SECTION ResolverMutex;
+	typedef CONDITION_VARIABLE ResolverCond;
+	typedef HANDLE ResolverThread;
+#else
+	typedef pthread_mutex_t ResolverMutex;
+	typedef pthread_cond_t ResolverCond;
+	typedef pthread_t ResolverThread;
+#endif
+
+typedef struct ResolverEntry_st ResolverEntry;
+
+struct ResolverEntry_st {
+	char *host;
+	unsigned port;
+	/** The resolved addresses. */
+	KSI_ResolvedAddr addrs[KSI_RESOLVER_MAX_ADDRS];
+	/** Number of addresses in #addrs. */
+	size_t addrs_len;
+	/** Index of the address the next lookup starts from. */
+	size_t rotation;
+	/** Time after which the entry should be refreshed. */
+	KSI_uint64_t refreshAt;
+	/** Time after which the entry must not be used. */
+	KSI_uint64_t expiresAt;
+	/** Time of the last lookup, for evicting the least recently used entry. */
+	KSI_uint64_t lastUsed;
+	/** Set while the entry is queued for or being refreshed - such entries are never evicted. */
+	int refreshing;
+	ResolverEntry *next;
+};
+
+static struct {
+	/** Protects all the fields of the resolver. */
+	ResolverMutex lock;
+	/** Signalled when an entry needs refreshing or the thread should stop. */
+	ResolverCond wake;
+	ResolverThread thread;
+	/** Set while the background thread is running. */
+	int running;
+	/** Set to ask the background thread to stop. */
+	int stop;
+	/** Number of pending #KSI_Resolver_global_init calls. */
+	size_t initCount;
+	ResolverEntry *entries;
+	size_t entries_len;
+} resolver;
+
+#ifdef _WIN32
+static INIT_ONCE resolverOnce = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK resolverOnceInit(PINIT_ONCE once, PVOID param, PVOID *context) {
+	(void)once;
+	(void)param;
+	(void)context;
+	InitializeCriticalSection(&resolver.lock);
+	InitializeConditionVariable(&resolver.wake);
+	return TRUE;
+}
+
+static void resolverInit(void) {
+	InitOnceExecuteOnce(&resolverOnce, resolverOnceInit, NULL, NULL);
+}
+
+static void mutexLock(void) {
+	EnterCriticalSection(&resolver.lock);
+}
+
+static void mutexUnlock(void) {
+	LeaveCriticalSection(&resolver.lock);
+}
+
+static void condWait(void) {
+	SleepConditionVariableCS(&resolver.wake, &resolver.lock, INFINITE);
+}
+
+static void condSignal(void) {
+	WakeConditionVariable(&resolver.wake);
+}
+#else
+static pthread_once_t resolverOnce = PTHREAD_ONCE_INIT;
+
+static void resolverOnceInit(void) {
+	pthread_mutex_init(&resolver.lock, NULL);
+	pthread_cond_init(&resolver.wake, NULL);
+}
+
+static void resolverInit(void) {
+	pthread_once(&resolverOnce, resolverOnceInit);
+}
+
+static void mutexLock(void) {
+	pthread_mutex_lock(&resolver.lock);
+}
+
+static void mutexUnlock(void) {
+	pthread_mutex_unlock(&resolver.lock);
+}
+
+static void condWait(void) {
+	pthread_cond_wait(&resolver.wake, &resolver.lock);
+}
+
+static void condSignal(void) {
+	pthread_cond_signal(&resolver.wake);
+}
+#endif
+
+static void ResolverEntry_free(ResolverEntry *entry) {
+	if (entry != NULL) {
+		KSI_free(entry->host);
+		KSI_free(entry);
+	}
+}
+
+/**
+ * Resolves the host with \c getaddrinfo, without touching the cache.
+ */
+static int resolve(const char *host, unsigned port, KSI_ResolvedAddr *addrs, size_t addrs_len, size_t *count) {
+	int res;
+	struct addrinfo hints;
+	struct addrinfo *list = NULL;
+	struct addrinfo *ai = NULL;
+	char service[16];
+	size_t n = 0;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+
+	KSI_snprintf(service, sizeof(service), "%u", port);
+
+	if (getaddrinfo(host, service, &hints, &list) != 0) {
+		res = KSI_NETWORK_ERROR;
+		goto cleanup;
+	}
+
+	for (ai = list; ai != NULL && n < addrs_len; ai = ai->ai_next) {
+		if (ai->ai_family != AF_INET && ai->ai_family != AF_INET6) continue;
+		if (ai->ai_addrlen > sizeof(addrs[n].addr)) continue;
+
+		addrs[n].family = ai->ai_family;
+		addrs[n].addr_len = (int)ai->ai_addrlen;
+		memcpy(&addrs[n].addr, ai->ai_addr, ai->ai_addrlen);
+		n++;
+	}
+
+	if (n == 0) {
+		res = KSI_NETWORK_ERROR;
+		goto cleanup;
+	}
+
+	*count = n;
+
+	res = KSI_OK;
+
+cleanup:
+
+	if (list != NULL) freeaddrinfo(list);
+
+	return res;
+}
+
+static ResolverEntry *findEntry(const char *host, unsigned port) {
+	ResolverEntry *entry = NULL;
+
+	for (entry = resolver.entries; entry != NULL; entry = entry->next) {
+		if (entry->port == port && !strcmp(entry->host, host)) break;
+	}
+
+	return entry;
+}
+
+/**
+ * Removes the least recently used entry that is not being refreshed.
+ */
+static void evictEntry(void) {
+	ResolverEntry **pp = NULL;
+	ResolverEntry **lru = NULL;
+	ResolverEntry *tmp = NULL;
+
+	for (pp = &resolver.entries; *pp != NULL; pp = &(*pp)->next) {
+		if ((*pp)->refreshing) continue;
+		if (lru == NULL || (*pp)->lastUsed < (*lru)->lastUsed) lru = pp;
+	}
+
+	if (lru == NULL) return;
+
+	tmp = *lru;
+	*lru = tmp->next;
+	resolver.entries_len--;
+
+	ResolverEntry_free(tmp);
+}
+
+/**
+ * Copies the addresses of the entry starting from the next one in turn. Must be called
+ * with the lock held.
+ */
+static void takeAddresses(ResolverEntry *entry, KSI_ResolvedAddr *addrs, size_t addrs_len, size_t *count, KSI_uint64_t now) {
+	size_t i;
+	size_t n = entry->addrs_len < addrs_len ? entry->addrs_len : addrs_len;
+
+	for (i = 0; i < n; i++) {
+		addrs[i] = entry->addrs[(entry->rotation + i) % entry->addrs_len];
+	}
+
+	entry->rotation = (entry->rotation + 1) % entry->addrs_len;
+	entry->lastUsed = now;
+
+	*count = n;
+}
+
+static void updateEntry(ResolverEntry *entry, const KSI_ResolvedAddr *addrs, size_t addrs_len, KSI_uint64_t now) {
+	memcpy(entry->addrs, addrs, addrs_len * sizeof(KSI_ResolvedAddr));
+	entry->addrs_len = addrs_len;
+	entry->rotation = 0;
+	entry->refreshAt = now + RESOLVER_TTL_MS;
+	entry->expiresAt = now + RESOLVER_EXPIRE_MS;
+}
+
+/**
+ * Refreshes the entries queued by #KSI_Resolver_lookup until asked to stop.
+ */
+static void refreshLoop(void) {
+	mutexLock();
+
+	for (;;) {
+		ResolverEntry *entry = NULL;
+		KSI_ResolvedAddr addrs[KSI_RESOLVER_MAX_ADDRS];
+		size_t addrs_len = 0;
+		int res;
+
+		for (entry = resolver.entries; entry != NULL; entry = entry->next) {
+			if (entry->refreshing) break;
+		}
+
+		if (resolver.stop) break;
+
+		if (entry == NULL) {
+			condWait();
+			continue;
+		}
+
+		/* Do not block the lookups while resolving - the entry is not evicted meanwhile. */
+		mutexUnlock();
+		res = resolve(entry->host, entry->port, addrs, KSI_RESOLVER_MAX_ADDRS, &addrs_len);
+		mutexLock();
+
+		if (res == KSI_OK) {
+			updateEntry(entry, addrs, addrs_len, KSI_getTimeMs());
+		} else {
+			/* Keep serving the old addresses until the entry expires. */
+			entry->refreshAt = KSI_getTimeMs() + RESOLVER_RETRY_MS;
+		}
+		entry->refreshing = 0;
+	}
+
+	mutexUnlock();
+}
+
+#ifdef _WIN32
+static DWORD WINAPI refreshThread(LPVOID arg) {
+	(void)arg;
+	refreshLoop();
+	return 0;
+}
+#else
+static void *refreshThread(void *arg) {
+	(void)arg;
+	refreshLoop();
+	return NULL;
+}
+#endif
+
+int KSI_Resolver_global_init(void) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	resolverInit();
+
+	mutexLock();
+
+	if (resolver.initCount++ > 0) {
+		/* Nothing to do. */
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	resolver.stop = 0;
+#ifdef _WIN32
+	resolver.thread = CreateThread(NULL, 0, refreshThread, NULL, 0, NULL);
+	resolver.running = resolver.thread != NULL;
+#else
+	resolver.running = pthread_create(&resolver.thread, NULL, refreshThread, NULL) == 0;
+#endif
+
+	/* Without the thread the entries are refreshed on lookup. */
+	res = KSI_OK;
+
+cleanup:
+
+	mutexUnlock();
+
+	return res;
+}
+
+void KSI_Resolver_global_cleanup(void) {
+	int running;
+
+	resolverInit();
+
+	mutexLock();
+
+	if (resolver.initCount == 0 || --resolver.initCount > 0) {
+		mutexUnlock();
+		return;
+	}
+
+	running = resolver.running;
+	resolver.stop = 1;
+	resolver.running = 0;
+	condSignal();
+
+	mutexUnlock();
+
+	if (running) {
+#ifdef _WIN32
+		WaitForSingleObject(resolver.thread, INFINITE);
+		CloseHandle(resolver.thread);
+#else
+		pthread_join(resolver.thread, NULL);
+#endif
+	}
+
+	mutexLock();
+
+	/* Do not clear the cache if the resolver was initialized again meanwhile. */
+	if (resolver.initCount == 0) {
+		while (resolver.entries != NULL) {
+			ResolverEntry *tmp = resolver.entries;
+			resolver.entries = tmp->next;
+			ResolverEntry_free(tmp);
+		}
+		resolver.entries_len = 0;
+	}
+
+	mutexUnlock();
+}
+
+int KSI_Resolver_lookup(const char *host, unsigned port, KSI_ResolvedAddr *addrs, size_t addrs_len, size_t *count) {
+	int res = KSI_UNKNOWN_ERROR;
+	ResolverEntry *entry = NULL;
+	ResolverEntry *tmp = NULL;
+	KSI_ResolvedAddr resolved[KSI_RESOLVER_MAX_ADDRS];
+	size_t resolved_len = 0;
+	KSI_uint64_t now;
+
+	if (host == NULL || addrs == NULL || addrs_len == 0 || count == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	resolverInit();
+
+	now = KSI_getTimeMs();
+
+	mutexLock();
+
+	entry = findEntry(host, port);
+	if (entry != NULL && now < entry->expiresAt && (now < entry->refreshAt || resolver.running)) {
+		if (now >= entry->refreshAt && !entry->refreshing) {
+			entry->refreshing = 1;
+			condSignal();
+		}
+
+		takeAddresses(entry, addrs, addrs_len, count, now);
+
+		mutexUnlock();
+
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	mutexUnlock();
+
+	/* Nothing usable in the cache - resolve on the calling thread. */
+	res = resolve(host, port, resolved, KSI_RESOLVER_MAX_ADDRS, &resolved_len);
+	if (res != KSI_OK) goto cleanup;
+
+	now = KSI_getTimeMs();
+
+	mutexLock();
+
+	entry = findEntry(host, port);
+	if (entry == NULL) {
+		tmp = KSI_new(ResolverEntry);
+		if (tmp == NULL) {
+			mutexUnlock();
+			res = KSI_OUT_OF_MEMORY;
+			goto cleanup;
+		}
+
+		tmp->host = NULL;
+		tmp->port = port;
+		tmp->refreshing = 0;
+		tmp->next = NULL;
+
+		res = KSI_strdup(host, &tmp->host);
+		if (res != KSI_OK) {
+			mutexUnlock();
+			goto cleanup;
+		}
+
+		if (resolver.entries_len >= RESOLVER_MAX_ENTRIES) evictEntry();
+
+		tmp->next = resolver.entries;
+		resolver.entries = tmp;
+		resolver.entries_len++;
+
+		entry = tmp;
+		tmp = NULL;
+	}
+
+	updateEntry(entry, resolved, resolved_len, now);
+	takeAddresses(entry, addrs, addrs_len, count, now);
+
+	mutexUnlock();
+
+	res = KSI_OK;
+
+cleanup:
+
+	ResolverEntry_free(tmp);
+
+	return res;
+}
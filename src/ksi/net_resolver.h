@@ -0,0 +1,82 @@
+/*
+ * Copyright 2013-2015 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#ifndef NET_RESOLVER_H_
+#define NET_RESOLVER_H_
+
+#ifdef _WIN32
+#  include <winsock2.h>
+#  include <ws2tcpip.h>
+#else
+#  include <sys/types.h>
+#  include <sys/socket.h>
+#endif
+
+#include "ksi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/** Maximum number of addresses kept for a host. */
+#define KSI_RESOLVER_MAX_ADDRS 8
+
+	/**
+	 * A resolved socket address of a host.
+	 */
+	typedef struct KSI_ResolvedAddr_st {
+		/** Address family, \c AF_INET or \c AF_INET6. */
+		int family;
+		/** Length of #addr. */
+		int addr_len;
+		/** The socket address, including the port. */
+		struct sockaddr_storage addr;
+	} KSI_ResolvedAddr;
+
+	/**
+	 * Global initialization of the resolver, starts the background refresh thread. To be
+	 * registered with #KSI_CTX_registerGlobals.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_Resolver_global_init(void);
+
+	/**
+	 * Global cleanup of the resolver, stops the background refresh thread and clears the cache.
+	 */
+	void KSI_Resolver_global_cleanup(void);
+
+	/**
+	 * Resolves the host name using the process-wide cache. Only the first lookup of a host
+	 * blocks - expired entries are returned as they are while they are refreshed in the
+	 * background. The addresses are rotated, so consecutive lookups start from a different
+	 * address of the host. This function may be called concurrently from several threads.
+	 * \param[in]		host		Host name or numeric address.
+	 * \param[in]		port		Port number.
+	 * \param[out]		addrs		Array receiving the addresses.
+	 * \param[in]		addrs_len	Length of the \c addrs array.
+	 * \param[out]		count		Number of addresses written to \c addrs.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_Resolver_lookup(const char *host, unsigned port, KSI_ResolvedAddr *addrs, size_t addrs_len, size_t *count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NET_RESOLVER_H_ */
@@ -18,189 +18,1839 @@
  */
 
 #include <string.h>
+#include <time.h>
 #include "internal.h"
 #include "net_http_impl.h"
 #include "ctx_impl.h"
 #include "net_tcp_impl.h"
 #include "net_tcp.h"
+#include "net_resolver.h"
 #include "sys/types.h"
 #include "io.h"
 #include "tlv.h"
 #include "fast_tlv.h"
+#include "http_parser.h"
 
 #ifndef _WIN32
 #  include <unistd.h>
+#  include <errno.h>
+#  include <fcntl.h>
 #  include <sys/socket.h>
 #  include <netinet/in.h>
-#  define __USE_MISC
-#  include <netdb.h>
-#  undef __USE_MISC
-#  include <sys/time.h>
+#  include <poll.h>
+#  ifndef MSG_NOSIGNAL
+#    define MSG_NOSIGNAL 0
+#  endif
 #else
 #  include <winsock2.h>
 #  include <ws2tcpip.h>
 #  define close(soc) closesocket(soc)
 #endif
 
-typedef struct TcpClientCtx_st {
+/** Progress of a non-pipelined request. */
+enum TcpRequestState_en {
+	TCP_REQUEST_IDLE = 0,
+	TCP_REQUEST_CONNECTING,
+	TCP_REQUEST_SENDING,
+	TCP_REQUEST_RECEIVING,
+	TCP_REQUEST_DONE
+};
+
+struct TcpConnection_st {
+	/** Connected non-blocking socket descriptor. */
+	int fd;
+	/** Remote host name. */
 	char *host;
+	/** Remote port. */
 	unsigned port;
-} TcpClientCtx;
+	/** Set while the non-blocking connect is in progress. */
+	int connecting;
+	/** Time the connection was last returned to the pool. */
+	time_t lastUsed;
+	/** Next idle connection in the pool. */
+	TcpConnection *next;
+};
+
+static void TcpConnection_free(TcpConnection *conn) {
+	if (conn != NULL) {
+		if (conn->fd >= 0) close(conn->fd);
+		KSI_free(conn->host);
+		KSI_free(conn);
+	}
+}
+
+/** Size of the chunks HTTP responses are received in. */
+#define TCP_HTTP_CHUNK_SIZE 4096
+/** Longest header name and value kept from the HTTP response, the validators are short. */
+#define TCP_HTTP_HEADER_NAME_SIZE 32
+#define TCP_HTTP_HEADER_VALUE_SIZE 256
+
+typedef struct HttpReceiver_st HttpReceiver;
+
+/**
+ * Streaming parser state of an HTTP response.
+ */
+struct HttpReceiver_st {
+	http_parser parser;
+	/** Handle receiving the body, \c NULL if the body is discarded. */
+	KSI_RequestHandle *handle;
+	/** Body of the response, unless it is passed to the response consumer of #handle. */
+	unsigned char *body;
+	/** Length of #body. */
+	size_t body_len;
+	/** Allocated size of #body. */
+	size_t body_size;
+	/** Set when the whole response has been parsed. */
+	int complete;
+	/** Set if the connection may be reused after the response. */
+	int keepAlive;
+	/** Error of the body callbacks. */
+	int status;
+	/** Header being parsed, a header longer than the buffers is ignored. */
+	char headerName[TCP_HTTP_HEADER_NAME_SIZE];
+	size_t headerName_len;
+	char headerValue[TCP_HTTP_HEADER_VALUE_SIZE];
+	size_t headerValue_len;
+	/** Set while the value of the header is being parsed. */
+	int inHeaderValue;
+};
+
+typedef struct TcpClientCtx_st TcpClientCtx;
+
+struct TcpClientCtx_st {
+	char *host;
+	unsigned port;
+
+	/** The handle this context belongs to, \c NULL if the handle has been freed while the
+	 * HTTP request is still in flight. */
+	KSI_RequestHandle *handle;
+	/** The client the request is sent with. */
+	KSI_TcpClient *client;
+	/** Bytes written to the connection - the request of the handle or #httpRequest. */
+	const unsigned char *out;
+	/** Length of #out. */
+	size_t out_len;
+	/** Serialized HTTP request, \c NULL for a TLV request. */
+	unsigned char *httpRequest;
+	/** Receives the HTTP status code of the response, may be \c NULL. */
+	int *httpStatus;
+	/** HTTP response of a non-pipelined request. */
+	HttpReceiver http;
+
+	/** Progress of a non-pipelined request (see #TcpRequestState_en). */
+	int state;
+	/** Connection used by a non-pipelined request. */
+	TcpConnection *conn;
+	/** Set if #conn was taken from the connection pool. */
+	int isReused;
+	/** Number of request bytes sent. */
+	size_t sent;
+	/** Response header, until the length of the response is known. */
+	unsigned char hdr[4];
+	/** Response buffer of the exact response size. */
+	unsigned char *buffer;
+	/** Length of the response including the header, 0 if not yet known. */
+	size_t buffer_len;
+	/** Number of response bytes received. */
+	size_t received;
+	/** Time in milliseconds the request times out if no progress is made, 0 for no timeout. */
+	KSI_uint64_t deadline;
+
+	/** Pipeline the request has been written to, \c NULL if not in flight. */
+	TcpPipeline *pipeline;
+	/** Request ID used to route the response back to the handle. */
+	KSI_uint64_t requestId;
+	/** Final status of the request. */
+	int status;
+	/** Next request in flight on the same pipeline. */
+	TcpClientCtx *next;
+};
+
+struct TcpPipeline_st {
+	/** Remote host name. */
+	char *host;
+	/** Remote port. */
+	unsigned port;
+	/** Connection shared by all the pipelined requests, \c NULL if not connected. */
+	TcpConnection *conn;
+	/** Requests written to #conn and waiting for a response. */
+	TcpClientCtx *pending;
+	/** Number of requests in #pending. */
+	size_t pendingCount;
+	/** Time in milliseconds of the last request or response on #conn. */
+	KSI_uint64_t lastActivity;
+	/** Header of the response being received. */
+	unsigned char hdr[4];
+	/** Exact size buffer of the response being received, \c NULL until the header is complete. */
+	unsigned char *buffer;
+	/** Size of #buffer. */
+	size_t buffer_len;
+	/** Number of bytes of the current response received so far. */
+	size_t filled;
+	/** Set if the HTTP responses are received instead of TLVs. */
+	int isHttp;
+	/** Cleared if the HTTP server closes the connection after a response. */
+	int isPersistent;
+	/** HTTP response being received. */
+	HttpReceiver http;
+	/** Next pipeline of the same client. */
+	TcpPipeline *next;
+};
+
+static void pipelineRemove(TcpPipeline *pipeline, TcpClientCtx *tc) {
+	TcpClientCtx **pp = &pipeline->pending;
+
+	while (*pp != NULL) {
+		if (*pp == tc) {
+			*pp = tc->next;
+			pipeline->pendingCount--;
+			break;
+		}
+		pp = &(*pp)->next;
+	}
+
+	tc->next = NULL;
+	tc->pipeline = NULL;
+}
 
 static void TcpClientCtx_free(TcpClientCtx *t) {
 	if (t != NULL) {
+		if (t->pipeline != NULL) {
+			/* HTTP responses are matched by their order, so the request keeps its place in the
+			 * pipeline and is freed when its response arrives. */
+			if (t->httpRequest != NULL) {
+				t->handle = NULL;
+				return;
+			}
+			/* A response to this request may still arrive - it will be discarded. */
+			pipelineRemove(t->pipeline, t);
+		}
+		/* The state of an unfinished connection is unknown, so it can not be reused. */
+		TcpConnection_free(t->conn);
+		KSI_free(t->buffer);
+		KSI_free(t->http.body);
+		KSI_free(t->httpRequest);
 		KSI_free(t->host);
 		KSI_free(t);
 	}
 }
 
-static int setStringParam(char **param, const char *val) {
-	char *tmp = NULL;
-	int res = KSI_UNKNOWN_ERROR;
+/* Appends the parsed part of a header name or value, the length is set past the buffer on overflow. */
+static void httpAppendHeader(char *buf, size_t size, size_t *len, const char *at, size_t length) {
+	if (*len > size || length > size - *len) {
+		*len = size + 1;
+		return;
+	}
+	memcpy(buf + *len, at, length);
+	*len += length;
+}
+
+/* Passes the completely parsed header to the handle. */
+static int httpFlushHeader(HttpReceiver *r) {
+	int res = KSI_OK;
+
+	if (r->inHeaderValue && r->handle != NULL && r->headerName_len <= sizeof(r->headerName) && r->headerValue_len <= sizeof(r->headerValue)) {
+		res = KSI_RequestHandle_setResponseHeader(r->handle, r->headerName, r->headerName_len, r->headerValue, r->headerValue_len);
+	}
+
+	r->headerName_len = 0;
+	r->headerValue_len = 0;
+	r->inHeaderValue = 0;
+
+	return res;
+}
+
+static int httpOnHeaderField(http_parser *parser, const char *at, size_t length) {
+	HttpReceiver *r = parser->data;
+
+	if (r->inHeaderValue && (r->status = httpFlushHeader(r)) != KSI_OK) return 1;
+
+	httpAppendHeader(r->headerName, sizeof(r->headerName), &r->headerName_len, at, length);
+
+	return 0;
+}
+
+static int httpOnHeaderValue(http_parser *parser, const char *at, size_t length) {
+	HttpReceiver *r = parser->data;
+
+	r->inHeaderValue = 1;
+	httpAppendHeader(r->headerValue, sizeof(r->headerValue), &r->headerValue_len, at, length);
+
+	return 0;
+}
+
+static int httpOnHeadersComplete(http_parser *parser) {
+	HttpReceiver *r = parser->data;
+
+	/* Returning 1 would only skip the body, any other non-zero value is an error. */
+	if ((r->status = httpFlushHeader(r)) != KSI_OK) return -1;
+
+	/* Allocate the whole body at once, if the length is known. */
+	if (r->handle != NULL && r->handle->responseConsumer == NULL && r->body == NULL &&
+			parser->content_length > 0 && parser->content_length < UINT_MAX) {
+		r->body = KSI_malloc((size_t)parser->content_length);
+		if (r->body != NULL) r->body_size = (size_t)parser->content_length;
+	}
+
+	return 0;
+}
+
+static int httpOnBody(http_parser *parser, const char *at, size_t length) {
+	HttpReceiver *r = parser->data;
+	KSI_RequestHandle *handle = r->handle;
+
+	/* The handle has been freed, the body is discarded. */
+	if (handle == NULL) return 0;
+
+	/* Hand the data over to the consumer instead of buffering it. */
+	if (handle->responseConsumer != NULL) {
+		if (handle->responseConsumer(handle, (const unsigned char *)at, length, handle->responseConsumerData) != KSI_OK) {
+			r->status = KSI_NETWORK_ERROR;
+			return 1;
+		}
+		return 0;
+	}
+
+	if (r->body_len + length < r->body_len) {
+		r->status = KSI_INVALID_FORMAT;
+		return 1;
+	}
+
+	if (r->body_len + length > r->body_size) {
+		size_t newSize = r->body_size * 2;
+		unsigned char *tmp = NULL;
+
+		if (newSize < r->body_len + length) newSize = r->body_len + length;
+
+		tmp = KSI_realloc(r->body, newSize);
+		if (tmp == NULL) {
+			r->status = KSI_OUT_OF_MEMORY;
+			return 1;
+		}
+
+		r->body = tmp;
+		r->body_size = newSize;
+	}
+
+	memcpy(r->body + r->body_len, at, length);
+	r->body_len += length;
+
+	return 0;
+}
+
+static int httpOnMessageComplete(http_parser *parser) {
+	HttpReceiver *r = parser->data;
+
+	r->complete = 1;
+	r->keepAlive = http_should_keep_alive(parser);
+
+	/* Stop at the end of the response, the following bytes belong to the next one. */
+	http_parser_pause(parser, 1);
+
+	return 0;
+}
+
+static const struct http_parser_settings httpSettings = {
+	NULL,	/* on_message_begin */
+	NULL,	/* on_url */
+	NULL,	/* on_status */
+	httpOnHeaderField,
+	httpOnHeaderValue,
+	httpOnHeadersComplete,
+	httpOnBody,
+	httpOnMessageComplete
+};
+
+/**
+ * Prepares the receiver for the next response, the body of the previous response is discarded.
+ */
+static void httpReceiverReset(HttpReceiver *r, KSI_RequestHandle *handle) {
+	http_parser_init(&r->parser, HTTP_RESPONSE);
+	r->parser.data = r;
+	r->handle = handle;
+	KSI_free(r->body);
+	r->body = NULL;
+	r->body_len = 0;
+	r->body_size = 0;
+	r->complete = 0;
+	r->keepAlive = 0;
+	r->status = KSI_OK;
+	r->headerName_len = 0;
+	r->headerValue_len = 0;
+	r->inHeaderValue = 0;
+}
+
+/**
+ * Feeds the received bytes to the HTTP parser. The parser stops after a complete response and
+ * \c used receives the number of bytes consumed. Zero length input marks the end of the stream.
+ */
+static int httpReceive(HttpReceiver *r, const unsigned char *data, size_t len, size_t *used) {
+	size_t c;
+
+	c = http_parser_execute(&r->parser, &httpSettings, (const char *)data, len);
+
+	if (HTTP_PARSER_ERRNO(&r->parser) == HPE_PAUSED) {
+		http_parser_pause(&r->parser, 0);
+	} else if (HTTP_PARSER_ERRNO(&r->parser) != HPE_OK) {
+		return r->status != KSI_OK ? r->status : KSI_INVALID_FORMAT;
+	}
+
+	*used = c;
+
+	return KSI_OK;
+}
+
+/**
+ * Passes the completely received HTTP response to the request.
+ */
+static void httpDeliver(HttpReceiver *r, TcpClientCtx *tc) {
+	if (tc->httpStatus != NULL) *tc->httpStatus = r->parser.status_code;
+
+	if (tc->handle != NULL) {
+		if (r->parser.status_code == 304) tc->handle->notModified = 1;
+		KSI_RequestHandle_setResponseBuffer(tc->handle, r->body, r->body_len);
+		r->body = NULL;
+	}
+
+	tc->status = KSI_OK;
+
+	httpReceiverReset(r, NULL);
+}
+
+static int setStringParam(char **param, const char *val) {
+	char *tmp = NULL;
+	int res = KSI_UNKNOWN_ERROR;
+
+
+	tmp = KSI_calloc(strlen(val) + 1, 1);
+	if (tmp == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	memcpy(tmp, val, strlen(val) + 1);
+
+	if (*param != NULL) {
+		KSI_free(*param);
+	}
+
+	*param = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(tmp);
+
+	return res;
+}
+
+static int setIntParam(int *param, int val) {
+	*param = val;
+	return KSI_OK;
+}
+
+/**
+ * Returns the deadline for the next step of a request, 0 if there is no timeout.
+ */
+static KSI_uint64_t makeDeadline(int timeoutSeconds) {
+	return timeoutSeconds > 0 ? KSI_getTimeMs() + (KSI_uint64_t)timeoutSeconds * 1000 : 0;
+}
+
+/**
+ * Returns the deadline for the next step of a request, limited by the deadline of the whole request.
+ */
+static KSI_uint64_t stepDeadline(KSI_RequestHandle *handle, int timeoutSeconds) {
+	KSI_uint64_t deadline = makeDeadline(timeoutSeconds);
+
+	if (handle->deadline != 0 && (deadline == 0 || handle->deadline < deadline)) deadline = handle->deadline;
+
+	return deadline;
+}
+
+/**
+ * Returns the number of milliseconds until the deadline, -1 if there is no deadline.
+ */
+static int remainingMs(KSI_uint64_t deadline) {
+	KSI_uint64_t now;
+
+	if (deadline == 0) return -1;
+
+	now = KSI_getTimeMs();
+	if (now >= deadline) return 0;
+
+	return deadline - now > INT_MAX ? INT_MAX : (int)(deadline - now);
+}
+
+/**
+ * Returns non-zero if the last socket operation failed only because it would have blocked.
+ */
+static int wouldBlock(void) {
+#ifdef _WIN32
+	int err = WSAGetLastError();
+	return err == WSAEWOULDBLOCK || err == WSAEINPROGRESS;
+#else
+	return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINPROGRESS || errno == EINTR;
+#endif
+}
+
+static int setNonBlocking(int fd) {
+#ifdef _WIN32
+	u_long mode = 1;
+
+	return ioctlsocket((SOCKET)fd, FIONBIO, &mode) == 0 ? KSI_OK : KSI_NETWORK_ERROR;
+#else
+	int flags = fcntl(fd, F_GETFL, 0);
+
+	if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) return KSI_NETWORK_ERROR;
+
+	return KSI_OK;
+#endif
+}
+
+/**
+ * Waits until any of the given events occurs on the socket. Errors and hang-ups are reported as
+ * the requested events, as the following socket operation will reveal them.
+ * \return the events that occurred, 0 on timeout and -1 on error.
+ */
+static int waitSocket(int fd, int events, int timeoutMs) {
+	int c;
+	int ready = 0;
+#ifdef _WIN32
+	fd_set readSet;
+	fd_set writeSet;
+	fd_set errSet;
+	struct timeval tv;
+
+	FD_ZERO(&readSet);
+	FD_ZERO(&writeSet);
+	FD_ZERO(&errSet);
+
+	if (events & KSI_NET_EVENT_READ) FD_SET((SOCKET)fd, &readSet);
+	if (events & KSI_NET_EVENT_WRITE) FD_SET((SOCKET)fd, &writeSet);
+	/* A failed connect is reported via the exception set. */
+	FD_SET((SOCKET)fd, &errSet);
+
+	tv.tv_sec = timeoutMs / 1000;
+	tv.tv_usec = (timeoutMs % 1000) * 1000;
+
+	c = select(0, &readSet, &writeSet, &errSet, timeoutMs < 0 ? NULL : &tv);
+	if (c < 0) return -1;
+
+	if (FD_ISSET((SOCKET)fd, &readSet)) ready |= KSI_NET_EVENT_READ;
+	if (FD_ISSET((SOCKET)fd, &writeSet)) ready |= KSI_NET_EVENT_WRITE;
+	if (FD_ISSET((SOCKET)fd, &errSet)) ready |= events;
+#else
+	struct pollfd pfd;
+
+	pfd.fd = fd;
+	pfd.events = 0;
+	pfd.revents = 0;
+
+	if (events & KSI_NET_EVENT_READ) pfd.events |= POLLIN;
+	if (events & KSI_NET_EVENT_WRITE) pfd.events |= POLLOUT;
+
+	do {
+		c = poll(&pfd, 1, timeoutMs);
+	} while (c < 0 && errno == EINTR);
+	if (c < 0) return -1;
+
+	if (pfd.revents & POLLIN) ready |= KSI_NET_EVENT_READ;
+	if (pfd.revents & POLLOUT) ready |= KSI_NET_EVENT_WRITE;
+	if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) ready |= events;
+#endif
+
+	return ready;
+}
+
+/**
+ * Sends as much of the buffer as possible without blocking.
+ * \return #KSI_OK if some bytes were sent, #KSI_ASYNC_NOT_FINISHED if the socket is not writable.
+ */
+static int sendSome(int fd, const unsigned char *buf, size_t len, size_t *count) {
+	int c;
+
+	if (len > INT_MAX) len = INT_MAX;
+
+#ifdef _WIN32
+	c = send(fd, (const char *) buf, (int) len, 0);
+#else
+	c = (int) send(fd, buf, len, MSG_NOSIGNAL);
+#endif
+	if (c < 0) {
+		*count = 0;
+		return wouldBlock() ? KSI_ASYNC_NOT_FINISHED : KSI_NETWORK_ERROR;
+	}
+
+	*count = (size_t) c;
+
+	return KSI_OK;
+}
+
+/**
+ * Receives the available bytes without blocking.
+ * \return #KSI_OK if some bytes were received, #KSI_ASYNC_NOT_FINISHED if there is nothing to read.
+ */
+static int recvSome(int fd, unsigned char *buf, size_t len, size_t *count) {
+	int c;
+
+	if (len > INT_MAX) len = INT_MAX;
+
+#ifdef _WIN32
+	c = recv(fd, (char *) buf, (int) len, 0);
+#else
+	c = (int) recv(fd, buf, len, 0);
+#endif
+	*count = 0;
+
+	if (c < 0) return wouldBlock() ? KSI_ASYNC_NOT_FINISHED : KSI_NETWORK_ERROR;
+
+	/* The peer has closed the connection. */
+	if (c == 0) return KSI_NETWORK_ERROR;
+
+	*count = (size_t) c;
+
+	return KSI_OK;
+}
+
+/**
+ * Calculates the length of a TLV from its header.
+ * \return the length of the TLV including the header, 0 if the header is not complete.
+ */
+static size_t getTlvLength(const unsigned char *buf, size_t len) {
+	if (len < 2) return 0;
+
+	if (buf[0] & KSI_TLV_MASK_TLV16) {
+		if (len < 4) return 0;
+		return 4 + (((size_t) buf[2] << 8) | buf[3]);
+	}
+
+	return 2 + (size_t) buf[1];
+}
+
+/**
+ * Starts a non-blocking connect to the address.
+ * \return the socket descriptor, -1 if the connection could not be started.
+ */
+static int startConnect(const KSI_ResolvedAddr *addr, int *connecting) {
+	int fd;
+
+	fd = (int)socket(addr->family, SOCK_STREAM, 0);
+	if (fd < 0) return -1;
+
+	/*Set socket options*/
+	if (setNonBlocking(fd) != KSI_OK) {
+		close(fd);
+		return -1;
+	}
+#ifdef SO_NOSIGPIPE
+	{
+		/* Writing to a connection closed by the peer must not raise SIGPIPE. */
+		int noSigPipe = 1;
+		setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, (void*)&noSigPipe, sizeof(noSigPipe));
+	}
+#endif
+
+	*connecting = 0;
+	if (connect(fd, (const struct sockaddr *)&addr->addr, addr->addr_len) < 0) {
+		if (!wouldBlock()) {
+			close(fd);
+			return -1;
+		}
+		/* The connection is completed asynchronously. */
+		*connecting = 1;
+	}
+
+	return fd;
+}
+
+static int openConnection(KSI_CTX *ctx, const char *host, unsigned port, TcpConnection **conn) {
+	int res;
+	TcpConnection *tmp = NULL;
+	KSI_ResolvedAddr addrs[KSI_RESOLVER_MAX_ADDRS];
+	size_t addrs_len = 0;
+	size_t i;
+
+	tmp = KSI_new(TcpConnection);
+	if (tmp == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	tmp->fd = -1;
+	tmp->host = NULL;
+	tmp->port = port;
+	tmp->connecting = 0;
+	tmp->lastUsed = 0;
+	tmp->next = NULL;
+
+	res = KSI_strdup(host, &tmp->host);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_Resolver_lookup(host, port, addrs, KSI_RESOLVER_MAX_ADDRS, &addrs_len);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res = KSI_NETWORK_ERROR, "Unable to open host.");
+		goto cleanup;
+	}
+
+	/* The addresses are rotated by the resolver, try them in the given order. */
+	for (i = 0; i < addrs_len && tmp->fd < 0; i++) {
+		tmp->fd = startConnect(&addrs[i], &tmp->connecting);
+	}
+
+	if (tmp->fd < 0) {
+		KSI_pushError(ctx, res = KSI_NETWORK_ERROR, "Unable to connect.");
+		goto cleanup;
+	}
+
+	*conn = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	TcpConnection_free(tmp);
+
+	return res;
+}
+
+/**
+ * Checks the result of a non-blocking connect, after the socket has become writable.
+ */
+static int finishConnect(TcpConnection *conn) {
+	int err = 0;
+#ifdef _WIN32
+	int len = sizeof(err);
+#else
+	socklen_t len = sizeof(err);
+#endif
+
+	if (getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, (void *)&err, &len) < 0 || err != 0) {
+		return KSI_NETWORK_ERROR;
+	}
+
+	conn->connecting = 0;
+
+	return KSI_OK;
+}
+
+/**
+ * Blocks until the non-blocking connect has completed.
+ */
+static int waitConnected(KSI_CTX *ctx, TcpConnection *conn, int timeoutMs) {
+	int res;
+	int c;
+
+	if (!conn->connecting) {
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	c = waitSocket(conn->fd, KSI_NET_EVENT_WRITE, timeoutMs);
+	if (c == 0) {
+		KSI_pushError(ctx, res = KSI_NETWORK_CONNECTION_TIMEOUT, "Connection timed out.");
+		goto cleanup;
+	}
+
+	if (c < 0 || finishConnect(conn) != KSI_OK) {
+		KSI_pushError(ctx, res = KSI_NETWORK_ERROR, "Unable to connect.");
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/**
+ * Checks if an idle connection can be reused. An idle connection must not have
+ * anything to read - a readable socket means the peer has either closed the
+ * connection or sent unsolicited data.
+ */
+static int isConnectionAlive(TcpConnection *conn) {
+	return !conn->connecting && waitSocket(conn->fd, KSI_NET_EVENT_READ, 0) == 0;
+}
+
+/**
+ * Closes the idle connections that have exceeded the idle timeout.
+ */
+static void evictIdleConnections(KSI_TcpClient *client, time_t now) {
+	TcpConnection **pp = &client->pool;
+
+	while (*pp != NULL) {
+		TcpConnection *conn = *pp;
+		if (now - conn->lastUsed > client->poolIdleTimeoutSeconds || now < conn->lastUsed) {
+			*pp = conn->next;
+			client->poolSize--;
+			TcpConnection_free(conn);
+		} else {
+			pp = &conn->next;
+		}
+	}
+}
+
+/**
+ * Takes a healthy idle connection to the given endpoint from the pool, or opens
+ * a new one if there is none.
+ */
+static int acquireConnection(KSI_TcpClient *client, KSI_CTX *ctx, const char *host, unsigned port, TcpConnection **conn, int *isReused) {
+	int res;
+	TcpConnection **pp = NULL;
+
+	evictIdleConnections(client, time(NULL));
+
+	pp = &client->pool;
+	while (*pp != NULL) {
+		TcpConnection *tmp = *pp;
+
+		if (tmp->port == port && !strcmp(tmp->host, host)) {
+			*pp = tmp->next;
+			client->poolSize--;
+			tmp->next = NULL;
+
+			if (isConnectionAlive(tmp)) {
+				KSI_LOG_debug(ctx, "Tcp: Reusing connection to %s:%u", host, port);
+				*conn = tmp;
+				*isReused = 1;
+				res = KSI_OK;
+				goto cleanup;
+			}
+
+			KSI_LOG_debug(ctx, "Tcp: Dropping stale connection to %s:%u", host, port);
+			TcpConnection_free(tmp);
+			continue;
+		}
+
+		pp = &tmp->next;
+	}
+
+	res = openConnection(ctx, host, port, conn);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+	*isReused = 0;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/**
+ * Returns the connection to the pool, or closes it if the pool is full.
+ */
+static void releaseConnection(KSI_TcpClient *client, TcpConnection *conn) {
+	if (conn == NULL) return;
+
+	if (client->poolSize >= client->maxPoolSize) {
+		TcpConnection_free(conn);
+		return;
+	}
+
+	conn->lastUsed = time(NULL);
+	conn->next = client->pool;
+	client->pool = conn;
+	client->poolSize++;
+}
+
+static void freeConnectionPool(KSI_TcpClient *client) {
+	while (client->pool != NULL) {
+		TcpConnection *conn = client->pool;
+		client->pool = conn->next;
+		TcpConnection_free(conn);
+	}
+	client->poolSize = 0;
+}
+
+/**
+ * Sends the whole request, waiting for the socket to become writable when necessary.
+ */
+static int sendAll(TcpClientCtx *tc, int sockfd, int timeoutSeconds) {
+	int res;
+	KSI_RequestHandle *handle = tc->handle;
+	size_t count = 0;
+
+	while (count < tc->out_len) {
+		size_t c = 0;
+
+		res = sendSome(sockfd, tc->out + count, tc->out_len - count, &c);
+		if (res == KSI_ASYNC_NOT_FINISHED) {
+			int ready = waitSocket(sockfd, KSI_NET_EVENT_WRITE, KSI_RequestHandle_remainingMs(handle, timeoutSeconds > 0 ? timeoutSeconds * 1000 : -1));
+			if (ready == 0) {
+				KSI_pushError(handle->ctx, res = KSI_NETWORK_SEND_TIMEOUT, "Sending the request timed out.");
+				goto cleanup;
+			}
+			if (ready < 0) {
+				KSI_pushError(handle->ctx, res = KSI_NETWORK_ERROR, "Unable to write to socket.");
+				goto cleanup;
+			}
+			continue;
+		}
+
+		if (res != KSI_OK) {
+			KSI_pushError(handle->ctx, res, "Unable to write to socket.");
+			goto cleanup;
+		}
+		count += c;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/**
+ * Ends a non-pipelined request. On success, the connection is returned to the pool.
+ */
+static int requestFinish(KSI_TcpClient *client, TcpClientCtx *tc, int status) {
+	if (status == KSI_OK) {
+		releaseConnection(client, tc->conn);
+	} else {
+		TcpConnection_free(tc->conn);
+	}
+
+	tc->conn = NULL;
+	tc->state = TCP_REQUEST_DONE;
+	tc->status = status;
+
+	return status;
+}
+
+/**
+ * Handles a failure of a non-pipelined request. A reused connection may have been closed
+ * by the server in the meanwhile - the request is restarted on another connection, unless
+ * part of the response was already consumed.
+ */
+static int requestFailed(KSI_RequestHandle *handle, TcpClientCtx *tc, int status) {
+	if (tc->isReused && tc->received == 0) {
+		KSI_LOG_debug(handle->ctx, "Tcp: Reused connection failed, reconnecting.");
+		TcpConnection_free(tc->conn);
+		tc->conn = NULL;
+		tc->state = TCP_REQUEST_IDLE;
+		return KSI_OK;
+	}
+
+	return requestFinish(tc->client, tc, status);
+}
+
+/**
+ * Receives the available bytes of the HTTP response of a non-pipelined request without blocking.
+ * \return #KSI_OK if some bytes were received, #KSI_ASYNC_NOT_FINISHED if there is nothing to read.
+ */
+static int requestReceiveHttp(TcpClientCtx *tc) {
+	int res;
+	unsigned char chunk[TCP_HTTP_CHUNK_SIZE];
+	size_t count = 0;
+	size_t used = 0;
+	int eof = 0;
+
+	res = recvSome(tc->conn->fd, chunk, sizeof(chunk), &count);
+	if (res == KSI_ASYNC_NOT_FINISHED) return res;
+
+	/* A closed connection completes a response without a length. */
+	if (res != KSI_OK) {
+		if (tc->received == 0) return res;
+		eof = 1;
+	}
+
+	tc->received += count;
+
+	res = httpReceive(&tc->http, chunk, count, &used);
+	if (res != KSI_OK) return res;
+
+	if (eof && !tc->http.complete) return KSI_NETWORK_ERROR;
+
+	/* Unexpected bytes after the response leave the connection in an unknown state. */
+	if (eof || used < count) tc->http.keepAlive = 0;
+
+	return KSI_OK;
+}
+
+/**
+ * Advances a non-pipelined request as far as possible without blocking.
+ */
+static int performRequest(KSI_RequestHandle *handle, int events) {
+	int res;
+	TcpClientCtx *tc = NULL;
+	KSI_TcpClient *client = NULL;
+	int timeoutStatus = KSI_NETWORK_ERROR;
+
+	/* All the socket operations are non-blocking, so the events are not needed to decide what to do. */
+	(void)events;
+
+	if (handle == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	tc = handle->implCtx;
+	client = tc->client;
+
+	for (;;) {
+		size_t count = 0;
+		int c;
+
+		switch (tc->state) {
+			case TCP_REQUEST_IDLE:
+				/* Resolving the host name may block, so do not start if there is no time left. */
+				if (KSI_RequestHandle_isExpired(handle)) {
+					KSI_pushError(handle->ctx, res = requestFinish(client, tc, KSI_NETWORK_CONNECTION_TIMEOUT), "Request deadline has passed.");
+					goto cleanup;
+				}
+
+				res = acquireConnection(client, handle->ctx, tc->host, tc->port, &tc->conn, &tc->isReused);
+				if (res != KSI_OK) {
+					requestFinish(client, tc, res);
+					KSI_pushError(handle->ctx, res, NULL);
+					goto cleanup;
+				}
+
+				KSI_free(tc->buffer);
+				tc->buffer = NULL;
+				tc->buffer_len = 0;
+				tc->sent = 0;
+				tc->received = 0;
+				if (tc->httpRequest != NULL) httpReceiverReset(&tc->http, handle);
+				tc->deadline = stepDeadline(handle, client->transferTimeoutSeconds);
+				tc->state = tc->conn->connecting ? TCP_REQUEST_CONNECTING : TCP_REQUEST_SENDING;
+
+				KSI_LOG_logBlob(handle->ctx, KSI_LOG_DEBUG, "Sending request", tc->out, tc->out_len);
+				break;
+
+			case TCP_REQUEST_CONNECTING:
+				c = waitSocket(tc->conn->fd, KSI_NET_EVENT_WRITE, 0);
+				if (c < 0 || (c > 0 && finishConnect(tc->conn) != KSI_OK)) {
+					KSI_pushError(handle->ctx, res = requestFinish(client, tc, KSI_NETWORK_ERROR), "Unable to connect.");
+					goto cleanup;
+				}
+
+				if (c == 0) {
+					timeoutStatus = KSI_NETWORK_CONNECTION_TIMEOUT;
+					res = KSI_ASYNC_NOT_FINISHED;
+					goto timeout;
+				}
+
+				tc->deadline = stepDeadline(handle, client->transferTimeoutSeconds);
+				tc->state = TCP_REQUEST_SENDING;
+				break;
+
+			case TCP_REQUEST_SENDING:
+				res = sendSome(tc->conn->fd, tc->out + tc->sent, tc->out_len - tc->sent, &count);
+				if (res == KSI_ASYNC_NOT_FINISHED) {
+					timeoutStatus = KSI_NETWORK_SEND_TIMEOUT;
+					goto timeout;
+				}
+
+				if (res != KSI_OK) {
+					res = requestFailed(handle, tc, res);
+					if (res == KSI_OK) break;
+					KSI_pushError(handle->ctx, res, "Unable to write to socket.");
+					goto cleanup;
+				}
+
+				tc->sent += count;
+				tc->deadline = stepDeadline(handle, client->transferTimeoutSeconds);
+				if (tc->sent == tc->out_len) tc->state = TCP_REQUEST_RECEIVING;
+				break;
+
+			case TCP_REQUEST_RECEIVING:
+				if (tc->httpRequest != NULL) {
+					res = requestReceiveHttp(tc);
+					if (res == KSI_ASYNC_NOT_FINISHED) {
+						timeoutStatus = KSI_NETWORK_RECIEVE_TIMEOUT;
+						goto timeout;
+					}
+
+					if (res != KSI_OK) {
+						res = requestFailed(handle, tc, res);
+						if (res == KSI_OK) break;
+						KSI_pushError(handle->ctx, res, "Unable to read HTTP response from socket.");
+						goto cleanup;
+					}
+
+					tc->deadline = stepDeadline(handle, client->transferTimeoutSeconds);
+
+					if (tc->http.complete) {
+						/* The connection is reused only if the server keeps it open. */
+						if (!tc->http.keepAlive) {
+							TcpConnection_free(tc->conn);
+							tc->conn = NULL;
+						}
+
+						httpDeliver(&tc->http, tc);
+
+						res = requestFinish(client, tc, KSI_OK);
+						goto cleanup;
+					}
+					break;
+				}
+
+				if (tc->buffer == NULL) {
+					/* Read the 2 byte header, and the following 2 bytes for a 16 bit TLV. */
+					res = recvSome(tc->conn->fd, tc->hdr + tc->received, (tc->received < 2 ? 2 : 4) - tc->received, &count);
+				} else {
+					res = recvSome(tc->conn->fd, tc->buffer + tc->received, tc->buffer_len - tc->received, &count);
+				}
+
+				if (res == KSI_ASYNC_NOT_FINISHED) {
+					timeoutStatus = KSI_NETWORK_RECIEVE_TIMEOUT;
+					goto timeout;
+				}
+
+				if (res != KSI_OK) {
+					res = requestFailed(handle, tc, res);
+					if (res == KSI_OK) break;
+					KSI_pushError(handle->ctx, res, "Unable to read TLV from socket.");
+					goto cleanup;
+				}
+
+				tc->received += count;
+				tc->deadline = stepDeadline(handle, client->transferTimeoutSeconds);
+
+				if (tc->buffer == NULL) {
+					tc->buffer_len = getTlvLength(tc->hdr, tc->received);
+					if (tc->buffer_len == 0) break;
+
+					tc->buffer = KSI_malloc(tc->buffer_len);
+					if (tc->buffer == NULL) {
+						KSI_pushError(handle->ctx, res = requestFinish(client, tc, KSI_OUT_OF_MEMORY), NULL);
+						goto cleanup;
+					}
+					memcpy(tc->buffer, tc->hdr, tc->received);
+				}
+
+				if (tc->received == tc->buffer_len) {
+					/* The whole response has been consumed, the connection can be reused. */
+					KSI_RequestHandle_setResponseBuffer(handle, tc->buffer, tc->buffer_len);
+					tc->buffer = NULL;
+
+					res = requestFinish(client, tc, KSI_OK);
+					goto cleanup;
+				}
+				break;
+
+			default:
+				res = tc->status;
+				/* The body of an HTTP response may have been passed to the response consumer. */
+				if (res == KSI_OK && handle->response == NULL && tc->httpRequest == NULL) res = KSI_UNKNOWN_ERROR;
+				if (res != KSI_OK) {
+					KSI_pushError(handle->ctx, res, NULL);
+				}
+				goto cleanup;
+		}
+	}
+
+timeout:
+
+	if ((tc->deadline != 0 && KSI_getTimeMs() >= tc->deadline) || KSI_RequestHandle_isExpired(handle)) {
+		KSI_pushError(handle->ctx, res = requestFinish(client, tc, timeoutStatus), "Request timed out.");
+	}
+
+cleanup:
+
+	return res;
+}
+
+static int getRequestPollInfo(KSI_RequestHandle *handle, int *fd, int *events, int *timeoutMs) {
+	TcpClientCtx *tc = handle->implCtx;
+
+	switch (tc->state) {
+		case TCP_REQUEST_CONNECTING:
+		case TCP_REQUEST_SENDING:
+			*fd = tc->conn->fd;
+			*events = KSI_NET_EVENT_WRITE;
+			*timeoutMs = KSI_RequestHandle_remainingMs(handle, remainingMs(tc->deadline));
+			break;
+		case TCP_REQUEST_RECEIVING:
+			*fd = tc->conn->fd;
+			*events = KSI_NET_EVENT_READ;
+			*timeoutMs = KSI_RequestHandle_remainingMs(handle, remainingMs(tc->deadline));
+			break;
+		default:
+			*fd = -1;
+			*events = 0;
+			*timeoutMs = 0;
+			break;
+	}
+
+	return KSI_OK;
+}
+
+/**
+ * Blocking read of the response - drives the non-blocking request until it has completed.
+ */
+static int readResponse(KSI_RequestHandle *handle) {
+	int res;
+	int ready = 0;
+
+	if (handle == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	KSI_ERR_clearErrors(handle->ctx);
+
+	for (;;) {
+		int fd = -1;
+		int events = 0;
+		int timeoutMs = 0;
+
+		res = handle->perform(handle, ready);
+		if (res != KSI_ASYNC_NOT_FINISHED) break;
+
+		res = handle->getPollInfo(handle, &fd, &events, &timeoutMs);
+		if (res != KSI_OK) {
+			KSI_pushError(handle->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		ready = 0;
+		if (fd >= 0) {
+			ready = waitSocket(fd, events, timeoutMs);
+			if (ready < 0) {
+				KSI_pushError(handle->ctx, res = KSI_NETWORK_ERROR, "Unable to wait for the socket.");
+				goto cleanup;
+			}
+		}
+	}
+
+	if (res != KSI_OK) {
+		KSI_pushError(handle->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+
+/**
+ * Extracts the request ID from a serialized aggregation or extension PDU (either
+ * request or response) without parsing the whole PDU. Returns #KSI_INVALID_FORMAT
+ * if the PDU does not carry a request ID (e.g. an error PDU).
+ */
+static int getPduRequestId(const unsigned char *raw, size_t raw_len, KSI_uint64_t *requestId) {
+	int res;
+	KSI_FTLV pdu;
+	KSI_FTLV ftlv;
+	const unsigned char *ptr = NULL;
+	size_t len;
+
+	res = KSI_FTLV_memRead(raw, raw_len, &pdu);
+	if (res != KSI_OK) goto cleanup;
+
+	if (pdu.tag != 0x200 && pdu.tag != 0x300) {
+		res = KSI_INVALID_FORMAT;
+		goto cleanup;
+	}
+
+	/* Find the request or response TLV. */
+	ptr = raw + pdu.hdr_len;
+	len = pdu.dat_len;
+	for (;;) {
+		if (len == 0) {
+			res = KSI_INVALID_FORMAT;
+			goto cleanup;
+		}
+
+		res = KSI_FTLV_memRead(ptr, len, &ftlv);
+		if (res != KSI_OK) goto cleanup;
+
+		if (ftlv.tag == pdu.tag + 1 || ftlv.tag == pdu.tag + 2) break;
+
+		ptr += ftlv.hdr_len + ftlv.dat_len;
+		len -= ftlv.hdr_len + ftlv.dat_len;
+	}
+
+	/* Find the request ID. */
+	len = ftlv.dat_len;
+	ptr += ftlv.hdr_len;
+	for (;;) {
+		if (len == 0) {
+			res = KSI_INVALID_FORMAT;
+			goto cleanup;
+		}
+
+		res = KSI_FTLV_memRead(ptr, len, &ftlv);
+		if (res != KSI_OK) goto cleanup;
+
+		if (ftlv.tag == 0x01) break;
+
+		ptr += ftlv.hdr_len + ftlv.dat_len;
+		len -= ftlv.hdr_len + ftlv.dat_len;
+	}
+
+	if (ftlv.dat_len > 8) {
+		res = KSI_INVALID_FORMAT;
+		goto cleanup;
+	}
+
+	*requestId = 0;
+	for (len = 0; len < ftlv.dat_len; len++) {
+		*requestId = (*requestId << 8) | ptr[ftlv.hdr_len + len];
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/**
+ * Closes the pipelined connection. All the requests still in flight are failed with
+ * the given status code.
+ */
+static void pipelineAbort(TcpPipeline *pipeline, int status) {
+	TcpConnection_free(pipeline->conn);
+	pipeline->conn = NULL;
+	KSI_free(pipeline->buffer);
+	pipeline->buffer = NULL;
+	pipeline->buffer_len = 0;
+	pipeline->filled = 0;
+	httpReceiverReset(&pipeline->http, NULL);
+
+	while (pipeline->pending != NULL) {
+		TcpClientCtx *tc = pipeline->pending;
+		pipeline->pending = tc->next;
+		pipeline->pendingCount--;
+		tc->next = NULL;
+		tc->pipeline = NULL;
+		tc->status = status;
+
+		/* The request of a freed handle was only kept for the order of the responses. */
+		if (tc->handle == NULL) {
+			TcpClientCtx_free(tc);
+			continue;
+		}
+
+		/* The handle may already have a response, if an error PDU was delivered to it. */
+		KSI_RequestHandle_complete(tc->handle, tc->handle->response != NULL ? KSI_OK : status);
+	}
+}
+
+static void TcpPipeline_free(TcpPipeline *pipeline) {
+	if (pipeline != NULL) {
+		pipelineAbort(pipeline, KSI_NETWORK_ERROR);
+		KSI_free(pipeline->host);
+		KSI_free(pipeline);
+	}
+}
+
+static void freePipelines(KSI_TcpClient *client) {
+	while (client->pipelines != NULL) {
+		TcpPipeline *pipeline = client->pipelines;
+		client->pipelines = pipeline->next;
+		TcpPipeline_free(pipeline);
+	}
+}
+
+static int getPipeline(KSI_TcpClient *client, KSI_CTX *ctx, const char *host, unsigned port, int isHttp, TcpPipeline **pipeline) {
+	int res;
+	TcpPipeline *tmp = NULL;
+
+	for (tmp = client->pipelines; tmp != NULL; tmp = tmp->next) {
+		if (tmp->port == port && tmp->isHttp == isHttp && !strcmp(tmp->host, host)) {
+			*pipeline = tmp;
+			tmp = NULL;
+			res = KSI_OK;
+			goto cleanup;
+		}
+	}
+
+	tmp = KSI_new(TcpPipeline);
+	if (tmp == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	tmp->host = NULL;
+	tmp->port = port;
+	tmp->conn = NULL;
+	tmp->pending = NULL;
+	tmp->pendingCount = 0;
+	tmp->lastActivity = 0;
+	tmp->buffer = NULL;
+	tmp->buffer_len = 0;
+	tmp->filled = 0;
+	tmp->isHttp = isHttp;
+	tmp->isPersistent = 1;
+	tmp->http.body = NULL;
+	httpReceiverReset(&tmp->http, NULL);
+	tmp->next = NULL;
+
+	res = KSI_strdup(host, &tmp->host);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	tmp->next = client->pipelines;
+	client->pipelines = tmp;
+
+	*pipeline = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	TcpPipeline_free(tmp);
+
+	return res;
+}
+
+/**
+ * Routes the completely received response to the handle with the matching request ID. The
+ * response buffer is passed to the handle without copying.
+ */
+static int pipelineRoute(TcpPipeline *pipeline, KSI_CTX *ctx) {
+	int res;
+	KSI_uint64_t requestId = 0;
+	TcpClientCtx *tc = NULL;
+	unsigned char *buffer = pipeline->buffer;
+	size_t count = pipeline->buffer_len;
 
+	/* Take the buffer, as the pipeline may be aborted below. */
+	pipeline->buffer = NULL;
+	pipeline->buffer_len = 0;
+	pipeline->filled = 0;
 
-	tmp = KSI_calloc(strlen(val) + 1, 1);
-	if (tmp == NULL) {
-		res = KSI_INVALID_ARGUMENT;
+	KSI_LOG_logBlob(ctx, KSI_LOG_DEBUG, "Pipelined response", buffer, count);
+
+	if (getPduRequestId(buffer, count, &requestId) != KSI_OK) {
+		/* A response without a request ID is an error PDU concerning the whole session, pass
+		 * it to all the requests in flight and drop the connection. */
+		KSI_LOG_debug(ctx, "Tcp: Response without a request ID, failing %lu pipelined request(s).", (unsigned long)pipeline->pendingCount);
+
+		for (tc = pipeline->pending; tc != NULL; tc = tc->next) {
+			res = KSI_RequestHandle_setResponse(tc->handle, buffer, count);
+			if (res != KSI_OK) tc->status = res;
+		}
+
+		pipelineAbort(pipeline, KSI_NETWORK_ERROR);
+
+		res = KSI_OK;
 		goto cleanup;
 	}
-	memcpy(tmp, val, strlen(val) + 1);
 
-	if (*param != NULL) {
-		KSI_free(*param);
+	for (tc = pipeline->pending; tc != NULL; tc = tc->next) {
+		if (tc->requestId == requestId) break;
 	}
 
-	*param = tmp;
-	tmp = NULL;
+	if (tc == NULL) {
+		/* The handle has already been freed. */
+		KSI_LOG_debug(ctx, "Tcp: Discarding response to an unknown request ID %llu.", (unsigned long long)requestId);
+		res = KSI_OK;
+		goto cleanup;
+	}
+
+	pipelineRemove(pipeline, tc);
+
+	KSI_RequestHandle_setResponseBuffer(tc->handle, buffer, count);
+	buffer = NULL;
+	tc->status = KSI_OK;
+
+	KSI_RequestHandle_complete(tc->handle, KSI_OK);
 
 	res = KSI_OK;
 
 cleanup:
 
-	KSI_free(tmp);
+	KSI_free(buffer);
 
 	return res;
 }
 
-static int setIntParam(int *param, int val) {
-	*param = val;
-	return KSI_OK;
+/**
+ * Moves the HTTP requests still in flight to connections of their own, after the pipelined
+ * connection has been closed. A server announcing the closing has not processed the requests,
+ * otherwise they are sent again like after a failure of a reused connection.
+ */
+static void pipelineFallback(TcpPipeline *pipeline, KSI_CTX *ctx) {
+	TcpClientCtx *list = pipeline->pending;
+
+	KSI_LOG_debug(ctx, "Tcp: Pipelined connection closed, sending %lu request(s) separately.", (unsigned long)pipeline->pendingCount);
+
+	pipeline->pending = NULL;
+	pipeline->pendingCount = 0;
+	pipelineAbort(pipeline, KSI_NETWORK_ERROR);
+
+	while (list != NULL) {
+		TcpClientCtx *tc = list;
+		list = tc->next;
+		tc->next = NULL;
+		tc->pipeline = NULL;
+
+		if (tc->handle == NULL) {
+			TcpClientCtx_free(tc);
+			continue;
+		}
+
+		tc->state = TCP_REQUEST_IDLE;
+		tc->handle->perform = performRequest;
+		tc->handle->getPollInfo = getRequestPollInfo;
+	}
 }
 
-static int readResponse(KSI_RequestHandle *handle) {
+/**
+ * Receives the available bytes from the pipelined HTTP connection without blocking. The
+ * responses arrive in the order of the requests, so each complete response belongs to the
+ * oldest request in flight.
+ * \return #KSI_OK if some bytes were received, #KSI_ASYNC_NOT_FINISHED if there is nothing to read.
+ */
+static int pipelineReceiveHttp(KSI_TcpClient *client, TcpPipeline *pipeline, KSI_CTX *ctx) {
 	int res;
-	TcpClientCtx *tcp = NULL;
-	KSI_TcpClient *client = NULL;
-	int sockfd = -1;
-    struct sockaddr_in serv_addr;
-    struct hostent *server = NULL;
-    size_t count;
-    unsigned char buffer[0xffff + 4];
-    KSI_FTLV ftlv;
-#ifdef _WIN32
-	DWORD transferTimeout = 0;
-#else
-	struct timeval  transferTimeout;
-#endif
-
-	if (handle == NULL) {
-		res = KSI_INVALID_ARGUMENT;
+	unsigned char chunk[TCP_HTTP_CHUNK_SIZE];
+	size_t count = 0;
+	size_t off = 0;
+	int eof = 0;
+
+	res = recvSome(pipeline->conn->fd, chunk, sizeof(chunk), &count);
+	if (res == KSI_ASYNC_NOT_FINISHED) {
+		if (client->transferTimeoutSeconds > 0 && KSI_getTimeMs() - pipeline->lastActivity >= (KSI_uint64_t)client->transferTimeoutSeconds * 1000) {
+			pipelineAbort(pipeline, KSI_NETWORK_RECIEVE_TIMEOUT);
+			KSI_pushError(ctx, res = KSI_NETWORK_RECIEVE_TIMEOUT, "Request timed out.");
+		}
 		goto cleanup;
 	}
 
-	KSI_ERR_clearErrors(handle->ctx);
-
-	tcp = handle->implCtx;
-	client = (KSI_TcpClient*)handle->client;
+	/* A closed connection completes a response without a length, the rest of the requests fail. */
+	if (res != KSI_OK) eof = 1;
 
-    sockfd = (int)socket(AF_INET, SOCK_STREAM, 0);
-    if (sockfd < 0) {
-    	KSI_pushError(handle->ctx, res = KSI_NETWORK_ERROR, "Unable to open socket.");
-    	goto cleanup;
-    }
-#ifdef _WIN32
-	transferTimeout = client->transferTimeoutSeconds * 1000;
-#else
-	transferTimeout.tv_sec = client->transferTimeoutSeconds;
-    transferTimeout.tv_usec = 0;
+	pipeline->lastActivity = KSI_getTimeMs();
 
-#endif
+	do {
+		TcpClientCtx *tc = pipeline->pending;
+		size_t used = 0;
+		int keepAlive;
 
-	/*Set socket options*/
-	setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, (void*)&transferTimeout, sizeof(transferTimeout));
-	setsockopt(sockfd, SOL_SOCKET, SO_SNDTIMEO, (void*)&transferTimeout, sizeof(transferTimeout));
+		if (tc == NULL) {
+			if (eof) break;
+			pipelineAbort(pipeline, KSI_NETWORK_ERROR);
+			KSI_pushError(ctx, res = KSI_NETWORK_ERROR, "Unexpected data on the pipelined connection.");
+			goto cleanup;
+		}
 
-    server = gethostbyname(tcp->host);
-    if (server == NULL) {
-    	KSI_pushError(handle->ctx, res = KSI_NETWORK_ERROR, "Unable to open host.");
-    	goto cleanup;
-    }
+		pipeline->http.handle = tc->handle;
 
-	memset((char *) &serv_addr, 0, sizeof(serv_addr));
-    serv_addr.sin_family = AF_INET;
+		res = httpReceive(&pipeline->http, chunk + off, count - off, &used);
+		if (res != KSI_OK) {
+			/* The connection was closed in the middle of a response. */
+			if (eof) res = KSI_NETWORK_ERROR;
+			pipelineAbort(pipeline, res);
+			KSI_pushError(ctx, res, "Unable to parse the HTTP response.");
+			goto cleanup;
+		}
+		off += used;
 
-	memmove((char *)&serv_addr.sin_addr.s_addr, (char *)server->h_addr, server->h_length);
+		if (!pipeline->http.complete) break;
 
-    serv_addr.sin_port = htons(tcp->port);
+		keepAlive = pipeline->http.keepAlive;
 
-    if ((res = connect(sockfd, (struct sockaddr *) &serv_addr, sizeof(serv_addr))) < 0) {
-    	KSI_ERR_push(handle->ctx, KSI_NETWORK_ERROR, res, __FILE__, __LINE__, "Unable to connect.");
-		res = KSI_NETWORK_ERROR;
-    	goto cleanup;
-    }
+		pipelineRemove(pipeline, tc);
+		httpDeliver(&pipeline->http, tc);
 
-    KSI_LOG_logBlob(handle->ctx, KSI_LOG_DEBUG, "Sending request", handle->request, handle->request_length);
-    count = 0;
-    while (count < handle->request_length) {
-    	int c;
+		if (tc->handle != NULL) {
+			KSI_RequestHandle_complete(tc->handle, KSI_OK);
+		} else {
+			TcpClientCtx_free(tc);
+		}
 
-#ifdef _WIN32
-    	if (handle->request_length > INT_MAX) {
-    		KSI_pushError(handle->ctx, res = KSI_BUFFER_OVERFLOW, "Unable to send more than MAX_INT bytes.");
-    		goto cleanup;
-    	}
-		c = send(sockfd, (char *) handle->request, (int) handle->request_length, 0);
-#else
-		c = send(sockfd, (char *) handle->request, handle->request_length, 0);
-#endif
-		if (c < 0) {
-			KSI_pushError(handle->ctx, res = KSI_NETWORK_ERROR, "Unable to write to socket.");
-			goto cleanup;
+		if (!keepAlive) {
+			/* The server does not keep the connections open, do not pipeline any more requests. */
+			pipeline->isPersistent = 0;
+			eof = 1;
 		}
-		count += c;
-    }
+	} while (off < count && !eof);
 
-	res = KSI_FTLV_socketRead(sockfd, buffer, sizeof(buffer), &count, &ftlv);
-    if (res != KSI_OK || count == 0){
-		KSI_pushError(handle->ctx, res = KSI_INVALID_ARGUMENT, "Unable to read TLV from socket.");
+	/* No part of the pending responses has arrived, so the requests may be sent again. */
+	if (eof) pipelineFallback(pipeline, ctx);
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/**
+ * Receives the available bytes of the current response from the pipelined connection without
+ * blocking and routes the response to its handle once complete.
+ * \return #KSI_OK if some bytes were received, #KSI_ASYNC_NOT_FINISHED if there is nothing to read.
+ */
+static int pipelineReceive(KSI_TcpClient *client, TcpPipeline *pipeline, KSI_CTX *ctx) {
+	int res;
+	size_t count = 0;
+	size_t tlvLen;
+
+	if (pipeline->conn == NULL) {
+		KSI_pushError(ctx, res = KSI_NETWORK_ERROR, "Pipelined connection is closed.");
 		goto cleanup;
 	}
 
-	if(count > UINT_MAX){
-		KSI_pushError(handle->ctx, res = KSI_BUFFER_OVERFLOW, "Too much data read from socket.");
+	if (pipeline->isHttp) {
+		res = pipelineReceiveHttp(client, pipeline, ctx);
 		goto cleanup;
 	}
 
-	handle->response = KSI_malloc(count);
-	if (handle->response == NULL) {
-		KSI_pushError(handle->ctx, res = KSI_OUT_OF_MEMORY, NULL);
+	if (pipeline->buffer == NULL) {
+		/* Read the 2 byte header, and the following 2 bytes for a 16 bit TLV. */
+		res = recvSome(pipeline->conn->fd, pipeline->hdr + pipeline->filled, (pipeline->filled < 2 ? 2 : 4) - pipeline->filled, &count);
+	} else {
+		/* Read the rest of the response straight into its own buffer. */
+		res = recvSome(pipeline->conn->fd, pipeline->buffer + pipeline->filled, pipeline->buffer_len - pipeline->filled, &count);
+	}
+
+	if (res == KSI_ASYNC_NOT_FINISHED) {
+		if (client->transferTimeoutSeconds > 0 && KSI_getTimeMs() - pipeline->lastActivity >= (KSI_uint64_t)client->transferTimeoutSeconds * 1000) {
+			pipelineAbort(pipeline, KSI_NETWORK_RECIEVE_TIMEOUT);
+			KSI_pushError(ctx, res = KSI_NETWORK_RECIEVE_TIMEOUT, "Request timed out.");
+		}
 		goto cleanup;
 	}
-	memcpy(handle->response, buffer, count);
-	handle->response_length = count;
+
+	if (res != KSI_OK) {
+		pipelineAbort(pipeline, KSI_NETWORK_ERROR);
+		KSI_pushError(ctx, res = KSI_NETWORK_ERROR, "Unable to read TLV from socket.");
+		goto cleanup;
+	}
+
+	pipeline->filled += count;
+	pipeline->lastActivity = KSI_getTimeMs();
+
+	if (pipeline->buffer == NULL) {
+		tlvLen = getTlvLength(pipeline->hdr, pipeline->filled);
+		if (tlvLen == 0) {
+			res = KSI_OK;
+			goto cleanup;
+		}
+
+		pipeline->buffer = KSI_malloc(tlvLen);
+		if (pipeline->buffer == NULL) {
+			pipelineAbort(pipeline, KSI_OUT_OF_MEMORY);
+			KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+			goto cleanup;
+		}
+		memcpy(pipeline->buffer, pipeline->hdr, pipeline->filled);
+		pipeline->buffer_len = tlvLen;
+	}
+
+	if (pipeline->filled == pipeline->buffer_len) {
+		res = pipelineRoute(pipeline, ctx);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/**
+ * Returns the number of milliseconds the pipelined connection may stay silent before the
+ * requests in flight time out, -1 for no limit.
+ */
+static int pipelineRemainingMs(KSI_TcpClient *client, TcpPipeline *pipeline) {
+	if (client->transferTimeoutSeconds <= 0) return -1;
+	return remainingMs(pipeline->lastActivity + (KSI_uint64_t)client->transferTimeoutSeconds * 1000);
+}
+
+/**
+ * Writes the request to the pipelined connection, without waiting for the responses
+ * of the requests already in flight.
+ */
+static int pipelineSend(KSI_TcpClient *client, TcpPipeline *pipeline, TcpClientCtx *tc) {
+	int res;
+	KSI_RequestHandle *handle = tc->handle;
+	int retry = 1;
+
+	/* Do not wait for more responses than allowed, as the peer may stop reading requests
+	 * until the responses are consumed. */
+	while (pipeline->pendingCount >= client->maxPipelineDepth) {
+		res = pipelineReceive(client, pipeline, handle->ctx);
+		if (res == KSI_ASYNC_NOT_FINISHED) {
+			if (KSI_RequestHandle_isExpired(handle)) {
+				KSI_pushError(handle->ctx, res = KSI_NETWORK_SEND_TIMEOUT, "Request deadline has passed.");
+				goto cleanup;
+			}
+			if (waitSocket(pipeline->conn->fd, KSI_NET_EVENT_READ, KSI_RequestHandle_remainingMs(handle, pipelineRemainingMs(client, pipeline))) < 0) {
+				pipelineAbort(pipeline, KSI_NETWORK_ERROR);
+				KSI_pushError(handle->ctx, res = KSI_NETWORK_ERROR, "Unable to wait for the socket.");
+				goto cleanup;
+			}
+			continue;
+		}
+
+		if (res != KSI_OK) {
+			KSI_pushError(handle->ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	for (;;) {
+		/* Nothing is expected on an idle connection - check that it is still usable. */
+		if (pipeline->conn != NULL && pipeline->pending == NULL) {
+			if (KSI_getTimeMs() - pipeline->lastActivity > (KSI_uint64_t)client->poolIdleTimeoutSeconds * 1000 || !isConnectionAlive(pipeline->conn)) {
+				KSI_LOG_debug(handle->ctx, "Tcp: Dropping stale pipelined connection to %s:%u", pipeline->host, pipeline->port);
+				pipelineAbort(pipeline, KSI_NETWORK_ERROR);
+			}
+		}
+
+		if (pipeline->conn == NULL) {
+			if (KSI_RequestHandle_isExpired(handle)) {
+				KSI_pushError(handle->ctx, res = KSI_NETWORK_CONNECTION_TIMEOUT, "Request deadline has passed.");
+				goto cleanup;
+			}
+
+			res = openConnection(handle->ctx, pipeline->host, pipeline->port, &pipeline->conn);
+			if (res != KSI_OK) {
+				KSI_pushError(handle->ctx, res, NULL);
+				goto cleanup;
+			}
+
+			res = waitConnected(handle->ctx, pipeline->conn, KSI_RequestHandle_remainingMs(handle, client->transferTimeoutSeconds > 0 ? client->transferTimeoutSeconds * 1000 : -1));
+			if (res != KSI_OK) {
+				pipelineAbort(pipeline, res);
+				KSI_pushError(handle->ctx, res, NULL);
+				goto cleanup;
+			}
+			retry = 0;
+		}
+
+		KSI_LOG_logBlob(handle->ctx, KSI_LOG_DEBUG, "Sending pipelined request", tc->out, tc->out_len);
+		res = sendAll(tc, pipeline->conn->fd, client->transferTimeoutSeconds);
+		if (res == KSI_OK) break;
+
+		if (pipeline->isHttp) {
+			/* The server may have closed the connection after answering some of the requests. */
+			pipelineFallback(pipeline, handle->ctx);
+		} else {
+			/* The requests already in flight are lost together with the connection. */
+			pipelineAbort(pipeline, KSI_NETWORK_ERROR);
+		}
+
+		if (!retry) {
+			KSI_pushError(handle->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		KSI_LOG_debug(handle->ctx, "Tcp: Pipelined connection failed, reconnecting.");
+		KSI_ERR_clearErrors(handle->ctx);
+		retry = 0;
+	}
+
+	pipeline->lastActivity = KSI_getTimeMs();
+
+	tc->pipeline = pipeline;
+	tc->status = KSI_OK;
+
+	/* Keep the requests in the order they were sent, the oldest first. */
+	{
+		TcpClientCtx **pp = &pipeline->pending;
+		while (*pp != NULL) pp = &(*pp)->next;
+		*pp = tc;
+	}
+	pipeline->pendingCount++;
 
 	res = KSI_OK;
 
 cleanup:
 
-	if (sockfd >= 0) close(sockfd);
+	return res;
+}
+
+/**
+ * Receives the pipelined responses as far as possible without blocking, until the
+ * response for this handle has arrived.
+ */
+static int performPipelined(KSI_RequestHandle *handle, int events) {
+	int res;
+	TcpClientCtx *tc = NULL;
+
+	if (handle == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	tc = handle->implCtx;
+
+	while (handle->response == NULL) {
+		/* The request has been moved to a connection of its own. */
+		if (handle->perform != performPipelined) {
+			res = handle->perform(handle, events);
+			goto cleanup;
+		}
+
+		if (tc->pipeline == NULL) {
+			/* The body of an HTTP response may have been passed to the response consumer. */
+			if (tc->httpRequest != NULL && tc->status == KSI_OK) break;
+			KSI_pushError(handle->ctx, res = (tc->status != KSI_OK ? tc->status : KSI_NETWORK_ERROR), "Connection closed before the response was received.");
+			goto cleanup;
+		}
+
+		res = pipelineReceive(tc->client, tc->pipeline, handle->ctx);
+		if (res == KSI_ASYNC_NOT_FINISHED) {
+			/* The late response is still routed to the handle, but it is not waited for. */
+			if (KSI_RequestHandle_isExpired(handle)) {
+				KSI_pushError(handle->ctx, res = KSI_NETWORK_RECIEVE_TIMEOUT, "Request deadline has passed.");
+			}
+			goto cleanup;
+		}
+		if (res != KSI_OK) {
+			KSI_pushError(handle->ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	res = KSI_OK;
+
+cleanup:
 
 	return res;
 }
 
-static int sendRequest(KSI_NetworkClient *client, KSI_RequestHandle *handle, char *host, unsigned port) {
+static int getPipelinePollInfo(KSI_RequestHandle *handle, int *fd, int *events, int *timeoutMs) {
+	TcpClientCtx *tc = handle->implCtx;
+
+	*fd = -1;
+	*events = 0;
+	*timeoutMs = 0;
+
+	if (tc->pipeline != NULL && tc->pipeline->conn != NULL) {
+		*fd = tc->pipeline->conn->fd;
+		*events = KSI_NET_EVENT_READ;
+		*timeoutMs = KSI_RequestHandle_remainingMs(handle, pipelineRemainingMs(tc->client, tc->pipeline));
+	}
+
+	return KSI_OK;
+}
+
+/**
+ * Starts the request, the response is received by the perform and read functions of the handle.
+ * The ownership of \c httpRequest is taken even if the function fails.
+ */
+static int startRequest(KSI_TcpClient *client, KSI_RequestHandle *handle, const char *host, unsigned port, unsigned char *httpRequest, size_t httpRequest_len, int *httpStatus) {
 	int res;
 	TcpClientCtx *tc = NULL;
+	TcpClientCtx *tcp = NULL;
 
 	if (handle == NULL) {
 		res = KSI_INVALID_ARGUMENT;
@@ -221,6 +1871,33 @@ static int sendRequest(KSI_NetworkClient *client, KSI_RequestHandle *handle, cha
 	}
 	tc->host = NULL;
 	tc->port = 0;
+	tc->handle = handle;
+	tc->client = client;
+	tc->out = handle->request;
+	tc->out_len = handle->request_length;
+	tc->httpRequest = NULL;
+	tc->httpStatus = httpStatus;
+	tc->http.body = NULL;
+	httpReceiverReset(&tc->http, handle);
+	tc->state = TCP_REQUEST_IDLE;
+	tc->conn = NULL;
+	tc->isReused = 0;
+	tc->sent = 0;
+	tc->buffer = NULL;
+	tc->buffer_len = 0;
+	tc->received = 0;
+	tc->deadline = 0;
+	tc->pipeline = NULL;
+	tc->requestId = 0;
+	tc->status = KSI_OK;
+	tc->next = NULL;
+
+	if (httpRequest != NULL) {
+		tc->httpRequest = httpRequest;
+		tc->out = httpRequest;
+		tc->out_len = httpRequest_len;
+		httpRequest = NULL;
+	}
 
 	KSI_LOG_debug(handle->ctx, "Tcp: Sending request to: %s:%u", host, port);
 
@@ -233,7 +1910,8 @@ static int sendRequest(KSI_NetworkClient *client, KSI_RequestHandle *handle, cha
 
 
 	handle->readResponse = readResponse;
-	handle->client = client;
+	handle->perform = performRequest;
+	handle->getPollInfo = getRequestPollInfo;
 
     res = KSI_RequestHandle_setImplContext(handle, tc, (void (*)(void *))TcpClientCtx_free);
 	if (res != KSI_OK) {
@@ -241,17 +1919,58 @@ static int sendRequest(KSI_NetworkClient *client, KSI_RequestHandle *handle, cha
 		goto cleanup;
 	}
 
+	/* The context is now owned by the handle. */
+	tcp = tc;
 	tc = NULL;
 
+	/* Write the request immediately if it can be pipelined. An HTTP response is routed back by
+	 * its order and a TLV response by the request ID. */
+	if (client->maxPipelineDepth > 0 && (tcp->httpRequest != NULL || getPduRequestId(handle->request, handle->request_length, &tcp->requestId) == KSI_OK)) {
+		TcpPipeline *pipeline = NULL;
+
+		res = getPipeline(client, handle->ctx, host, port, tcp->httpRequest != NULL, &pipeline);
+		if (res != KSI_OK) {
+			KSI_pushError(handle->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		if (pipeline->isPersistent) {
+			res = pipelineSend(client, pipeline, tcp);
+			if (res != KSI_OK) {
+				KSI_pushError(handle->ctx, res, NULL);
+				goto cleanup;
+			}
+
+			handle->perform = performPipelined;
+			handle->getPollInfo = getPipelinePollInfo;
+		}
+	}
+
 	res = KSI_OK;
 
 cleanup:
 
 	TcpClientCtx_free(tc);
+	KSI_free(httpRequest);
 
 	return res;
 }
 
+static int sendRequest(KSI_NetworkClient *client, KSI_RequestHandle *handle, char *host, unsigned port) {
+	if (handle != NULL) handle->client = client;
+
+	return startRequest((KSI_TcpClient *)client, handle, host, port, NULL, 0, NULL);
+}
+
+int KSI_TcpClient_sendHttpRequest(KSI_TcpClient *client, KSI_RequestHandle *handle, const char *host, unsigned port, unsigned char *request, size_t request_len, int *httpStatus) {
+	if (request == NULL) {
+		if (handle != NULL) KSI_pushError(handle->ctx, KSI_INVALID_ARGUMENT, NULL);
+		return KSI_INVALID_ARGUMENT;
+	}
+
+	return startRequest(client, handle, host, port, request, request_len, httpStatus);
+}
+
 static int prepareRequest(
 		KSI_NetworkClient *client,
 		void *pdu,
@@ -390,6 +2109,10 @@ cleanup:
 	return res;
 }
 
+static int getPublicationUrl(KSI_NetworkClient *client, const char **url) {
+	return KSI_NetworkClient_getPublicationUrl((KSI_NetworkClient *)((KSI_TcpClient *)client)->http, url);
+}
+
 static int sendPublicationRequest(KSI_NetworkClient *client, KSI_RequestHandle **handle) {
 	int res;
 	KSI_TcpClient *tcpClient = (KSI_TcpClient *)client;
@@ -408,6 +2131,8 @@ static void tcpClient_free(KSI_TcpClient *tcp) {
 	if (tcp != NULL) {
 		KSI_free(tcp->aggrHost);
 		KSI_free(tcp->extHost);
+		freePipelines(tcp);
+		freeConnectionPool(tcp);
 		KSI_HttpClient_free(tcp->http);
 		KSI_free(tcp);
 	}
@@ -437,14 +2162,27 @@ int KSI_TcpClient_init(KSI_CTX *ctx, KSI_TcpClient *client) {
 		goto cleanup;
 	}
 
+	/* The host names are resolved via the process-wide cache. */
+	res = KSI_CTX_registerGlobals(ctx, KSI_Resolver_global_init, KSI_Resolver_global_cleanup);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
 	client->sendRequest = sendRequest;
 	client->aggrHost = NULL;
 	client->aggrPort = 0;
 	client->extHost = NULL;
 	client->extPort = 0;
 	client->http = NULL;
+	client->pool = NULL;
+	client->poolSize = 0;
+	client->pipelines = NULL;
+	client->maxPipelineDepth = 0;
 
 	client->transferTimeoutSeconds = 10;
+	client->maxPoolSize = 4;
+	client->poolIdleTimeoutSeconds = 10;
 
 	res = KSI_HttpClient_new(ctx, &client->http);
 	if (res != KSI_OK) {
@@ -456,6 +2194,7 @@ int KSI_TcpClient_init(KSI_CTX *ctx, KSI_TcpClient *client) {
 	client->parent.sendSignRequest = prepareAggregationRequest;
 	client->parent.sendPublicationRequest = sendPublicationRequest;
 	client->parent.getStausCode = NULL;
+	client->parent.getPublicationUrl = getPublicationUrl;
 	client->parent.implFree = (void (*)(void *))tcpClient_free;
 
 	res = KSI_OK;
@@ -589,3 +2328,63 @@ cleanup:
 
 	return res;
 }
+
+int KSI_TcpClient_setMaxPoolSize(KSI_TcpClient *client, size_t maxPoolSize) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (client == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	client->maxPoolSize = maxPoolSize;
+
+	/* Close the connections that do not fit into the pool anymore. */
+	while (client->poolSize > client->maxPoolSize) {
+		TcpConnection **pp = &client->pool;
+		while ((*pp)->next != NULL) pp = &(*pp)->next;
+		TcpConnection_free(*pp);
+		*pp = NULL;
+		client->poolSize--;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_TcpClient_setPoolIdleTimeoutSeconds(KSI_TcpClient *client, int idleTimeoutSeconds) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (client == NULL || idleTimeoutSeconds < 0) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	client->poolIdleTimeoutSeconds = idleTimeoutSeconds;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_TcpClient_setMaxPipelineDepth(KSI_TcpClient *client, size_t maxPipelineDepth) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (client == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	client->maxPipelineDepth = maxPipelineDepth;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
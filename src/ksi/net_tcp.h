@@ -92,6 +92,39 @@ extern "C" {
 	 */
 	int KSI_TcpClient_setTransferTimeoutSeconds(KSI_TcpClient *client, int val);
 
+	/**
+	 * Setter for the maximum number of idle connections the client keeps open for reuse
+	 * by subsequent requests to the same aggregator or extender. Setting the value to 0
+	 * disables connection reuse - every request will open and close its own connection.
+	 * \param[in]	client		Pointer to the tcp client.
+	 * \param[in]	val			Maximum number of pooled connections (default 4).
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_TcpClient_setMaxPoolSize(KSI_TcpClient *client, size_t val);
+
+	/**
+	 * Setter for the idle timeout of pooled connections in seconds. Connections that have
+	 * been idle for longer are closed instead of reused.
+	 * \param[in]	client		Pointer to the tcp client.
+	 * \param[in]	val			Idle timeout in seconds (default 10).
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_TcpClient_setPoolIdleTimeoutSeconds(KSI_TcpClient *client, int val);
+
+	/**
+	 * Setter for the maximum number of requests in flight on a single pipelined connection.
+	 * When enabled, requests are written to the aggregator or extender as soon as they are
+	 * sent and the responses are routed back to the request handles by the request ID, in
+	 * the order they arrive. This allows a single thread to send many requests before
+	 * reading any of the responses. Setting the value to 0 disables pipelining and the
+	 * request is sent only when its response is requested.
+	 * \param[in]	client		Pointer to the tcp client.
+	 * \param[in]	val			Maximum number of requests in flight (default 0).
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \note The request handles must not outlive the client.
+	 */
+	int KSI_TcpClient_setMaxPipelineDepth(KSI_TcpClient *client, size_t val);
+
 #ifdef __cplusplus
 }
 #endif
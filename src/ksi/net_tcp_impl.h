@@ -24,17 +24,35 @@
 #include "net_http.h"
 #include "net_impl.h"
 #include "net_http_impl.h"
+#include "net_tcp.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+	typedef struct TcpConnection_st TcpConnection;
+	typedef struct TcpPipeline_st TcpPipeline;
+
 	struct KSI_TcpClient_st {
 		KSI_NetworkClient parent;
 	
 
 		/* TODO: Is it required to be a signed int? */
 		int transferTimeoutSeconds;
+
+		/** Idle keep-alive connections, most recently used first. */
+		TcpConnection *pool;
+		/** Number of connections in #pool. */
+		size_t poolSize;
+		/** Maximum number of idle connections kept open, 0 disables connection reuse. */
+		size_t maxPoolSize;
+		/** Idle connections older than this are closed instead of reused. */
+		int poolIdleTimeoutSeconds;
+
+		/** Pipelined connections, one per endpoint. */
+		TcpPipeline *pipelines;
+		/** Maximum number of requests in flight on a pipelined connection, 0 disables pipelining. */
+		size_t maxPipelineDepth;
 	
 		char *aggrHost;
 		unsigned aggrPort;
@@ -46,6 +64,22 @@ extern "C" {
 		KSI_HttpClient *http;
 	};
 
+	/**
+	 * Sends an HTTP request over the connections of the TCP client. The connections are pooled
+	 * and pipelined like for the TLV requests, but the response is framed by the HTTP parser and
+	 * the pipelined responses are matched with the requests by their order. The body of the
+	 * response is passed to the handle as it arrives.
+	 * \param[in]	client			TCP client providing the connections.
+	 * \param[in]	handle			Request handle, its network client is not changed.
+	 * \param[in]	host			Host name of the server.
+	 * \param[in]	port			Port of the server.
+	 * \param[in]	request			Serialized HTTP request, owned by the client even if the function fails.
+	 * \param[in]	request_len		Length of the serialized request.
+	 * \param[out]	httpStatus		Receives the HTTP status code of the response, may be \c NULL.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_TcpClient_sendHttpRequest(KSI_TcpClient *client, KSI_RequestHandle *handle, const char *host, unsigned port, unsigned char *request, size_t request_len, int *httpStatus);
+
 
 #ifdef __cplusplus
 }
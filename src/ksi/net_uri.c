@@ -18,6 +18,14 @@
  */
 
 #include <string.h>
+#include <stdlib.h>
+
+#ifndef _WIN32
+#  include <errno.h>
+#  include <poll.h>
+#else
+#  include <winsock2.h>
+#endif
 
 #include "internal.h"
 
@@ -28,16 +36,569 @@
 #include "net_http.h"
 #include "http_parser.h"
 
+enum serviceMethod_e {
+	SRV_EXTEND,
+	SRV_AGGREGATE
+};
+
+/* Smoothing factor of the moving averages. */
+#define KSI_URI_EWMA_ALPHA 0.2
+/* Weight of the failure rate when comparing the endpoints. */
+#define KSI_URI_ERROR_PENALTY 10.0
+/* Number of consecutive failures after which the circuit breaker opens. */
+#define KSI_URI_BREAKER_THRESHOLD 3
+/* Time in milliseconds an open circuit breaker keeps the endpoint out of use. */
+#define KSI_URI_BREAKER_COOLDOWN_MS 5000
+/* Minimum number of latency samples before hedged requests are sent. */
+#define KSI_URI_HEDGE_MIN_SAMPLES 8
+
+typedef struct RoutedAttempt_st {
+	/** Handle of the request sent to the endpoint, \c NULL if the slot is free. */
+	KSI_RequestHandle *handle;
+	/** Index of the endpoint. */
+	size_t endpoint;
+	/** Time the request was sent. */
+	KSI_uint64_t started;
+} RoutedAttempt;
+
+typedef struct RoutedRequest_st {
+	KSI_UriClient *client;
+	enum serviceMethod_e service;
+	/** Bitmask of the endpoints the request has been sent to. */
+	unsigned tried;
+	/** Set once a hedged request has been sent. */
+	int hedged;
+	/** The first request and the hedged request. */
+	RoutedAttempt attempts[2];
+} RoutedRequest;
+
+static KSI_UriService *getService(KSI_UriClient *client, enum serviceMethod_e service) {
+	return service == SRV_AGGREGATE ? &client->aggregators : &client->extenders;
+}
+
+static KSI_NetworkClient *getEndpointClient(KSI_UriClient *client, enum serviceMethod_e service, size_t idx) {
+	KSI_UriEndpoint *ep = &getService(client, service)->endpoints[idx];
+
+	if (ep->client != NULL) return ep->client;
+
+	return service == SRV_AGGREGATE ? client->pAggregationClient : client->pExtendClient;
+}
+
+static void resetEndpoint(KSI_UriEndpoint *ep) {
+	KSI_NetworkClient_free(ep->client);
+	memset(ep, 0, sizeof(KSI_UriEndpoint));
+}
+
+static void resetService(KSI_UriService *srv) {
+	size_t i;
+
+	for (i = 0; i < srv->count; i++) {
+		resetEndpoint(&srv->endpoints[i]);
+	}
+
+	srv->count = 0;
+}
+
+static int compareUnsigned(const void *a, const void *b) {
+	unsigned x = *(const unsigned *)a;
+	unsigned y = *(const unsigned *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/**
+ * Returns the 95th percentile of the recent response times of the endpoint, 0 if there
+ * are not enough samples.
+ */
+static unsigned getP95Latency(const KSI_UriEndpoint *ep) {
+	unsigned sorted[KSI_URI_LATENCY_SAMPLES];
+	size_t idx;
+
+	if (ep->sampleCount < KSI_URI_HEDGE_MIN_SAMPLES) return 0;
+
+	memcpy(sorted, ep->samples, ep->sampleCount * sizeof(unsigned));
+	qsort(sorted, ep->sampleCount, sizeof(unsigned), compareUnsigned);
+
+	idx = (ep->sampleCount * 95 + 99) / 100 - 1;
+
+	/* A zero delay would hedge every request. */
+	return sorted[idx] > 0 ? sorted[idx] : 1;
+}
+
+static void recordResult(KSI_UriEndpoint *ep, int success, KSI_uint64_t latency, KSI_uint64_t now) {
+	if (success) {
+		unsigned sample = latency > UINT_MAX ? UINT_MAX : (unsigned)latency;
+
+		if (ep->sampleCount == 0) {
+			ep->latencyMs = (double)sample;
+		} else {
+			ep->latencyMs += KSI_URI_EWMA_ALPHA * ((double)sample - ep->latencyMs);
+		}
+
+		ep->samples[ep->samplePos] = sample;
+		ep->samplePos = (ep->samplePos + 1) % KSI_URI_LATENCY_SAMPLES;
+		if (ep->sampleCount < KSI_URI_LATENCY_SAMPLES) ep->sampleCount++;
+
+		ep->errorRate -= KSI_URI_EWMA_ALPHA * ep->errorRate;
+		ep->failures = 0;
+		ep->openUntil = 0;
+	} else {
+		ep->errorRate += KSI_URI_EWMA_ALPHA * (1.0 - ep->errorRate);
+		ep->failures++;
+
+		if (ep->failures >= KSI_URI_BREAKER_THRESHOLD) {
+			ep->openUntil = now + KSI_URI_BREAKER_COOLDOWN_MS;
+		}
+	}
+}
+
+/**
+ * Selects the endpoint with the best expected response time among the endpoints not yet
+ * tried. Endpoints with an open circuit breaker are used only if there is no other choice,
+ * starting from the one closest to closing.
+ * 
+eturn index of the endpoint, or #KSI_URI_MAX_ENDPOINTS if all the endpoints have been tried.
+ */
+static size_t selectEndpoint(const KSI_UriService *srv, unsigned tried, KSI_uint64_t now) {
+	size_t best = KSI_URI_MAX_ENDPOINTS;
+	size_t bestOpen = KSI_URI_MAX_ENDPOINTS;
+	double bestScore = 0;
+	size_t i;
+
+	for (i = 0; i < srv->count; i++) {
+		const KSI_UriEndpoint *ep = &srv->endpoints[i];
+		double score;
+
+		if (tried & (1u << i)) continue;
+
+		if (ep->openUntil > now) {
+			if (bestOpen == KSI_URI_MAX_ENDPOINTS || ep->openUntil < srv->endpoints[bestOpen].openUntil) bestOpen = i;
+			continue;
+		}
+
+		score = (ep->latencyMs + 1.0) * (1.0 + KSI_URI_ERROR_PENALTY * ep->errorRate);
+		if (best == KSI_URI_MAX_ENDPOINTS || score < bestScore) {
+			best = i;
+			bestScore = score;
+		}
+	}
+
+	return best != KSI_URI_MAX_ENDPOINTS ? best : bestOpen;
+}
+
+static void RoutedRequest_free(RoutedRequest *rr) {
+	if (rr != NULL) {
+		KSI_RequestHandle_free(rr->attempts[0].handle);
+		KSI_RequestHandle_free(rr->attempts[1].handle);
+		KSI_free(rr);
+	}
+}
+
+/**
+ * Sends the request held by the routed handle to the given endpoint. The request is
+ * parsed from the raw PDU, so it can be enclosed with the credentials of the endpoint.
+ */
+static int resendRequest(KSI_RequestHandle *outer, RoutedRequest *rr, size_t idx, KSI_RequestHandle **handle) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_NetworkClient *nc = getEndpointClient(rr->client, rr->service, idx);
+	KSI_AggregationPdu *aggrPdu = NULL;
+	KSI_AggregationReq *aggrReq = NULL;
+	KSI_ExtendPdu *extPdu = NULL;
+	KSI_ExtendReq *extReq = NULL;
+
+	if (rr->service == SRV_AGGREGATE) {
+		res = KSI_AggregationPdu_parse(outer->ctx, outer->request, outer->request_length, &aggrPdu);
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_AggregationPdu_getRequest(aggrPdu, &aggrReq);
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_NetworkClient_sendSignRequest(nc, aggrReq, handle);
+		if (res != KSI_OK) goto cleanup;
+	} else {
+		res = KSI_ExtendPdu_parse(outer->ctx, outer->request, outer->request_length, &extPdu);
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_ExtendPdu_getRequest(extPdu, &extReq);
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_NetworkClient_sendExtendRequest(nc, extReq, handle);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_AggregationPdu_free(aggrPdu);
+	KSI_ExtendPdu_free(extPdu);
+
+	return res;
+}
+
+/**
+ * Sends the request to the next endpoint into the given attempt slot. Endpoints refusing
+ * the request are skipped.
+ */
+static int startAttempt(KSI_RequestHandle *outer, RoutedRequest *rr, RoutedAttempt *attempt) {
+	int res = KSI_NETWORK_ERROR;
+	KSI_UriService *srv = getService(rr->client, rr->service);
+
+	for (;;) {
+		KSI_uint64_t now = KSI_getTimeMs();
+		size_t idx = selectEndpoint(srv, rr->tried, now);
+
+		if (idx == KSI_URI_MAX_ENDPOINTS) break;
+
+		rr->tried |= 1u << idx;
+
+		res = resendRequest(outer, rr, idx, &attempt->handle);
+		if (res == KSI_OK) {
+			/* All the attempts share the deadline of the routed request. */
+			attempt->handle->deadline = outer->deadline;
+			attempt->endpoint = idx;
+			attempt->started = now;
+			break;
+		}
+
+		KSI_LOG_debug(outer->ctx, "Unable to send request to endpoint %u.", (unsigned)idx);
+		recordResult(&srv->endpoints[idx], 0, 0, now);
+	}
+
+	return res;
+}
+
+/**
+ * Waits until any of the descriptors is ready or the timeout passes. The events that
+ * occurred are written back to \c events.
+ */
+static int waitAny(int *fds, int *events, size_t count, int timeoutMs) {
+	size_t i;
+	int c;
+#ifdef _WIN32
+	fd_set readSet;
+	fd_set writeSet;
+	fd_set errSet;
+	struct timeval tv;
+
+	FD_ZERO(&readSet);
+	FD_ZERO(&writeSet);
+	FD_ZERO(&errSet);
+
+	for (i = 0; i < count; i++) {
+		if (events[i] & KSI_NET_EVENT_READ) FD_SET((SOCKET)fds[i], &readSet);
+		if (events[i] & KSI_NET_EVENT_WRITE) FD_SET((SOCKET)fds[i], &writeSet);
+		FD_SET((SOCKET)fds[i], &errSet);
+	}
+
+	tv.tv_sec = timeoutMs / 1000;
+	tv.tv_usec = (timeoutMs % 1000) * 1000;
+
+	if (count == 0) {
+		Sleep(timeoutMs < 0 ? 0 : timeoutMs);
+		return 0;
+	}
+
+	c = select(0, &readSet, &writeSet, &errSet, timeoutMs < 0 ? NULL : &tv);
+	if (c < 0) return -1;
+
+	for (i = 0; i < count; i++) {
+		int ready = 0;
+		if (FD_ISSET((SOCKET)fds[i], &readSet)) ready |= KSI_NET_EVENT_READ;
+		if (FD_ISSET((SOCKET)fds[i], &writeSet)) ready |= KSI_NET_EVENT_WRITE;
+		if (FD_ISSET((SOCKET)fds[i], &errSet)) ready |= events[i];
+		events[i] = ready;
+	}
+#else
+	struct pollfd pfd[2];
+
+	for (i = 0; i < count; i++) {
+		pfd[i].fd = fds[i];
+		pfd[i].events = 0;
+		pfd[i].revents = 0;
+		if (events[i] & KSI_NET_EVENT_READ) pfd[i].events |= POLLIN;
+		if (events[i] & KSI_NET_EVENT_WRITE) pfd[i].events |= POLLOUT;
+	}
+
+	do {
+		c = poll(pfd, (nfds_t)count, timeoutMs);
+	} while (c < 0 && errno == EINTR);
+	if (c < 0) return -1;
+
+	for (i = 0; i < count; i++) {
+		int ready = 0;
+		if (pfd[i].revents & POLLIN) ready |= KSI_NET_EVENT_READ;
+		if (pfd[i].revents & POLLOUT) ready |= KSI_NET_EVENT_WRITE;
+		if (pfd[i].revents & (POLLERR | POLLHUP | POLLNVAL)) ready |= events[i];
+		events[i] = ready;
+	}
+#endif
+
+	return c;
+}
+
+/**
+ * Moves the response of the winning attempt to the routed handle. The endpoint client
+ * becomes the client of the routed handle, so the response is verified with its key.
+ */
+static int takeResponse(KSI_RequestHandle *outer, KSI_RequestHandle *inner) {
+	int res;
+	const unsigned char *raw = NULL;
+	size_t raw_len = 0;
+
+	res = KSI_RequestHandle_getResponse(inner, &raw, &raw_len);
+	if (res != KSI_OK) return res;
+
+	/* Hand the buffer over, unless it is already owned by the parsed response. */
+	if (inner->responseTlv == NULL) {
+		KSI_RequestHandle_setResponseBuffer(outer, inner->response, inner->response_length);
+		inner->response = NULL;
+		inner->response_length = 0;
+	} else {
+		res = KSI_RequestHandle_setResponse(outer, raw, raw_len);
+		if (res != KSI_OK) return res;
+	}
+
+	outer->client = inner->client;
+
+	return KSI_OK;
+}
+
+static int routedReadResponse(KSI_RequestHandle *outer) {
+	int res = KSI_NETWORK_ERROR;
+	RoutedRequest *rr = (RoutedRequest *)outer->implCtx;
+	KSI_UriService *srv = getService(rr->client, rr->service);
+	size_t i;
+
+	for (;;) {
+		int fds[2];
+		int events[2];
+		size_t slots[2];
+		size_t fdCount = 0;
+		int active = 0;
+		int timeoutMs = -1;
+		KSI_uint64_t now;
+
+		if (KSI_RequestHandle_isExpired(outer)) {
+			KSI_pushError(outer->ctx, res = KSI_NETWORK_RECIEVE_TIMEOUT, "Request deadline has passed.");
+			goto cleanup;
+		}
+
+		/* Fail over to the next endpoint once all the attempts have failed. */
+		if (rr->attempts[0].handle == NULL && rr->attempts[1].handle == NULL) {
+			int sent = startAttempt(outer, rr, &rr->attempts[0]);
+			if (sent != KSI_OK) {
+				KSI_pushError(outer->ctx, res, "All the endpoints have failed.");
+				goto cleanup;
+			}
+		}
+
+		for (i = 0; i < 2; i++) {
+			int fd = -1;
+			int ev = 0;
+			int to = 0;
+
+			if (rr->attempts[i].handle == NULL) continue;
+			active++;
+
+			KSI_RequestHandle_getPollInfo(rr->attempts[i].handle, &fd, &ev, &to);
+			if (fd >= 0) {
+				fds[fdCount] = fd;
+				events[fdCount] = ev;
+				slots[fdCount] = i;
+				fdCount++;
+			}
+			if (to >= 0 && (timeoutMs < 0 || to < timeoutMs)) timeoutMs = to;
+		}
+
+		/* Hedge a single slow request to the next best endpoint. */
+		if (rr->client->hedging && !rr->hedged && active == 1) {
+			RoutedAttempt *a = rr->attempts[0].handle != NULL ? &rr->attempts[0] : &rr->attempts[1];
+			unsigned delay = getP95Latency(&srv->endpoints[a->endpoint]);
+
+			if (delay > 0) {
+				KSI_uint64_t hedgeAt = a->started + delay;
+				now = KSI_getTimeMs();
+
+				if (now >= hedgeAt) {
+					RoutedAttempt *b = a == &rr->attempts[0] ? &rr->attempts[1] : &rr->attempts[0];
+					rr->hedged = 1;
+					if (startAttempt(outer, rr, b) == KSI_OK) {
+						KSI_LOG_debug(outer->ctx, "Sent a hedged request to endpoint %u.", (unsigned)b->endpoint);
+						continue;
+					}
+				} else if (timeoutMs < 0 || hedgeAt - now < (KSI_uint64_t)timeoutMs) {
+					timeoutMs = (int)(hedgeAt - now);
+				}
+			}
+		}
+
+		timeoutMs = KSI_RequestHandle_remainingMs(outer, timeoutMs);
+		if (timeoutMs != 0) {
+			if (waitAny(fds, events, fdCount, timeoutMs) < 0) {
+				KSI_pushError(outer->ctx, res = KSI_NETWORK_ERROR, "Unable to wait for the responses.");
+				goto cleanup;
+			}
+		} else {
+			for (i = 0; i < fdCount; i++) events[i] = 0;
+		}
+
+		for (i = 0; i < 2; i++) {
+			RoutedAttempt *a = &rr->attempts[i];
+			int ev = 0;
+			size_t j;
+			int status;
+
+			if (a->handle == NULL) continue;
+
+			for (j = 0; j < fdCount; j++) {
+				if (slots[j] == i) ev = events[j];
+			}
+
+			status = KSI_RequestHandle_perform(a->handle, ev);
+			if (status == KSI_ASYNC_NOT_FINISHED) continue;
+
+			now = KSI_getTimeMs();
+			recordResult(&srv->endpoints[a->endpoint], status == KSI_OK, now - a->started, now);
+
+			if (status == KSI_OK) {
+				res = takeResponse(outer, a->handle);
+				if (res != KSI_OK) {
+					KSI_pushError(outer->ctx, res, NULL);
+				}
+				goto cleanup;
+			}
+
+			KSI_LOG_debug(outer->ctx, "Request to endpoint %u failed.", (unsigned)a->endpoint);
+			res = status;
+			KSI_RequestHandle_free(a->handle);
+			a->handle = NULL;
+		}
+	}
+
+cleanup:
+
+	/* Cancel the request that lost the race. */
+	KSI_RequestHandle_free(rr->attempts[0].handle);
+	rr->attempts[0].handle = NULL;
+	KSI_RequestHandle_free(rr->attempts[1].handle);
+	rr->attempts[1].handle = NULL;
+
+	return res;
+}
+
+/**
+ * Sends the request to the best endpoint of the service. The returned handle drives the
+ * request to the endpoint and fails over to, or hedges with, the other endpoints.
+ */
+static int sendRouted(KSI_UriClient *client, enum serviceMethod_e service, KSI_AggregationReq *aggrReq, KSI_ExtendReq *extReq, KSI_RequestHandle **handle) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_CTX *ctx = client->parent.ctx;
+	KSI_UriService *srv = getService(client, service);
+	RoutedRequest *rr = NULL;
+	KSI_RequestHandle *inner = NULL;
+	KSI_RequestHandle *tmp = NULL;
+	size_t idx = 0;
+	unsigned tried = 0;
+	KSI_uint64_t now = 0;
+
+	rr = KSI_new(RoutedRequest);
+	if (rr == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	memset(rr, 0, sizeof(RoutedRequest));
+	rr->client = client;
+	rr->service = service;
+
+	/* Send the request object directly to the first endpoint accepting it. */
+	for (;;) {
+		KSI_NetworkClient *nc = NULL;
+
+		now = KSI_getTimeMs();
+		idx = selectEndpoint(srv, tried, now);
+		if (idx == KSI_URI_MAX_ENDPOINTS) {
+			KSI_pushError(ctx, res, "Unable to send the request to any of the endpoints.");
+			goto cleanup;
+		}
+
+		tried |= 1u << idx;
+		nc = getEndpointClient(client, service, idx);
+
+		if (service == SRV_AGGREGATE) {
+			res = KSI_NetworkClient_sendSignRequest(nc, aggrReq, &inner);
+		} else {
+			res = KSI_NetworkClient_sendExtendRequest(nc, extReq, &inner);
+		}
+
+		if (res == KSI_OK) break;
+
+		recordResult(&srv->endpoints[idx], 0, 0, now);
+	}
+
+	rr->tried = tried;
+	rr->attempts[0].endpoint = idx;
+	rr->attempts[0].started = now;
+
+	res = KSI_RequestHandle_new(ctx, inner->request, inner->request_length, &tmp);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	tmp->client = inner->client;
+	tmp->readResponse = routedReadResponse;
+	tmp->deadline = inner->deadline;
+
+	rr->attempts[0].handle = inner;
+	inner = NULL;
+
+	res = KSI_RequestHandle_setImplContext(tmp, rr, (void (*)(void *))RoutedRequest_free);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+	rr = NULL;
+
+	*handle = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_RequestHandle_free(inner);
+	KSI_RequestHandle_free(tmp);
+	RoutedRequest_free(rr);
+
+	return res;
+}
+
 static int prepareExtendRequest(KSI_NetworkClient *client, KSI_ExtendReq *req, KSI_RequestHandle **handle) {
 	KSI_UriClient *uriClient = (KSI_UriClient *)client;
+
+	if (uriClient->extenders.count > 1) {
+		return sendRouted(uriClient, SRV_EXTEND, NULL, req, handle);
+	}
+
 	return KSI_NetworkClient_sendExtendRequest(uriClient->pExtendClient, req, handle);
 }
 
 static int prepareAggregationRequest(KSI_NetworkClient *client, KSI_AggregationReq *req, KSI_RequestHandle **handle) {
 	KSI_UriClient *uriClient = (KSI_UriClient *)client;
+
+	if (uriClient->aggregators.count > 1) {
+		return sendRouted(uriClient, SRV_AGGREGATE, req, NULL, handle);
+	}
+
 	return KSI_NetworkClient_sendSignRequest(uriClient->pAggregationClient, req, handle);
 }
 
+static int getPublicationUrl(KSI_NetworkClient *client, const char **url) {
+	return KSI_NetworkClient_getPublicationUrl((KSI_NetworkClient *)((KSI_UriClient *)client)->httpClient, url);
+}
+
 static int sendPublicationRequest(KSI_NetworkClient *client, KSI_RequestHandle **handle) {
 	int res;
 	KSI_UriClient *uriClient = (KSI_UriClient *)client;
@@ -94,6 +655,8 @@ cleanup:
 
 static void uriClient_free(KSI_UriClient *client) {
 	if (client != NULL) {
+		resetService(&client->aggregators);
+		resetService(&client->extenders);
 		KSI_HttpClient_free(client->httpClient);
 		KSI_TcpClient_free(client->tcpClient);
 		KSI_free(client);
@@ -126,9 +689,16 @@ int KSI_UriClient_init(KSI_CTX *ctx, KSI_UriClient *client) {
 	client->pExtendClient = (KSI_NetworkClient *)client->httpClient;
 	client->pAggregationClient = (KSI_NetworkClient *)client->httpClient;
 
+	memset(&client->aggregators, 0, sizeof(client->aggregators));
+	memset(&client->extenders, 0, sizeof(client->extenders));
+	client->hedging = 0;
+	client->connectionTimeout = -1;
+	client->transferTimeout = -1;
+
 	client->parent.sendExtendRequest = prepareExtendRequest;
 	client->parent.sendSignRequest = prepareAggregationRequest;
 	client->parent.sendPublicationRequest = sendPublicationRequest;
+	client->parent.getPublicationUrl = getPublicationUrl;
 	client->parent.implFree = (void (*)(void *))uriClient_free;
 
 	res = KSI_OK;
@@ -159,11 +729,6 @@ cleanup:
 	return res;
 }
 
-enum serviceMethod_e {
-	SRV_EXTEND,
-	SRV_AGGREGATE
-};
-
 int getClientByUriScheme(const char *uri, struct http_parser_url *u, const char **replaceScheme) {
 	int res;
 	int netClient = -1;
@@ -209,6 +774,9 @@ int KSI_UriClient_setExtender(KSI_UriClient *client, const char *uri, const char
 	const char *replace = NULL;
 	int c;
 
+	/* The endpoint replaces all the endpoints added before. */
+	resetService(&client->extenders);
+
 	c = getClientByUriScheme(uri, &u, &replace);
 
 	switch (c) {
@@ -252,6 +820,8 @@ int KSI_UriClient_setExtender(KSI_UriClient *client, const char *uri, const char
 			goto cleanup;
 	}
 
+	client->extenders.count = 1;
+
 	res = KSI_OK;
 
 cleanup:
@@ -266,6 +836,9 @@ int KSI_UriClient_setAggregator(KSI_UriClient *client, const char *uri, const ch
 	const char *replace = NULL;
 	int c;
 
+	/* The endpoint replaces all the endpoints added before. */
+	resetService(&client->aggregators);
+
 	c = getClientByUriScheme(uri, &u, &replace);
 
 	switch (c) {
@@ -309,6 +882,138 @@ int KSI_UriClient_setAggregator(KSI_UriClient *client, const char *uri, const ch
 			goto cleanup;
 	}
 
+	client->aggregators.count = 1;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+/**
+ * Creates a new network client for an additional endpoint of the service.
+ */
+static int newEndpointClient(KSI_UriClient *client, enum serviceMethod_e service, const char *uri, const char *loginId, const char *key, KSI_UriEndpoint *ep) {
+	int res;
+	char addr[0xffff];
+	struct http_parser_url u;
+	const char *replace = NULL;
+	int c;
+	KSI_HttpClient *http = NULL;
+	KSI_TcpClient *tcp = NULL;
+
+	c = getClientByUriScheme(uri, &u, &replace);
+
+	switch (c) {
+		case URI_HTTP:
+			if (replace != NULL) {
+				/* Create a new URL where the scheme is replaced with the correct one. */
+				KSI_snprintf(addr, sizeof(addr), "%s%s", replace, uri + u.field_data[UF_SCHEMA].off + u.field_data[UF_SCHEMA].len);
+			}
+
+			res = KSI_HttpClient_new(client->parent.ctx, &http);
+			if (res != KSI_OK) goto cleanup;
+
+			if (client->connectionTimeout >= 0) {
+				res = KSI_HttpClient_setConnectTimeoutSeconds(http, client->connectionTimeout);
+				if (res != KSI_OK) goto cleanup;
+			}
+
+			if (client->transferTimeout >= 0) {
+				res = KSI_HttpClient_setReadTimeoutSeconds(http, client->transferTimeout);
+				if (res != KSI_OK) goto cleanup;
+			}
+
+			if (service == SRV_AGGREGATE) {
+				res = KSI_HttpClient_setAggregator(http, replace != NULL ? addr : uri, loginId, key);
+			} else {
+				res = KSI_HttpClient_setExtender(http, replace != NULL ? addr : uri, loginId, key);
+			}
+			if (res != KSI_OK) goto cleanup;
+
+			ep->client = (KSI_NetworkClient *)http;
+			http = NULL;
+
+			break;
+		case URI_TCP:
+			if ((u.field_set & (1 << UF_HOST)) == 0 || u.port == 0) {
+				res = KSI_INVALID_ARGUMENT;
+				goto cleanup;
+			}
+
+			res = KSI_TcpClient_new(client->parent.ctx, &tcp);
+			if (res != KSI_OK) goto cleanup;
+
+			if (client->transferTimeout >= 0) {
+				res = KSI_TcpClient_setTransferTimeoutSeconds(tcp, client->transferTimeout);
+				if (res != KSI_OK) goto cleanup;
+			}
+
+			/* Extract the host to a proper null-terminated string. */
+			KSI_snprintf(addr, sizeof(addr), "%.*s", u.field_data[UF_HOST].len, uri + u.field_data[UF_HOST].off);
+
+			if (service == SRV_AGGREGATE) {
+				res = KSI_TcpClient_setAggregator(tcp, addr, u.port, loginId, key);
+			} else {
+				res = KSI_TcpClient_setExtender(tcp, addr, u.port, loginId, key);
+			}
+			if (res != KSI_OK) goto cleanup;
+
+			ep->client = (KSI_NetworkClient *)tcp;
+			tcp = NULL;
+
+			break;
+		default:
+			res = KSI_UNKNOWN_ERROR;
+			goto cleanup;
+	}
+
+	ep->clientType = c;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_HttpClient_free(http);
+	KSI_TcpClient_free(tcp);
+
+	return res;
+}
+
+static int addEndpoint(KSI_UriClient *client, enum serviceMethod_e service, const char *uri, const char *loginId, const char *key) {
+	int res;
+	KSI_UriService *srv = NULL;
+
+	if (client == NULL || uri == NULL || loginId == NULL || key == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	srv = getService(client, service);
+
+	/* The first endpoint is the primary one. */
+	if (srv->count == 0) {
+		if (service == SRV_AGGREGATE) {
+			res = KSI_UriClient_setAggregator(client, uri, loginId, key);
+		} else {
+			res = KSI_UriClient_setExtender(client, uri, loginId, key);
+		}
+		goto cleanup;
+	}
+
+	if (srv->count >= KSI_URI_MAX_ENDPOINTS) {
+		res = KSI_BUFFER_OVERFLOW;
+		goto cleanup;
+	}
+
+	memset(&srv->endpoints[srv->count], 0, sizeof(KSI_UriEndpoint));
+
+	res = newEndpointClient(client, service, uri, loginId, key, &srv->endpoints[srv->count]);
+	if (res != KSI_OK) goto cleanup;
+
+	srv->count++;
+
 	res = KSI_OK;
 
 cleanup:
@@ -316,6 +1021,86 @@ cleanup:
 	return res;
 }
 
+int KSI_UriClient_addAggregator(KSI_UriClient *client, const char *uri, const char *loginId, const char *key) {
+	return addEndpoint(client, SRV_AGGREGATE, uri, loginId, key);
+}
+
+int KSI_UriClient_addExtender(KSI_UriClient *client, const char *uri, const char *loginId, const char *key) {
+	return addEndpoint(client, SRV_EXTEND, uri, loginId, key);
+}
+
+int KSI_UriClient_addAggregatorsFromConfig(KSI_UriClient *client, const KSI_Config *config, const char *loginId, const char *key) {
+	int res;
+	KSI_LIST(KSI_Utf8String) *parentUri = NULL;
+	size_t i;
+
+	if (client == NULL || config == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	res = KSI_Config_getParentUri(config, &parentUri);
+	if (res != KSI_OK) goto cleanup;
+
+	for (i = 0; i < KSI_Utf8StringList_length(parentUri); i++) {
+		KSI_Utf8String *uri = NULL;
+
+		res = KSI_Utf8StringList_elementAt(parentUri, i, &uri);
+		if (res != KSI_OK) goto cleanup;
+
+		if (uri == NULL) continue;
+
+		res = KSI_UriClient_addAggregator(client, KSI_Utf8String_cstr(uri), loginId, key);
+		if (res != KSI_OK) goto cleanup;
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+int KSI_UriClient_setHedging(KSI_UriClient *client, int enable) {
+	if (client == NULL) return KSI_INVALID_ARGUMENT;
+
+	client->hedging = enable != 0;
+
+	return KSI_OK;
+}
+
+/**
+ * Applies the timeout to the clients of the additional endpoints of the service.
+ */
+static int setEndpointTimeouts(KSI_UriService *srv, int connectionTimeout, int transferTimeout) {
+	int res = KSI_OK;
+	size_t i;
+
+	for (i = 0; i < srv->count; i++) {
+		KSI_UriEndpoint *ep = &srv->endpoints[i];
+
+		if (ep->client == NULL) continue;
+
+		if (ep->clientType == URI_HTTP) {
+			if (connectionTimeout >= 0) {
+				res = KSI_HttpClient_setConnectTimeoutSeconds((KSI_HttpClient *)ep->client, connectionTimeout);
+				if (res != KSI_OK) goto cleanup;
+			}
+			if (transferTimeout >= 0) {
+				res = KSI_HttpClient_setReadTimeoutSeconds((KSI_HttpClient *)ep->client, transferTimeout);
+				if (res != KSI_OK) goto cleanup;
+			}
+		} else if (transferTimeout >= 0) {
+			res = KSI_TcpClient_setTransferTimeoutSeconds((KSI_TcpClient *)ep->client, transferTimeout);
+			if (res != KSI_OK) goto cleanup;
+		}
+	}
+
+cleanup:
+
+	return res;
+}
+
 int KSI_UriClient_setConnectionTimeoutSeconds(KSI_UriClient *client, int timeout) {
 	int res;
 
@@ -324,6 +1109,14 @@ int KSI_UriClient_setConnectionTimeoutSeconds(KSI_UriClient *client, int timeout
 		if (res != KSI_OK) goto cleanup;
 	}
 
+	client->connectionTimeout = timeout;
+
+	res = setEndpointTimeouts(&client->aggregators, timeout, -1);
+	if (res != KSI_OK) goto cleanup;
+
+	res = setEndpointTimeouts(&client->extenders, timeout, -1);
+	if (res != KSI_OK) goto cleanup;
+
 	res = KSI_OK;
 
 cleanup:
@@ -343,6 +1136,14 @@ int KSI_UriClient_setTransferTimeoutSeconds(KSI_UriClient *client, int timeout)
 		if (res != KSI_OK) goto cleanup;
 	}
 
+	client->transferTimeout = timeout;
+
+	res = setEndpointTimeouts(&client->aggregators, -1, timeout);
+	if (res != KSI_OK) goto cleanup;
+
+	res = setEndpointTimeouts(&client->extenders, -1, timeout);
+	if (res != KSI_OK) goto cleanup;
+
 	res = KSI_OK;
 
 cleanup:
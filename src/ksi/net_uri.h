@@ -66,6 +66,54 @@ extern "C" {
 	int KSI_UriClient_setExtender(KSI_UriClient *client, const char *uri, const char *loginId, const char *key);
 	int KSI_UriClient_setAggregator(KSI_UriClient *client, const char *uri, const char *loginId, const char *key);
 
+	/**
+	 * Adds an aggregator endpoint. If more than one aggregator endpoint is set, each request
+	 * is sent to the endpoint with the best moving average of the response time and the failure
+	 * rate, and it fails over to the next endpoint if the request fails. An endpoint failing
+	 * several times in a row is kept out of use for a while (circuit breaker). The first added
+	 * endpoint is the same as set with #KSI_UriClient_setAggregator, which removes all the
+	 * endpoints added before.
+	 * \param[in]	client		Pointer to the URI client.
+	 * \param[in]	uri			URI of the aggregator.
+	 * \param[in]	loginId		Login ID for the aggregator.
+	 * \param[in]	key			HMAC key for the aggregator.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_UriClient_addAggregator(KSI_UriClient *client, const char *uri, const char *loginId, const char *key);
+
+	/**
+	 * Adds an extender endpoint. The extender endpoints are used in the same way as the aggregator
+	 * endpoints.
+	 * \param[in]	client		Pointer to the URI client.
+	 * \param[in]	uri			URI of the extender.
+	 * \param[in]	loginId		Login ID for the extender.
+	 * \param[in]	key			HMAC key for the extender.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \see #KSI_UriClient_addAggregator
+	 */
+	int KSI_UriClient_addExtender(KSI_UriClient *client, const char *uri, const char *loginId, const char *key);
+
+	/**
+	 * Adds the parent URIs of the aggregator configuration as aggregator endpoints.
+	 * \param[in]	client		Pointer to the URI client.
+	 * \param[in]	config		Configuration reported by the aggregator.
+	 * \param[in]	loginId		Login ID for the aggregators.
+	 * \param[in]	key			HMAC key for the aggregators.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 * \see #KSI_UriClient_addAggregator
+	 */
+	int KSI_UriClient_addAggregatorsFromConfig(KSI_UriClient *client, const KSI_Config *config, const char *loginId, const char *key);
+
+	/**
+	 * Enables or disables hedged requests. When enabled and the response from the selected endpoint
+	 * takes longer than 95% of its recent responses, the request is also sent to the next best endpoint
+	 * and the first response is used. Hedging is disabled by default.
+	 * \param[in]	client		Pointer to the URI client.
+	 * \param[in]	enable		Non-zero to enable hedged requests.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_UriClient_setHedging(KSI_UriClient *client, int enable);
+
 	int KSI_UriClient_setTransferTimeoutSeconds(KSI_UriClient *client, int timeout);
 	int KSI_UriClient_setConnectionTimeoutSeconds(KSI_UriClient *client, int timeout);
 
@@ -35,6 +35,38 @@ extern "C" {
 		URI_CLIENT_COUNT
 	};
 
+	/** Maximum number of endpoints per service. */
+	#define KSI_URI_MAX_ENDPOINTS 8
+	/** Number of latency samples kept per endpoint for the hedging delay. */
+	#define KSI_URI_LATENCY_SAMPLES 32
+
+	typedef struct KSI_UriEndpoint_st {
+		/** Network client of the endpoint, \c NULL for the primary endpoint, which uses the client selected by the setter. */
+		KSI_NetworkClient *client;
+		/** Type of #client, one of #client_e. */
+		int clientType;
+		/** Exponentially weighted moving average of the response time in milliseconds. */
+		double latencyMs;
+		/** Exponentially weighted moving average of the failure rate. */
+		double errorRate;
+		/** Number of consecutive failures. */
+		unsigned failures;
+		/** Time until the circuit breaker of the endpoint is open, 0 if closed. */
+		KSI_uint64_t openUntil;
+		/** Ring buffer of the most recent response times in milliseconds. */
+		unsigned samples[KSI_URI_LATENCY_SAMPLES];
+		/** Number of values in #samples. */
+		size_t sampleCount;
+		/** Position of the next value in #samples. */
+		size_t samplePos;
+	} KSI_UriEndpoint;
+
+	typedef struct KSI_UriService_st {
+		KSI_UriEndpoint endpoints[KSI_URI_MAX_ENDPOINTS];
+		/** Number of endpoints, 0 or 1 if requests are not routed. */
+		size_t count;
+	} KSI_UriService;
+
 	struct KSI_UriClient_st {
 		KSI_NetworkClient parent;
 
@@ -43,6 +75,19 @@ extern "C" {
 
 		KSI_NetworkClient *pExtendClient;
 		KSI_NetworkClient *pAggregationClient;
+
+		/** Aggregator endpoints for routing. */
+		KSI_UriService aggregators;
+		/** Extender endpoints for routing. */
+		KSI_UriService extenders;
+
+		/** If set, a request is also sent to a second endpoint when the first one is slower than usual. */
+		int hedging;
+
+		/** Connection timeout for additional endpoints, -1 if not set. */
+		int connectionTimeout;
+		/** Transfer timeout for additional endpoints, -1 if not set. */
+		int transferTimeout;
 	};
 
 #ifdef __cplusplus
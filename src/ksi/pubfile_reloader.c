@@ -0,0 +1,454 @@
+/*
+ * Copyright 2013-2015 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#  include <time.h>
+#endif
+
+#include <string.h>
+
+#include "internal.h"
+#include "ctx_impl.h"
+#include "net_impl.h"
+#include "net_http.h"
+#include "pubfile_reloader.h"
+
+#ifdef _WIN32
+	typedef CRITICAL_SECTION ReloaderMutex;
+	typedef CONDITION_VARIABLE ReloaderCond;
+	typedef HANDLE ReloaderThread;
+#else
+	typedef pthread_mutex_t ReloaderMutex;
+	typedef pthread_cond_t ReloaderCond;
+	typedef pthread_t ReloaderThread;
+#endif
+
+struct KSI_PublicationsFileReloader_st {
+	/** Private context of the reloading thread. */
+	KSI_CTX *ctx;
+	/** Time between the revalidations in milliseconds. */
+	KSI_uint64_t ttlMs;
+	/** Validators of the newest file known to the thread, used only by the thread. */
+	char *etag;
+	char *lastModified;
+	/** Validators passed by the owner, taken over by the thread before the next revalidation. */
+	char *ownerEtag;
+	char *ownerLastModified;
+	int hasOwnerValidators;
+	/** Newest received file not yet taken by the owner, \c NULL if there is none. */
+	unsigned char *raw;
+	size_t raw_len;
+	/** Set when the thread must stop. */
+	int stop;
+	/** Set once the thread has been started. */
+	int started;
+	/** Protects all the fields shared by the thread and the owner. */
+	ReloaderMutex lock;
+	/** Signalled when the thread must stop. */
+	ReloaderCond cond;
+	ReloaderThread thread;
+};
+
+static void mutexLock(ReloaderMutex *m) {
+#ifdef _WIN32
+	EnterCriticalSection(m);
+#else
+	pthread_mutex_lock(m);
+#endif
+}
+
+static void mutexUnlock(ReloaderMutex *m) {
+#ifdef _WIN32
+	LeaveCriticalSection(m);
+#else
+	pthread_mutex_unlock(m);
+#endif
+}
+
+/* Waits until signalled or until #deadline (as returned by #KSI_getTimeMs) has passed. */
+static void condWaitUntil(ReloaderCond *c, ReloaderMutex *m, KSI_uint64_t deadline) {
+	KSI_uint64_t now = KSI_getTimeMs();
+
+	if (now >= deadline) return;
+
+#ifdef _WIN32
+	SleepConditionVariableCS(c, m, (DWORD)(deadline - now));
+#else
+	{
+		/* The condition variable waits for the realtime clock. */
+		struct timespec ts;
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec += (time_t)((deadline - now) / 1000);
+		ts.tv_nsec += (long)((deadline - now) % 1000) * 1000000;
+		if (ts.tv_nsec >= 1000000000) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000;
+		}
+		pthread_cond_timedwait(c, m, &ts);
+	}
+#endif
+}
+
+/* Copies the string, a \c NULL string is copied as \c NULL. */
+static int copyString(const char *from, char **to) {
+	if (from == NULL) {
+		*to = NULL;
+		return KSI_OK;
+	}
+	return KSI_strdup(from, to);
+}
+
+int KSI_fetchPublicationsFile(KSI_CTX *ctx, const char *etag, const char *lastModified, unsigned char **raw, size_t *raw_len, char **newEtag, char **newLastModified) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_RequestHandle *handle = NULL;
+	const unsigned char *response = NULL;
+	size_t response_len = 0;
+	unsigned char *tmp = NULL;
+	char *tmpEtag = NULL;
+	char *tmpLastModified = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || raw == NULL || raw_len == NULL || newEtag == NULL || newLastModified == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	/* The validators are picked up by the network provider when the request is created. */
+	ctx->publicationsFileIfNoneMatch = etag;
+	ctx->publicationsFileIfModifiedSince = lastModified;
+
+	res = KSI_sendPublicationRequest(ctx, NULL, 0, &handle);
+
+	ctx->publicationsFileIfNoneMatch = NULL;
+	ctx->publicationsFileIfModifiedSince = NULL;
+
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_RequestHandle_getResponse(handle, &response, &response_len);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	if (!handle->notModified) {
+		if (response == NULL || response_len == 0) {
+			KSI_pushError(ctx, res = KSI_INVALID_FORMAT, "Empty publications file received.");
+			goto cleanup;
+		}
+
+		tmp = KSI_malloc(response_len);
+		if (tmp == NULL) {
+			KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+			goto cleanup;
+		}
+		memcpy(tmp, response, response_len);
+
+		res = copyString(handle->etag, &tmpEtag);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+
+		res = copyString(handle->lastModified, &tmpLastModified);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
+	*raw = tmp;
+	*raw_len = tmp != NULL ? response_len : 0;
+	*newEtag = tmpEtag;
+	*newLastModified = tmpLastModified;
+	tmp = NULL;
+	tmpEtag = NULL;
+	tmpLastModified = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_RequestHandle_free(handle);
+	KSI_free(tmp);
+	KSI_free(tmpEtag);
+	KSI_free(tmpLastModified);
+
+	return res;
+}
+
+/* Revalidates the publications file once per time to live until stopped. */
+static void reloaderRun(KSI_PublicationsFileReloader *reloader) {
+	int res;
+	KSI_uint64_t deadline;
+	unsigned char *raw = NULL;
+	size_t raw_len = 0;
+	char *etag = NULL;
+	char *lastModified = NULL;
+
+	mutexLock(&reloader->lock);
+
+	while (!reloader->stop) {
+		deadline = KSI_getTimeMs() + reloader->ttlMs;
+		while (!reloader->stop && KSI_getTimeMs() < deadline) {
+			condWaitUntil(&reloader->cond, &reloader->lock, deadline);
+		}
+		if (reloader->stop) break;
+
+		if (reloader->hasOwnerValidators) {
+			KSI_free(reloader->etag);
+			KSI_free(reloader->lastModified);
+			reloader->etag = reloader->ownerEtag;
+			reloader->lastModified = reloader->ownerLastModified;
+			reloader->ownerEtag = NULL;
+			reloader->ownerLastModified = NULL;
+			reloader->hasOwnerValidators = 0;
+		}
+
+		/* The owner is not blocked during the download. */
+		mutexUnlock(&reloader->lock);
+
+		res = KSI_fetchPublicationsFile(reloader->ctx, reloader->etag, reloader->lastModified, &raw, &raw_len, &etag, &lastModified);
+
+		mutexLock(&reloader->lock);
+
+		if (res != KSI_OK) {
+			/* The owner keeps using the file it has, the next revalidation tries again. */
+			KSI_LOG_debug(reloader->ctx, "Unable to reload the publications file: %s", KSI_getErrorString(res));
+		} else if (raw != NULL) {
+			KSI_free(reloader->raw);
+			reloader->raw = raw;
+			reloader->raw_len = raw_len;
+			raw = NULL;
+
+			KSI_free(reloader->etag);
+			KSI_free(reloader->lastModified);
+			reloader->etag = etag;
+			reloader->lastModified = lastModified;
+			etag = NULL;
+			lastModified = NULL;
+		}
+	}
+
+	mutexUnlock(&reloader->lock);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI reloaderThread(LPVOID arg) {
+	reloaderRun((KSI_PublicationsFileReloader *)arg);
+	return 0;
+}
+#else
+static void *reloaderThread(void *arg) {
+	reloaderRun((KSI_PublicationsFileReloader *)arg);
+	return NULL;
+}
+#endif
+
+int KSI_PublicationsFileReloader_new(KSI_CTX *ctx, const char *url, KSI_uint64_t ttlMs, KSI_PublicationsFileReloader **reloader) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_PublicationsFileReloader *tmp = NULL;
+	KSI_HttpClient *http = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+	if (ctx == NULL || url == NULL || ttlMs == 0 || reloader == NULL) {
+		KSI_pushError(ctx, res = KSI_INVALID_ARGUMENT, NULL);
+		goto cleanup;
+	}
+
+	tmp = KSI_new(KSI_PublicationsFileReloader);
+	if (tmp == NULL) {
+		KSI_pushError(ctx, res = KSI_OUT_OF_MEMORY, NULL);
+		goto cleanup;
+	}
+
+	tmp->ctx = NULL;
+	tmp->ttlMs = ttlMs;
+	tmp->etag = NULL;
+	tmp->lastModified = NULL;
+	tmp->ownerEtag = NULL;
+	tmp->ownerLastModified = NULL;
+	tmp->hasOwnerValidators = 0;
+	tmp->raw = NULL;
+	tmp->raw_len = 0;
+	tmp->stop = 0;
+	tmp->started = 0;
+
+#ifdef _WIN32
+	InitializeCriticalSection(&tmp->lock);
+	InitializeConditionVariable(&tmp->cond);
+#else
+	pthread_mutex_init(&tmp->lock, NULL);
+	pthread_cond_init(&tmp->cond, NULL);
+#endif
+
+	res = KSI_CTX_new(&tmp->ctx);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, "Unable to create the context of the publications file reloader.");
+		goto cleanup;
+	}
+
+	res = KSI_HttpClient_new(tmp->ctx, &http);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_HttpClient_setPublicationUrl(http, url);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_CTX_setNetworkProvider(tmp->ctx, (KSI_NetworkClient *)http);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+	http = NULL;
+
+#ifdef _WIN32
+	tmp->thread = CreateThread(NULL, 0, reloaderThread, tmp, 0, NULL);
+	if (tmp->thread == NULL) {
+#else
+	if (pthread_create(&tmp->thread, NULL, reloaderThread, tmp) != 0) {
+#endif
+		KSI_pushError(ctx, res = KSI_UNKNOWN_ERROR, "Unable to start the publications file reloader thread.");
+		goto cleanup;
+	}
+	tmp->started = 1;
+
+	*reloader = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_HttpClient_free(http);
+	KSI_PublicationsFileReloader_free(tmp);
+
+	return res;
+}
+
+void KSI_PublicationsFileReloader_free(KSI_PublicationsFileReloader *reloader) {
+	if (reloader != NULL) {
+		if (reloader->started) {
+			mutexLock(&reloader->lock);
+			reloader->stop = 1;
+#ifdef _WIN32
+			WakeAllConditionVariable(&reloader->cond);
+#else
+			pthread_cond_broadcast(&reloader->cond);
+#endif
+			mutexUnlock(&reloader->lock);
+
+			/* A download in progress is limited by the timeouts of the network client. */
+#ifdef _WIN32
+			WaitForSingleObject(reloader->thread, INFINITE);
+			CloseHandle(reloader->thread);
+#else
+			pthread_join(reloader->thread, NULL);
+#endif
+		}
+
+#ifdef _WIN32
+		DeleteCriticalSection(&reloader->lock);
+#else
+		pthread_mutex_destroy(&reloader->lock);
+		pthread_cond_destroy(&reloader->cond);
+#endif
+
+		KSI_CTX_free(reloader->ctx);
+		KSI_free(reloader->etag);
+		KSI_free(reloader->lastModified);
+		KSI_free(reloader->ownerEtag);
+		KSI_free(reloader->ownerLastModified);
+		KSI_free(reloader->raw);
+		KSI_free(reloader);
+	}
+}
+
+int KSI_PublicationsFileReloader_setValidators(KSI_PublicationsFileReloader *reloader, const char *etag, const char *lastModified) {
+	int res = KSI_UNKNOWN_ERROR;
+	char *tmpEtag = NULL;
+	char *tmpLastModified = NULL;
+
+	if (reloader == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	res = copyString(etag, &tmpEtag);
+	if (res != KSI_OK) goto cleanup;
+
+	res = copyString(lastModified, &tmpLastModified);
+	if (res != KSI_OK) goto cleanup;
+
+	mutexLock(&reloader->lock);
+
+	KSI_free(reloader->ownerEtag);
+	KSI_free(reloader->ownerLastModified);
+	reloader->ownerEtag = tmpEtag;
+	reloader->ownerLastModified = tmpLastModified;
+	reloader->hasOwnerValidators = 1;
+
+	mutexUnlock(&reloader->lock);
+
+	tmpEtag = NULL;
+	tmpLastModified = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_free(tmpEtag);
+	KSI_free(tmpLastModified);
+
+	return res;
+}
+
+int KSI_PublicationsFileReloader_take(KSI_PublicationsFileReloader *reloader, unsigned char **raw, size_t *raw_len) {
+	int res = KSI_UNKNOWN_ERROR;
+
+	if (reloader == NULL || raw == NULL || raw_len == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+
+	mutexLock(&reloader->lock);
+
+	*raw = reloader->raw;
+	*raw_len = reloader->raw_len;
+	reloader->raw = NULL;
+	reloader->raw_len = 0;
+
+	mutexUnlock(&reloader->lock);
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2013-2015 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#ifndef PUBFILE_RELOADER_H_
+#define PUBFILE_RELOADER_H_
+
+#include "ksi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/**
+	 * The publications file reloader revalidates the publications file on a background thread
+	 * once its time to live has passed. The thread uses a private context, as the context of
+	 * the owner is not thread-safe, and only passes the raw bytes of a changed file over to
+	 * the owner.
+	 */
+	typedef struct KSI_PublicationsFileReloader_st KSI_PublicationsFileReloader;
+
+	/**
+	 * Constructor for the publications file reloader, starts the reloading thread.
+	 * \param[in]		ctx			KSI context of the owner.
+	 * \param[in]		url			Publications file URL.
+	 * \param[in]		ttlMs		Time between the revalidations in milliseconds.
+	 * \param[out]		reloader	Pointer to the receiving pointer.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_PublicationsFileReloader_new(KSI_CTX *ctx, const char *url, KSI_uint64_t ttlMs, KSI_PublicationsFileReloader **reloader);
+
+	/**
+	 * Stops the reloading thread, waits for it to finish and frees the reloader.
+	 * \param[in]		reloader	The publications file reloader.
+	 */
+	void KSI_PublicationsFileReloader_free(KSI_PublicationsFileReloader *reloader);
+
+	/**
+	 * Passes the validators of a publications file received by the owner itself to the
+	 * reloading thread, so the next revalidation does not download the same file again.
+	 * \param[in]		reloader		The publications file reloader.
+	 * \param[in]		etag			Entity tag of the file, may be \c NULL.
+	 * \param[in]		lastModified	Last modification time of the file, may be \c NULL.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_PublicationsFileReloader_setValidators(KSI_PublicationsFileReloader *reloader, const char *etag, const char *lastModified);
+
+	/**
+	 * Takes the newest publications file received by the reloading thread. Does not wait
+	 * for a download in progress.
+	 * \param[in]		reloader	The publications file reloader.
+	 * \param[out]		raw			Pointer to the receiving pointer, set to \c NULL if no new file
+	 * 								has been received; must be freed by the caller.
+	 * \param[out]		raw_len		Length of the file.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_PublicationsFileReloader_take(KSI_PublicationsFileReloader *reloader, unsigned char **raw, size_t *raw_len);
+
+	/**
+	 * Downloads the publications file with the network provider of the context. If any of the
+	 * validators is given, the request is conditional and an unchanged file is not downloaded.
+	 * \param[in]		ctx				KSI context.
+	 * \param[in]		etag			Entity tag of the file the caller has, may be \c NULL.
+	 * \param[in]		lastModified	Last modification time of the file the caller has, may be \c NULL.
+	 * \param[out]		raw				Pointer to the receiving pointer, set to \c NULL if the file has
+	 * 									not been modified; must be freed by the caller.
+	 * \param[out]		raw_len			Length of the file.
+	 * \param[out]		newEtag			Entity tag of the received file, may be \c NULL.
+	 * \param[out]		newLastModified	Last modification time of the received file, may be \c NULL.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an error code).
+	 */
+	int KSI_fetchPublicationsFile(KSI_CTX *ctx, const char *etag, const char *lastModified, unsigned char **raw, size_t *raw_len, char **newEtag, char **newLastModified);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PUBFILE_RELOADER_H_ */
@@ -1227,6 +1227,184 @@ cleanup:
 	return res;
 }
 
+int KSI_Signature_appendAggregationChain(KSI_Signature *sig, KSI_AggregationHashChain *aggr) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_AggregationHashChain *first = NULL;
+	KSI_DataHash *outputHash = NULL;
+	KSI_LIST(KSI_Integer) *chainIndex = NULL;
+	KSI_Integer *index = NULL;
+	KSI_TLV *chainTlv = NULL;
+	KSI_LIST(KSI_TLV) *nestedList = NULL;
+	KSI_uint64_t shape = 1;
+	size_t i;
+
+	if (sig == NULL || aggr == NULL) {
+		res = KSI_INVALID_ARGUMENT;
+		goto cleanup;
+	}
+	KSI_ERR_clearErrors(sig->ctx);
+
+	if (aggr->inputHash == NULL || aggr->aggrHashId == NULL || aggr->chain == NULL || KSI_HashChainLinkList_length(aggr->chain) == 0) {
+		KSI_pushError(sig->ctx, res = KSI_INVALID_ARGUMENT, "Aggregation chain must have an input hash, a hash algorithm and at least one link.");
+		goto cleanup;
+	}
+
+	/* The chain index value is built from the link directions. */
+	if (KSI_HashChainLinkList_length(aggr->chain) >= 64) {
+		KSI_pushError(sig->ctx, res = KSI_INVALID_ARGUMENT, "Aggregation chain is too long.");
+		goto cleanup;
+	}
+
+	if (sig->baseTlv == NULL) {
+		KSI_pushError(sig->ctx, res = KSI_INVALID_FORMAT, "Signature does not have a TLV representation.");
+		goto cleanup;
+	}
+
+	res = KSI_AggregationHashChainList_elementAt(sig->aggregationChainList, 0, &first);
+	if (res != KSI_OK || first == NULL) {
+		KSI_pushError(sig->ctx, res = KSI_INVALID_SIGNATURE, "Signature does not contain an aggregation hash chain.");
+		goto cleanup;
+	}
+
+	/* The local aggregation starts from level 0. */
+	res = KSI_HashChain_aggregate(sig->ctx, aggr->chain, aggr->inputHash, 0, (int)KSI_Integer_getUInt64(aggr->aggrHashId), NULL, &outputHash);
+	if (res != KSI_OK) {
+		KSI_pushError(sig->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	if (!KSI_DataHash_equals(outputHash, first->inputHash)) {
+		KSI_LOG_logDataHash(sig->ctx, KSI_LOG_DEBUG, "Calculated hash", outputHash);
+		KSI_LOG_logDataHash(sig->ctx, KSI_LOG_DEBUG, "  Expected hash", first->inputHash);
+		KSI_pushError(sig->ctx, res = KSI_VERIFICATION_FAILURE, "Aggregation chain output hash does not match the signature input hash.");
+		goto cleanup;
+	}
+
+	/* The chain index continues the chain index of the first chain of the signature. */
+	res = KSI_IntegerList_new(&chainIndex);
+	if (res != KSI_OK) {
+		KSI_pushError(sig->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	for (i = 0; i < KSI_IntegerList_length(first->chainIndex); i++) {
+		res = KSI_IntegerList_elementAt(first->chainIndex, i, &index);
+		if (res != KSI_OK) {
+			KSI_pushError(sig->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		res = KSI_Integer_new(sig->ctx, KSI_Integer_getUInt64(index), &index);
+		if (res != KSI_OK) {
+			KSI_pushError(sig->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		res = KSI_IntegerList_append(chainIndex, index);
+		if (res != KSI_OK) {
+			KSI_pushError(sig->ctx, res, NULL);
+			goto cleanup;
+		}
+		index = NULL;
+	}
+
+	/* Walk the links from the root to the input hash, a left link is marked by a set bit. */
+	for (i = KSI_HashChainLinkList_length(aggr->chain); i > 0; i--) {
+		KSI_HashChainLink *link = NULL;
+		int isLeft = 0;
+
+		res = KSI_HashChainLinkList_elementAt(aggr->chain, i - 1, &link);
+		if (res != KSI_OK) {
+			KSI_pushError(sig->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		res = KSI_HashChainLink_getIsLeft(link, &isLeft);
+		if (res != KSI_OK) {
+			KSI_pushError(sig->ctx, res, NULL);
+			goto cleanup;
+		}
+
+		shape = (shape << 1) | (isLeft ? 1 : 0);
+	}
+
+	res = KSI_Integer_new(sig->ctx, shape, &index);
+	if (res != KSI_OK) {
+		KSI_pushError(sig->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_IntegerList_append(chainIndex, index);
+	if (res != KSI_OK) {
+		KSI_pushError(sig->ctx, res, NULL);
+		goto cleanup;
+	}
+	index = NULL;
+
+	KSI_IntegerList_free(aggr->chainIndex);
+	aggr->chainIndex = chainIndex;
+	chainIndex = NULL;
+
+	if (aggr->aggregationTime == NULL) {
+		res = KSI_Integer_new(sig->ctx, KSI_Integer_getUInt64(first->aggregationTime), &aggr->aggregationTime);
+		if (res != KSI_OK) {
+			KSI_pushError(sig->ctx, res, NULL);
+			goto cleanup;
+		}
+	} else if (!KSI_Integer_equals(aggr->aggregationTime, first->aggregationTime)) {
+		KSI_pushError(sig->ctx, res = KSI_INVALID_ARGUMENT, "Aggregation chain is from a different aggregation round.");
+		goto cleanup;
+	}
+
+	res = KSI_TLV_new(sig->ctx, KSI_TLV_PAYLOAD_TLV, 0x0801, 0, 0, &chainTlv);
+	if (res != KSI_OK) {
+		KSI_pushError(sig->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_TlvTemplate_construct(sig->ctx, chainTlv, aggr, KSI_TLV_TEMPLATE(KSI_AggregationHashChain));
+	if (res != KSI_OK) {
+		KSI_pushError(sig->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_TLV_getNestedList(sig->baseTlv, &nestedList);
+	if (res != KSI_OK) {
+		KSI_pushError(sig->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	/* The chains are kept in the order of aggregation, starting with the one of the document. */
+	res = KSI_AggregationHashChainList_insertAt(sig->aggregationChainList, 0, aggr);
+	if (res != KSI_OK) {
+		KSI_pushError(sig->ctx, res, NULL);
+		goto cleanup;
+	}
+
+	res = KSI_TLVList_insertAt(nestedList, 0, chainTlv);
+	if (res != KSI_OK) {
+		/* Give the ownership of the chain back to the caller. */
+		KSI_AggregationHashChainList_remove(sig->aggregationChainList, 0, &aggr);
+		KSI_pushError(sig->ctx, res, NULL);
+		goto cleanup;
+	}
+	chainTlv = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_nofree(first);
+	KSI_nofree(nestedList);
+
+	KSI_TLV_free(chainTlv);
+	KSI_Integer_free(index);
+	KSI_IntegerList_free(chainIndex);
+	KSI_DataHash_free(outputHash);
+
+	return res;
+}
+
 static int parseAggregationResponse(KSI_CTX *ctx, KSI_AggregationResp *resp, KSI_Signature **signature) {
 	int res;
 	KSI_TLV *tmpTlv = NULL;
@@ -1407,6 +1585,7 @@ int KSI_Signature_createAggregated(KSI_CTX *ctx, KSI_DataHash *rootHash, KSI_uin
 	KSI_RequestHandle *handle = NULL;
 	KSI_AggregationResp *response = NULL;
 	KSI_Signature *sign = NULL;
+	KSI_Config *config = NULL;
 
 	KSI_AggregationReq *req = NULL;
 
@@ -1439,6 +1618,19 @@ int KSI_Signature_createAggregated(KSI_CTX *ctx, KSI_DataHash *rootHash, KSI_uin
 		goto cleanup;
 	}
 
+	/* Keep the configuration reported by the aggregator. */
+	res = KSI_AggregationResp_getConfig(response, &config);
+	if (res != KSI_OK) {
+		KSI_pushError(ctx, res, NULL);
+		goto cleanup;
+	}
+
+	if (config != NULL) {
+		KSI_AggregationResp_setConfig(response, NULL);
+		KSI_Config_free(ctx->aggrConfig);
+		ctx->aggrConfig = config;
+	}
+
 	res = parseAggregationResponse(ctx, response, &sign);
 	if (res != KSI_OK) {
 		KSI_pushError(ctx, res, NULL);
@@ -1472,6 +1664,7 @@ int KSI_Signature_extendTo(const KSI_Signature *sig, KSI_CTX *ctx, KSI_Integer *
 	KSI_ExtendResp *resp = NULL;
 	KSI_CalendarHashChain *calHashChain = NULL;
 	KSI_Signature *tmp = NULL;
+	int cached = 0;
 
 
 	KSI_ERR_clearErrors(ctx);
@@ -1494,39 +1687,51 @@ int KSI_Signature_extendTo(const KSI_Signature *sig, KSI_CTX *ctx, KSI_Integer *
 		goto cleanup;
 	}
 
-	/* Create request. */
-	res = createExtendRequest(ctx, signTime, to, &req);
-	if (res != KSI_OK) {
-		KSI_pushError(ctx, res, NULL);
-		goto cleanup;
+	/* The chain to a given publication is the same for every signature of the aggregation round. */
+	if (to != NULL && KSI_isCalendarCacheEnabled(ctx)) {
+		res = KSI_getCachedCalendarChain(ctx, signTime, to, &calHashChain);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+		cached = calHashChain != NULL;
 	}
 
-	/* Send the actual request. */
-	res = KSI_sendExtendRequest(ctx, req, &handle);
-	if (res != KSI_OK) {
-		KSI_pushError(ctx, res, NULL);
-		goto cleanup;
-	}
+	if (calHashChain == NULL) {
+		/* Create request. */
+		res = createExtendRequest(ctx, signTime, to, &req);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
 
-	/* Get and parse the response. */
-	res = KSI_RequestHandle_getExtendResponse(handle, &resp);
-	if (res != KSI_OK) {
-		KSI_pushError(ctx, res, NULL);
-		goto cleanup;
-	}
+		/* Send the actual request. */
+		res = KSI_sendExtendRequest(ctx, req, &handle);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
 
-	/* Verify the correctness of the response. */
-	res = KSI_ExtendResp_verifyWithRequest(resp, req);
-	if (res != KSI_OK) {
-		KSI_pushError(ctx, res, NULL);
-		goto cleanup;
-	}
+		/* Get and parse the response. */
+		res = KSI_RequestHandle_getExtendResponse(handle, &resp);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
 
-	/* Extract the calendar hash chain */
-	KSI_ExtendResp_getCalendarHashChain(resp, &calHashChain);
+		/* Verify the correctness of the response. */
+		res = KSI_ExtendResp_verifyWithRequest(resp, req);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
 
-	/* Remove the chain from the structure, as it will be freed when this function finishes. */
-	KSI_ExtendResp_setCalendarHashChain(resp, NULL);
+		/* Extract the calendar hash chain */
+		KSI_ExtendResp_getCalendarHashChain(resp, &calHashChain);
+
+		/* Remove the chain from the structure, as it will be freed when this function finishes. */
+		KSI_ExtendResp_setCalendarHashChain(resp, NULL);
+	}
 
 	/* Add the hash chain to the signature. */
 	res = KSI_Signature_replaceCalendarChain(tmp, calHashChain);
@@ -1534,6 +1739,7 @@ int KSI_Signature_extendTo(const KSI_Signature *sig, KSI_CTX *ctx, KSI_Integer *
 		KSI_pushError(ctx, res, NULL);
 		goto cleanup;
 	}
+	calHashChain = NULL;
 
 	/* Remove calendar auth record and publication. */
 	res = removeCalAuthAndPublication(tmp);
@@ -1549,6 +1755,15 @@ int KSI_Signature_extendTo(const KSI_Signature *sig, KSI_CTX *ctx, KSI_Integer *
 		goto cleanup;
 	}
 
+	/* Only the verified chains are cached. */
+	if (to != NULL && !cached && KSI_isCalendarCacheEnabled(ctx)) {
+		res = KSI_cacheCalendarChain(ctx, tmp->calendarChain);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
+	}
+
 	*extended = tmp;
 	tmp = NULL;
 
@@ -1559,6 +1774,7 @@ cleanup:
 	KSI_ExtendReq_free(req);
 	KSI_ExtendResp_free(resp);
 	KSI_RequestHandle_free(handle);
+	KSI_CalendarHashChain_free(calHashChain);
 	KSI_Signature_free(tmp);
 
 	return res;
@@ -2693,6 +2909,7 @@ static int verifyOnline(KSI_CTX *ctx, KSI_Signature *sig) {
 	KSI_DataHash *pubHash = NULL;
 	KSI_VerificationStep step = KSI_VERIFY_CALCHAIN_ONLINE;
 	KSI_VerificationResult *info = &sig->verificationResult;
+	int cached = 0;
 
 	KSI_LOG_info(sig->ctx, "Verifying signature online.");
 
@@ -2708,41 +2925,54 @@ static int verifyOnline(KSI_CTX *ctx, KSI_Signature *sig) {
 		res = KSI_PublicationData_getTime(sig->verificationResult.userPublication, &end);
 		if (res != KSI_OK) goto cleanup;
 	}
-	res = createExtendRequest(sig->ctx, start, end, &req);
-	if (res != KSI_OK) goto cleanup;
-
-	res = KSI_sendExtendRequest(ctx, req, &handle);
-	if (res != KSI_OK) goto cleanup;
+	/* A chain to the same publication time has possibly been received for another signature. */
+	if (end != NULL && KSI_isCalendarCacheEnabled(ctx)) {
+		res = KSI_getCachedCalendarChain(ctx, start, end, &calChain);
+		if (res != KSI_OK) goto cleanup;
+		cached = calChain != NULL;
+	}
 
-	res = KSI_RequestHandle_getExtendResponse(handle, &resp);
-	if (res != KSI_OK) goto cleanup;
+	if (calChain == NULL) {
+		res = createExtendRequest(sig->ctx, start, end, &req);
+		if (res != KSI_OK) goto cleanup;
 
-	/* Verify the correctness of the response. */
-	res = KSI_ExtendResp_verifyWithRequest(resp, req);
-	if (res != KSI_OK) {
-		KSI_pushError(ctx, res, NULL);
-		goto cleanup;
-	}
+		res = KSI_sendExtendRequest(ctx, req, &handle);
+		if (res != KSI_OK) goto cleanup;
 
-	res = KSI_ExtendResp_getStatus(resp, &status);
-	if (res != KSI_OK) goto cleanup;
+		res = KSI_RequestHandle_getExtendResponse(handle, &resp);
+		if (res != KSI_OK) goto cleanup;
 
-	/* Verify status. */
-	if (status != NULL && !KSI_Integer_equalsUInt(status, 0)) {
-		KSI_Utf8String *respErr = NULL;
-		char errm[1024];
+		/* Verify the correctness of the response. */
+		res = KSI_ExtendResp_verifyWithRequest(resp, req);
+		if (res != KSI_OK) {
+			KSI_pushError(ctx, res, NULL);
+			goto cleanup;
+		}
 
-		res = KSI_ExtendResp_getErrorMsg(resp, &respErr);
+		res = KSI_ExtendResp_getStatus(resp, &status);
 		if (res != KSI_OK) goto cleanup;
 
-		KSI_snprintf(errm, sizeof(errm), "Extend failure from server: '%s'", KSI_Utf8String_cstr(respErr));
+		/* Verify status. */
+		if (status != NULL && !KSI_Integer_equalsUInt(status, 0)) {
+			KSI_Utf8String *respErr = NULL;
+			char errm[1024];
 
-		res = KSI_VerificationResult_addFailure(info, step, errm);
-		goto cleanup;
-	}
+			res = KSI_ExtendResp_getErrorMsg(resp, &respErr);
+			if (res != KSI_OK) goto cleanup;
 
-	res = KSI_ExtendResp_getCalendarHashChain(resp, &calChain);
-	if (res != KSI_OK) goto cleanup;
+			KSI_snprintf(errm, sizeof(errm), "Extend failure from server: '%s'", KSI_Utf8String_cstr(respErr));
+
+			res = KSI_VerificationResult_addFailure(info, step, errm);
+			goto cleanup;
+		}
+
+		res = KSI_ExtendResp_getCalendarHashChain(resp, &calChain);
+		if (res != KSI_OK) goto cleanup;
+
+		/* Keep a reference of its own, as the cached chain is not owned by a response. */
+		res = KSI_CalendarHashChain_ref(calChain);
+		if (res != KSI_OK) goto cleanup;
+	}
 
 	res = KSI_CalendarHashChain_getInputHash(calChain, &extHash);
 	if (res != KSI_OK) goto cleanup;
@@ -2759,6 +2989,9 @@ static int verifyOnline(KSI_CTX *ctx, KSI_Signature *sig) {
 		res = KSI_CalendarHashChain_aggregate(calChain, &rootHash);
 		if (res != KSI_OK) goto cleanup;
 
+		res = KSI_PublicationData_getImprint(sig->verificationResult.userPublication, &pubHash);
+		if (res != KSI_OK) goto cleanup;
+
 		if (!KSI_DataHash_equals(rootHash, pubHash)) {
 			res = KSI_VerificationResult_addFailure(info, step, "External publication imprint mismatch.");
 			goto cleanup;
@@ -2766,10 +2999,19 @@ static int verifyOnline(KSI_CTX *ctx, KSI_Signature *sig) {
 	}
 
 	res = KSI_VerificationResult_addSuccess(info, step, "Verified online.");
+	if (res != KSI_OK) goto cleanup;
+
+	/* Only the chains to a given publication time are cached, as the head of the calendar keeps moving. */
+	if (end != NULL && !cached && KSI_isCalendarCacheEnabled(ctx)) {
+		res = KSI_cacheCalendarChain(ctx, calChain);
+		if (res != KSI_OK) goto cleanup;
+	}
 
 cleanup:
 
 	KSI_Integer_free(start);
+	KSI_CalendarHashChain_free(calChain);
+	KSI_DataHash_free(rootHash);
 	KSI_ExtendReq_free(req);
 	KSI_RequestHandle_free(handle);
 	KSI_ExtendResp_free(resp);
@@ -355,6 +355,20 @@ extern "C" {
 	 */
 	int KSI_Signature_replacePublicationRecord(KSI_Signature *sig, KSI_PublicationRecord *pubRec);
 
+	/**
+	 * Prepends a locally computed aggregation hash chain to the signature, so the signature
+	 * will sign the input hash of the given chain. The output of the chain, aggregated starting
+	 * from level 0, must match the input hash of the signature. The chain index and missing
+	 * aggregation time of \c aggr are filled in by this function.
+	 * \param[in]	sig		KSI signature.
+	 * \param[in]	aggr	Local aggregation hash chain.
+	 * \return status code (#KSI_OK, when operation succeeded, otherwise an
+	 * error code).
+	 * \note After a successful call, the aggregation chain belongs to the signature
+	 * and will be freed by #KSI_Signature_free.
+	 */
+	int KSI_Signature_appendAggregationChain(KSI_Signature *sig, KSI_AggregationHashChain *aggr);
+
 	void KSI_AggregationHashChain_free(KSI_AggregationHashChain *aggr);
 	int KSI_AggregationHashChain_new(KSI_CTX *ctx, KSI_AggregationHashChain **out);
 
@@ -155,6 +155,7 @@ static CuSuite* initSuite(void) {
 	addSuite(suite, KSITest_compatibility_getSuite);
 	addSuite(suite, KSITest_uriClient_getSuite);
 	addSuite(suite, KSITest_multiSignature_getSuite);
+	addSuite(suite, KSITest_BlockSigner_getSuite);
 
 	return suite;
 }
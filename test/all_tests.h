@@ -57,6 +57,7 @@ CuSuite* KSITest_HMAC_getSuite(void);
 CuSuite* KSITest_compatibility_getSuite(void);
 CuSuite* KSITest_uriClient_getSuite(void);
 CuSuite* KSITest_multiSignature_getSuite(void);
+CuSuite* KSITest_BlockSigner_getSuite(void);
 
 #ifdef __cplusplus
 }
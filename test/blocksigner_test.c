@@ -0,0 +1,338 @@
+/*
+ * Copyright 2013-2015 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <ksi/blocksigner.h>
+#include "all_tests.h"
+#include "../src/ksi/ctx_impl.h"
+
+extern KSI_CTX *ctx;
+extern unsigned char *KSI_NET_MOCK_response;
+extern unsigned KSI_NET_MOCK_response_len;
+
+#define TEST_AGGR_RESPONSE_FILE "resource/tlv/ok-sig-2014-07-01.1-aggr_response.tlv"
+#define TEST_SIGNATURE_FILE "resource/tlv/ok-sig-2014-07-01.1.ksig"
+
+static unsigned char mockImprint[] ={
+		0x01, 0x11, 0xa7, 0x00, 0xb0, 0xc8, 0x06, 0x6c, 0x47, 0xec, 0xba, 0x05, 0xed, 0x37, 0xbc, 0x14, 0xdc,
+		0xad, 0xb2, 0x38, 0x55, 0x2d, 0x86, 0xc6, 0x59, 0x34, 0x2d, 0x1d, 0x7e, 0x87, 0xb8, 0x77, 0x2d};
+
+static void preTest(void) {
+	KSI_NetworkClient *pr = NULL;
+
+	ctx->requestCounter = 0;
+
+	if (KSI_NET_MOCK_new(ctx, &pr) == KSI_OK) {
+		KSI_CTX_setNetworkProvider(ctx, pr);
+	}
+}
+
+static void testSingleHash(CuTest* tc) {
+	int res;
+	KSI_BlockSigner *bs = NULL;
+	KSI_BlockSignerHandle *h = NULL;
+	KSI_DataHash *hsh = NULL;
+	KSI_Signature *sig = NULL;
+	unsigned char *raw = NULL;
+	size_t raw_len = 0;
+	unsigned char expected[0x1ffff];
+	size_t expected_len = 0;
+	FILE *f = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+
+	res = KSI_DataHash_fromImprint(ctx, mockImprint, sizeof(mockImprint), &hsh);
+	CuAssert(tc, "Unable to create data hash object from raw imprint", res == KSI_OK && hsh != NULL);
+
+	res = KSI_BlockSigner_new(ctx, KSI_HASHALG_SHA2_256, &bs);
+	CuAssert(tc, "Unable to create block signer.", res == KSI_OK && bs != NULL);
+
+	res = KSI_BlockSigner_add(bs, hsh, &h);
+	CuAssert(tc, "Unable to add hash to the block signer.", res == KSI_OK && h != NULL);
+
+	KSITest_setFileMockResponse(tc, getFullResourcePath(TEST_AGGR_RESPONSE_FILE));
+
+	res = KSI_BlockSigner_close(bs);
+	CuAssert(tc, "Unable to sign the block.", res == KSI_OK);
+
+	res = KSI_BlockSignerHandle_getSignature(h, &sig);
+	CuAssert(tc, "Unable to get the signature of the hash.", res == KSI_OK && sig != NULL);
+
+	/* A block of a single hash value is signed as the hash value itself. */
+	res = KSI_Signature_serialize(sig, &raw, &raw_len);
+	CuAssert(tc, "Unable to serialize signature.", res == KSI_OK && raw != NULL && raw_len > 0);
+
+	f = fopen(getFullResourcePath(TEST_SIGNATURE_FILE), "rb");
+	CuAssert(tc, "Unable to load sample signature.", f != NULL);
+
+	expected_len = (unsigned)fread(expected, 1, sizeof(expected), f);
+	CuAssert(tc, "Failed to read sample", expected_len > 0);
+
+	CuAssert(tc, "Serialized signature length mismatch", expected_len == raw_len);
+	CuAssert(tc, "Serialized signature content mismatch.", !memcmp(expected, raw, raw_len));
+
+	if (f != NULL) fclose(f);
+	KSI_free(raw);
+	KSI_Signature_free(sig);
+	KSI_DataHash_free(hsh);
+	KSI_BlockSigner_free(bs);
+}
+
+static KSI_DataHash *joinHashes(CuTest *tc, KSI_DataHash *left, KSI_DataHash *right, unsigned char level) {
+	int res;
+	KSI_DataHasher *hsr = NULL;
+	KSI_DataHash *hsh = NULL;
+	const unsigned char *imprint = NULL;
+	size_t imprint_len = 0;
+
+	res = KSI_DataHasher_open(ctx, KSI_HASHALG_SHA2_256, &hsr);
+	CuAssert(tc, "Unable to open hasher.", res == KSI_OK && hsr != NULL);
+
+	KSI_DataHash_getImprint(left, &imprint, &imprint_len);
+	KSI_DataHasher_add(hsr, imprint, imprint_len);
+	KSI_DataHash_getImprint(right, &imprint, &imprint_len);
+	KSI_DataHasher_add(hsr, imprint, imprint_len);
+	KSI_DataHasher_add(hsr, &level, 1);
+
+	res = KSI_DataHasher_close(hsr, &hsh);
+	CuAssert(tc, "Unable to close hasher.", res == KSI_OK && hsh != NULL);
+
+	KSI_DataHasher_free(hsr);
+
+	return hsh;
+}
+
+/**
+ * Prepares a mock aggregation response, where the first aggregation chain starts with the given hash.
+ */
+static void setBlockMockResponse(CuTest *tc, KSI_DataHash *root) {
+	int res;
+	unsigned char buf[0xffff];
+	size_t buf_len;
+	unsigned char *raw = NULL;
+	size_t raw_len = 0;
+	KSI_AggregationPdu *pdu = NULL;
+	KSI_AggregationResp *resp = NULL;
+	KSI_LIST(KSI_AggregationHashChain) *chains = NULL;
+	KSI_AggregationHashChain *first = NULL;
+	KSI_DataHash *oldHash = NULL;
+	KSI_DataHash *ref = NULL;
+	size_t i;
+	FILE *f = NULL;
+
+	f = fopen(getFullResourcePath(TEST_AGGR_RESPONSE_FILE), "rb");
+	CuAssert(tc, "Unable to open sample response file.", f != NULL);
+
+	buf_len = fread(buf, 1, sizeof(buf), f);
+	fclose(f);
+
+	res = KSI_AggregationPdu_parse(ctx, buf, buf_len, &pdu);
+	CuAssert(tc, "Unable to parse sample response.", res == KSI_OK && pdu != NULL);
+
+	res = KSI_AggregationPdu_getResponse(pdu, &resp);
+	CuAssert(tc, "Unable to get aggregation response.", res == KSI_OK && resp != NULL);
+
+	res = KSI_AggregationResp_getAggregationChainList(resp, &chains);
+	CuAssert(tc, "Unable to get aggregation chains.", res == KSI_OK && chains != NULL);
+
+	/* The chain with the longest chain index is the first one. */
+	for (i = 0; i < KSI_AggregationHashChainList_length(chains); i++) {
+		KSI_AggregationHashChain *chain = NULL;
+		KSI_LIST(KSI_Integer) *chainIndex = NULL;
+		KSI_LIST(KSI_Integer) *firstIndex = NULL;
+
+		KSI_AggregationHashChainList_elementAt(chains, i, &chain);
+		KSI_AggregationHashChain_getChainIndex(chain, &chainIndex);
+		if (first != NULL) KSI_AggregationHashChain_getChainIndex(first, &firstIndex);
+
+		if (first == NULL || KSI_IntegerList_length(chainIndex) > KSI_IntegerList_length(firstIndex)) {
+			first = chain;
+		}
+	}
+	CuAssert(tc, "Sample response has no aggregation chains.", first != NULL);
+
+	KSI_AggregationHashChain_getInputHash(first, &oldHash);
+	KSI_DataHash_clone(root, &ref);
+	KSI_AggregationHashChain_setInputHash(first, ref);
+	KSI_DataHash_free(oldHash);
+
+	/* Reparse the modified response, as the HMAC is calculated over the raw value of the response. */
+	res = KSI_AggregationPdu_serialize(pdu, &raw, &raw_len);
+	CuAssert(tc, "Unable to serialize response.", res == KSI_OK && raw != NULL);
+
+	KSI_AggregationPdu_free(pdu);
+	pdu = NULL;
+
+	res = KSI_AggregationPdu_parse(ctx, raw, raw_len, &pdu);
+	CuAssert(tc, "Unable to parse modified response.", res == KSI_OK && pdu != NULL);
+
+	KSI_free(raw);
+	raw = NULL;
+
+	res = KSI_AggregationPdu_updateHmac(pdu, KSI_HASHALG_SHA2_256, "anon");
+	CuAssert(tc, "Unable to update response HMAC.", res == KSI_OK);
+
+	res = KSI_AggregationPdu_serialize(pdu, &raw, &raw_len);
+	CuAssert(tc, "Unable to serialize response.", res == KSI_OK && raw != NULL);
+
+	memcpy(KSI_NET_MOCK_response, raw, raw_len);
+	KSI_NET_MOCK_response_len = (unsigned)raw_len;
+
+	KSI_free(raw);
+	KSI_AggregationPdu_free(pdu);
+}
+
+static void testMultipleHashes(CuTest* tc) {
+	int res;
+	KSI_BlockSigner *bs = NULL;
+	KSI_BlockSignerHandle *h[5];
+	KSI_DataHash *hsh[5];
+	KSI_DataHash *n01 = NULL;
+	KSI_DataHash *n23 = NULL;
+	KSI_DataHash *n0123 = NULL;
+	KSI_DataHash *root = NULL;
+	KSI_Signature *sig = NULL;
+	KSI_Signature *parsed = NULL;
+	KSI_DataHash *docHash = NULL;
+	unsigned char *raw = NULL;
+	size_t raw_len = 0;
+	unsigned char i;
+
+	KSI_ERR_clearErrors(ctx);
+
+	res = KSI_BlockSigner_new(ctx, KSI_HASHALG_SHA2_256, &bs);
+	CuAssert(tc, "Unable to create block signer.", res == KSI_OK && bs != NULL);
+
+	for (i = 0; i < 5; i++) {
+		res = KSI_DataHash_create(ctx, &i, 1, KSI_HASHALG_SHA2_256, &hsh[i]);
+		CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hsh[i] != NULL);
+
+		res = KSI_BlockSigner_add(bs, hsh[i], &h[i]);
+		CuAssert(tc, "Unable to add hash to the block signer.", res == KSI_OK && h[i] != NULL);
+	}
+
+	/* The expected shape of the tree is (((0, 1), (2, 3)), 4). */
+	n01 = joinHashes(tc, hsh[0], hsh[1], 1);
+	n23 = joinHashes(tc, hsh[2], hsh[3], 1);
+	n0123 = joinHashes(tc, n01, n23, 2);
+	root = joinHashes(tc, n0123, hsh[4], 3);
+
+	setBlockMockResponse(tc, root);
+
+	res = KSI_BlockSigner_close(bs);
+	CuAssert(tc, "Unable to sign the block.", res == KSI_OK);
+
+	for (i = 0; i < 5; i++) {
+		res = KSI_BlockSignerHandle_getSignature(h[i], &sig);
+		CuAssert(tc, "Unable to get the signature of the hash.", res == KSI_OK && sig != NULL);
+
+		res = KSI_Signature_serialize(sig, &raw, &raw_len);
+		CuAssert(tc, "Unable to serialize signature.", res == KSI_OK && raw != NULL && raw_len > 0);
+
+		res = KSI_Signature_parse(ctx, raw, raw_len, &parsed);
+		CuAssert(tc, "Unable to parse the serialized signature.", res == KSI_OK && parsed != NULL);
+
+		res = KSI_Signature_getDocumentHash(parsed, &docHash);
+		CuAssert(tc, "Signature does not sign the hash value.", res == KSI_OK && KSI_DataHash_equals(docHash, hsh[i]));
+
+		KSI_free(raw);
+		raw = NULL;
+		KSI_Signature_free(parsed);
+		parsed = NULL;
+		KSI_Signature_free(sig);
+		sig = NULL;
+	}
+
+	for (i = 0; i < 5; i++) {
+		KSI_DataHash_free(hsh[i]);
+	}
+	KSI_DataHash_free(n01);
+	KSI_DataHash_free(n23);
+	KSI_DataHash_free(n0123);
+	KSI_DataHash_free(root);
+	KSI_BlockSigner_free(bs);
+}
+
+static void testRootMismatch(CuTest* tc) {
+	int res;
+	KSI_BlockSigner *bs = NULL;
+	KSI_BlockSignerHandle *h = NULL;
+	KSI_DataHash *hsh = NULL;
+	KSI_Signature *sig = NULL;
+	unsigned char i;
+
+	KSI_ERR_clearErrors(ctx);
+
+	res = KSI_BlockSigner_new(ctx, KSI_HASHALG_SHA2_256, &bs);
+	CuAssert(tc, "Unable to create block signer.", res == KSI_OK && bs != NULL);
+
+	for (i = 0; i < 5; i++) {
+		res = KSI_DataHash_create(ctx, &i, 1, KSI_HASHALG_SHA2_256, &hsh);
+		CuAssert(tc, "Unable to create data hash.", res == KSI_OK && hsh != NULL);
+
+		res = KSI_BlockSigner_add(bs, hsh, &h);
+		CuAssert(tc, "Unable to add hash to the block signer.", res == KSI_OK && h != NULL);
+
+		KSI_DataHash_free(hsh);
+		hsh = NULL;
+	}
+
+	CuAssert(tc, "Unexpected number of hash values in the block.", KSI_BlockSigner_getCount(bs) == 5);
+
+	res = KSI_BlockSignerHandle_getSignature(h, &sig);
+	CuAssert(tc, "Signature must not be available before signing the block.", res != KSI_OK && sig == NULL);
+
+	KSITest_setFileMockResponse(tc, getFullResourcePath(TEST_AGGR_RESPONSE_FILE));
+
+	res = KSI_BlockSigner_close(bs);
+	CuAssert(tc, "Unable to sign the block.", res == KSI_OK);
+
+	res = KSI_DataHash_fromImprint(ctx, mockImprint, sizeof(mockImprint), &hsh);
+	CuAssert(tc, "Unable to create data hash object from raw imprint", res == KSI_OK && hsh != NULL);
+
+	res = KSI_BlockSigner_add(bs, hsh, NULL);
+	CuAssert(tc, "Adding to a closed block must fail.", res != KSI_OK);
+
+	/* The response does not sign the root of this block. */
+	res = KSI_BlockSignerHandle_getSignature(h, &sig);
+	CuAssert(tc, "Signature of a different root must not be accepted.", res == KSI_VERIFICATION_FAILURE && sig == NULL);
+
+	res = KSI_BlockSigner_reset(bs);
+	CuAssert(tc, "Unable to reset the block signer.", res == KSI_OK && KSI_BlockSigner_getCount(bs) == 0);
+
+	res = KSI_BlockSigner_close(bs);
+	CuAssert(tc, "Signing an empty block must fail.", res != KSI_OK);
+
+	KSI_DataHash_free(hsh);
+	KSI_BlockSigner_free(bs);
+}
+
+CuSuite* KSITest_BlockSigner_getSuite(void) {
+	CuSuite* suite = CuSuiteNew();
+
+	suite->preTest = preTest;
+
+	SUITE_ADD_TEST(suite, testSingleHash);
+	SUITE_ADD_TEST(suite, testMultipleHashes);
+	SUITE_ADD_TEST(suite, testRootMismatch);
+
+	return suite;
+}
@@ -26,8 +26,15 @@
 #include "../src/ksi/net_http_impl.h"
 #include "../src/ksi/net_uri_impl.h"
 #include "../src/ksi/net_tcp_impl.h"
+#include "../src/ksi/net_impl.h"
+#include "../src/ksi/net_resolver.h"
 #include "ksi/net_uri.h"
 
+#ifndef _WIN32
+#  include <unistd.h>
+#  include <netinet/in.h>
+#endif
+
 extern KSI_CTX *ctx;
 
 #define TEST_SIGNATURE_FILE "resource/tlv/ok-sig-2014-04-30.1.ksig"
@@ -87,6 +94,58 @@ static void testSigning(CuTest* tc) {
 	KSI_Signature_free(sig);
 }
 
+static void testSigningCoalesced(CuTest* tc) {
+	int res;
+	KSI_DataHash *hsh = NULL;
+	KSI_Signature *sig = NULL;
+	KSI_NetworkClient *pr = NULL;
+	unsigned char *raw = NULL;
+	size_t raw_len = 0;
+	unsigned char expected[0x1ffff];
+	size_t expected_len = 0;
+	FILE *f = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+
+	res = KSI_NET_MOCK_new(ctx, &pr);
+	CuAssert(tc, "Unable to create mock network provider.", res == KSI_OK);
+
+	res = KSI_CTX_setNetworkProvider(ctx, pr);
+	CuAssert(tc, "Unable to set network provider.", res == KSI_OK);
+
+	res = KSI_CTX_setSignCoalescing(ctx, 10, 16);
+	CuAssert(tc, "Unable to enable sign coalescing.", res == KSI_OK);
+
+	res = KSI_DataHash_fromImprint(ctx, mockImprint, sizeof(mockImprint), &hsh);
+	CuAssert(tc, "Unable to create data hash object from raw imprint", res == KSI_OK && hsh != NULL);
+
+	KSITest_setFileMockResponse(tc, getFullResourcePath("resource/tlv/ok-sig-2014-07-01.1-aggr_response.tlv"));
+
+	/* A batch of a single hash value must result in the same signature as signing it directly. */
+	res = KSI_createSignature(ctx, hsh, &sig);
+
+	KSI_CTX_setSignCoalescing(ctx, 0, 0);
+
+	CuAssert(tc, "Unable to sign the hash", res == KSI_OK && sig != NULL);
+
+	res = KSI_Signature_serialize(sig, &raw, &raw_len);
+	CuAssert(tc, "Unable to serialize signature.", res == KSI_OK && raw != NULL && raw_len > 0);
+
+	f = fopen(getFullResourcePath("resource/tlv/ok-sig-2014-07-01.1.ksig"), "rb");
+	CuAssert(tc, "Unable to load sample signature.", f != NULL);
+
+	expected_len = (unsigned)fread(expected, 1, sizeof(expected), f);
+	CuAssert(tc, "Failed to read sample", expected_len > 0);
+
+	CuAssert(tc, "Serialized signature length mismatch", expected_len == raw_len);
+	CuAssert(tc, "Serialized signature content mismatch.", !memcmp(expected, raw, raw_len));
+
+	if (f != NULL) fclose(f);
+	KSI_free(raw);
+	KSI_DataHash_free(hsh);
+	KSI_Signature_free(sig);
+}
+
 static void testAggreAuthFailure(CuTest* tc) {
 	int res;
 	KSI_DataHash *hsh = NULL;
@@ -356,6 +415,136 @@ static void testExtenderWrongData(CuTest* tc) {
 }
 
 
+static void testExtendToCached(CuTest* tc) {
+	int res;
+	KSI_Signature *sig = NULL;
+	KSI_Signature *ext = NULL;
+	KSI_Signature *cached = NULL;
+	unsigned char *serialized = NULL;
+	size_t serialized_len = 0;
+	unsigned char *serializedCached = NULL;
+	size_t serializedCached_len = 0;
+	KSI_Integer *to = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+
+	res = KSI_CTX_setCalendarCacheSize(ctx, 16);
+	CuAssert(tc, "Unable to enable the calendar cache.", res == KSI_OK);
+
+	res = KSI_Signature_fromFile(ctx, getFullResourcePath(TEST_SIGNATURE_FILE), &sig);
+	CuAssert(tc, "Unable to load signature from file.", res == KSI_OK && sig != NULL);
+
+	KSI_Integer_new(ctx, 1400112000, &to);
+
+	KSITest_setFileMockResponse(tc, getFullResourcePath("resource/tlv/ok-sig-2014-04-30.1-extend_response.tlv"));
+
+	res = KSI_Signature_extendTo(sig, ctx, to, &ext);
+	CuAssert(tc, "Unable to extend the signature", res == KSI_OK && ext != NULL);
+
+	/* The extender would fail now, so the second extension must be served from the cache. */
+	KSITest_setFileMockResponse(tc, getFullResourcePath("resource/tlv/ok_extend_err_response-1.tlv"));
+
+	res = KSI_Signature_extendTo(sig, ctx, to, &cached);
+	CuAssert(tc, "Unable to extend the signature with the cached calendar chain", res == KSI_OK && cached != NULL);
+
+	res = KSI_Signature_serialize(ext, &serialized, &serialized_len);
+	CuAssert(tc, "Unable to serialize extended signature", res == KSI_OK && serialized != NULL);
+
+	res = KSI_Signature_serialize(cached, &serializedCached, &serializedCached_len);
+	CuAssert(tc, "Unable to serialize extended signature", res == KSI_OK && serializedCached != NULL);
+
+	CuAssert(tc, "Signature extended with the cached calendar chain differs.", serialized_len == serializedCached_len && !memcmp(serialized, serializedCached, serialized_len));
+
+	KSI_Signature_free(cached);
+	cached = NULL;
+
+	/* Without the cache the request goes to the extender again. */
+	res = KSI_CTX_setCalendarCacheSize(ctx, 0);
+	CuAssert(tc, "Unable to disable the calendar cache.", res == KSI_OK);
+
+	res = KSI_Signature_extendTo(sig, ctx, to, &cached);
+	CuAssert(tc, "Extend should fail with server error", res != KSI_OK && cached == NULL);
+
+	KSI_free(serialized);
+	KSI_free(serializedCached);
+	KSI_Integer_free(to);
+	KSI_Signature_free(sig);
+	KSI_Signature_free(ext);
+	KSI_Signature_free(cached);
+}
+
+#ifndef _WIN32
+static void testExtendToCalendarFile(CuTest* tc) {
+	static const char CALENDAR_FILE[] = "calendar-file.tmp";
+	int res;
+	KSI_Signature *sig = NULL;
+	KSI_Signature *ext = NULL;
+	KSI_Signature *cached = NULL;
+	unsigned char *serialized = NULL;
+	size_t serialized_len = 0;
+	unsigned char *serializedCached = NULL;
+	size_t serializedCached_len = 0;
+	KSI_Integer *to = NULL;
+	FILE *f = NULL;
+
+	KSI_ERR_clearErrors(ctx);
+
+	remove(getFullResourcePath(CALENDAR_FILE));
+
+	res = KSI_CTX_setCalendarCacheFile(ctx, getFullResourcePath(CALENDAR_FILE));
+	CuAssert(tc, "Unable to open the calendar file.", res == KSI_OK);
+
+	res = KSI_Signature_fromFile(ctx, getFullResourcePath(TEST_SIGNATURE_FILE), &sig);
+	CuAssert(tc, "Unable to load signature from file.", res == KSI_OK && sig != NULL);
+
+	KSI_Integer_new(ctx, 1400112000, &to);
+
+	KSITest_setFileMockResponse(tc, getFullResourcePath("resource/tlv/ok-sig-2014-04-30.1-extend_response.tlv"));
+
+	res = KSI_Signature_extendTo(sig, ctx, to, &ext);
+	CuAssert(tc, "Unable to extend the signature", res == KSI_OK && ext != NULL);
+
+	/* Reopening the file drops everything but the file contents, as after a restart. */
+	res = KSI_CTX_setCalendarCacheFile(ctx, NULL);
+	CuAssert(tc, "Unable to close the calendar file.", res == KSI_OK);
+
+	/* A record torn by a crashed writer must not hide the preceding records. */
+	f = fopen(getFullResourcePath(CALENDAR_FILE), "ab");
+	CuAssert(tc, "Unable to open the calendar file for appending.", f != NULL);
+	fwrite("\0\0\1\0torn", 1, 8, f);
+	fclose(f);
+
+	res = KSI_CTX_setCalendarCacheFile(ctx, getFullResourcePath(CALENDAR_FILE));
+	CuAssert(tc, "Unable to reopen the calendar file.", res == KSI_OK);
+
+	/* The extender would fail now, so the second extension must be served from the file. */
+	KSITest_setFileMockResponse(tc, getFullResourcePath("resource/tlv/ok_extend_err_response-1.tlv"));
+
+	res = KSI_Signature_extendTo(sig, ctx, to, &cached);
+	CuAssert(tc, "Unable to extend the signature with the calendar chain from the file", res == KSI_OK && cached != NULL);
+
+	res = KSI_Signature_serialize(ext, &serialized, &serialized_len);
+	CuAssert(tc, "Unable to serialize extended signature", res == KSI_OK && serialized != NULL);
+
+	res = KSI_Signature_serialize(cached, &serializedCached, &serializedCached_len);
+	CuAssert(tc, "Unable to serialize extended signature", res == KSI_OK && serializedCached != NULL);
+
+	CuAssert(tc, "Signature extended with the calendar chain from the file differs.", serialized_len == serializedCached_len && !memcmp(serialized, serializedCached, serialized_len));
+
+	res = KSI_CTX_setCalendarCacheFile(ctx, NULL);
+	CuAssert(tc, "Unable to close the calendar file.", res == KSI_OK);
+
+	CuAssert(tc, "Unable to remove the calendar file.", remove(getFullResourcePath(CALENDAR_FILE)) == 0);
+
+	KSI_free(serialized);
+	KSI_free(serializedCached);
+	KSI_Integer_free(to);
+	KSI_Signature_free(sig);
+	KSI_Signature_free(ext);
+	KSI_Signature_free(cached);
+}
+#endif
+
 static void testExtAuthFailure(CuTest* tc) {
 	int res;
 	KSI_DataHash *hsh = NULL;
@@ -764,16 +953,245 @@ static void testLocalAggregationSigning(CuTest* tc) {
 	KSI_Signature_free(sig);
 }
 
+static void testTcpClientPoolSettings(CuTest* tc) {
+	int res;
+	KSI_TcpClient *tcp = NULL;
+
+	res = KSI_TcpClient_new(ctx, &tcp);
+	CuAssert(tc, "Unable to create TCP client.", res == KSI_OK && tcp != NULL);
+
+	CuAssert(tc, "Connection pool should be empty after init.", tcp->pool == NULL && tcp->poolSize == 0);
+	CuAssert(tc, "Connection reuse should be enabled by default.", tcp->maxPoolSize > 0);
+
+	res = KSI_TcpClient_setMaxPoolSize(tcp, 0);
+	CuAssert(tc, "Unable to disable connection pool.", res == KSI_OK && tcp->maxPoolSize == 0);
+
+	res = KSI_TcpClient_setPoolIdleTimeoutSeconds(tcp, 3);
+	CuAssert(tc, "Unable to set pool idle timeout.", res == KSI_OK && tcp->poolIdleTimeoutSeconds == 3);
+
+	res = KSI_TcpClient_setPoolIdleTimeoutSeconds(tcp, -1);
+	CuAssert(tc, "Negative idle timeout should not be accepted.", res == KSI_INVALID_ARGUMENT && tcp->poolIdleTimeoutSeconds == 3);
+
+	res = KSI_TcpClient_setMaxPoolSize(NULL, 1);
+	CuAssert(tc, "Setting pool size without client should fail.", res == KSI_INVALID_ARGUMENT);
+
+	CuAssert(tc, "Pipelining should be disabled by default.", tcp->maxPipelineDepth == 0 && tcp->pipelines == NULL);
+
+	res = KSI_TcpClient_setMaxPipelineDepth(tcp, 16);
+	CuAssert(tc, "Unable to enable pipelining.", res == KSI_OK && tcp->maxPipelineDepth == 16);
+
+	KSI_TcpClient_free(tcp);
+}
+
+static int dummyReadResponse(KSI_RequestHandle *handle) {
+	static const unsigned char resp[] = {0x01, 0x02, 0x03};
+	return KSI_RequestHandle_setResponse(handle, resp, sizeof(resp));
+}
+
+static void countCompletion(KSI_RequestHandle *handle, int status, void *userData) {
+	if (status == KSI_OK) ++*(int *)userData;
+}
+
+static void testRequestHandlePerformBlockingFallback(CuTest* tc) {
+	int res;
+	KSI_RequestHandle *handle = NULL;
+	int completed = 0;
+	int fd = 0;
+	int events = 0;
+	int timeoutMs = -1;
+	const unsigned char *resp = NULL;
+	size_t resp_len = 0;
+
+	res = KSI_RequestHandle_new(ctx, (const unsigned char *)"req", 3, &handle);
+	CuAssert(tc, "Unable to create request handle.", res == KSI_OK && handle != NULL);
+
+	res = KSI_RequestHandle_setReadResponseFn(handle, dummyReadResponse);
+	CuAssert(tc, "Unable to set read response function.", res == KSI_OK);
+
+	res = KSI_RequestHandle_setCompletionCallback(handle, countCompletion, &completed);
+	CuAssert(tc, "Unable to set completion callback.", res == KSI_OK);
+
+	res = KSI_RequestHandle_getPollInfo(handle, &fd, &events, &timeoutMs);
+	CuAssert(tc, "A handle without a non-blocking transport should be performed immediately.", res == KSI_OK && fd == -1 && events == 0 && timeoutMs == 0);
+
+	res = KSI_RequestHandle_perform(handle, 0);
+	CuAssert(tc, "Request should complete on the first perform.", res == KSI_OK && completed == 1);
+
+	res = KSI_RequestHandle_perform(handle, 0);
+	CuAssert(tc, "Completion callback should be called only once.", res == KSI_OK && completed == 1);
+
+	res = KSI_RequestHandle_getResponse(handle, &resp, &resp_len);
+	CuAssert(tc, "Unable to get response of a completed request.", res == KSI_OK && resp_len == 3 && resp[2] == 0x03);
+
+	KSI_RequestHandle_free(handle);
+}
+
+static int neverFinishes(KSI_RequestHandle *handle, int events) {
+	return KSI_ASYNC_NOT_FINISHED;
+}
+
+static int waitForever(KSI_RequestHandle *handle, int *fd, int *events, int *timeoutMs) {
+	*fd = -1;
+	*events = 0;
+	*timeoutMs = -1;
+	return KSI_OK;
+}
+
+static void recordStatus(KSI_RequestHandle *handle, int status, void *userData) {
+	*(int *)userData = status;
+}
+
+static void testRequestDeadline(CuTest* tc) {
+	int res;
+	KSI_RequestHandle *handle = NULL;
+	KSI_uint64_t deadline = 0;
+	KSI_uint64_t now;
+	int status = KSI_OK;
+	int fd = 0;
+	int events = 0;
+	int timeoutMs = -1;
+
+	/* The handles inherit the time budget of the context. */
+	res = KSI_CTX_setRequestTimeoutMs(ctx, 5000);
+	CuAssert(tc, "Unable to set request timeout.", res == KSI_OK);
+
+	now = KSI_getTimeMs();
+	res = KSI_RequestHandle_new(ctx, (const unsigned char *)"req", 3, &handle);
+	KSI_CTX_setRequestTimeoutMs(ctx, 0);
+	CuAssert(tc, "Unable to create request handle.", res == KSI_OK && handle != NULL);
+
+	res = KSI_RequestHandle_getDeadline(handle, &deadline);
+	CuAssert(tc, "Handle should inherit the request timeout.", res == KSI_OK && deadline >= now + 5000 && deadline <= KSI_getTimeMs() + 5000);
+
+	handle->perform = neverFinishes;
+	handle->getPollInfo = waitForever;
+
+	res = KSI_RequestHandle_setCompletionCallback(handle, recordStatus, &status);
+	CuAssert(tc, "Unable to set completion callback.", res == KSI_OK);
+
+	res = KSI_RequestHandle_getPollInfo(handle, &fd, &events, &timeoutMs);
+	CuAssert(tc, "Wait should be limited by the deadline.", res == KSI_OK && timeoutMs > 0 && timeoutMs <= 5000);
+
+	res = KSI_RequestHandle_perform(handle, 0);
+	CuAssert(tc, "Request should be in progress before the deadline.", res == KSI_ASYNC_NOT_FINISHED);
+
+	res = KSI_RequestHandle_setDeadline(handle, KSI_getTimeMs() - 1);
+	CuAssert(tc, "Unable to set deadline.", res == KSI_OK);
+
+	res = KSI_RequestHandle_getPollInfo(handle, &fd, &events, &timeoutMs);
+	CuAssert(tc, "An expired request should be performed immediately.", res == KSI_OK && timeoutMs == 0);
+
+	res = KSI_RequestHandle_perform(handle, 0);
+	CuAssert(tc, "Request should time out after the deadline.", res == KSI_NETWORK_RECIEVE_TIMEOUT && status == KSI_NETWORK_RECIEVE_TIMEOUT);
+
+	KSI_RequestHandle_free(handle);
+}
+
+static void testResolverCache(CuTest* tc) {
+	int res;
+	KSI_ResolvedAddr first[KSI_RESOLVER_MAX_ADDRS];
+	KSI_ResolvedAddr second[KSI_RESOLVER_MAX_ADDRS];
+	size_t first_len = 0;
+	size_t second_len = 0;
+
+	res = KSI_Resolver_lookup("127.0.0.1", 3333, first, KSI_RESOLVER_MAX_ADDRS, &first_len);
+	CuAssert(tc, "Unable to resolve a numeric address.", res == KSI_OK && first_len == 1 && first[0].family == AF_INET);
+
+	res = KSI_Resolver_lookup("localhost", 3333, first, KSI_RESOLVER_MAX_ADDRS, &first_len);
+	CuAssert(tc, "Unable to resolve localhost.", res == KSI_OK && first_len > 0);
+
+	res = KSI_Resolver_lookup("localhost", 3333, second, KSI_RESOLVER_MAX_ADDRS, &second_len);
+	CuAssert(tc, "Unable to resolve localhost from the cache.", res == KSI_OK && second_len == first_len);
+
+	/* Consecutive lookups start from the next address. */
+	CuAssert(tc, "Addresses should be rotated.", !memcmp(&second[0], &first[1 % first_len], sizeof(KSI_ResolvedAddr)));
+
+	res = KSI_Resolver_lookup("localhost", 3333, second, 1, &second_len);
+	CuAssert(tc, "Number of addresses should be limited by the output array.", res == KSI_OK && second_len == 1);
+}
+
+#ifndef _WIN32
+static void testTcpClientHttpFraming(CuTest* tc) {
+	static const char response[] =
+			"HTTP/1.1 200 OK\r\n"
+			"Transfer-Encoding: chunked\r\n"
+			"\r\n"
+			"3\r\nabc\r\n2\r\nde\r\n0\r\n\r\n";
+	int res;
+	int lfd = -1;
+	int cfd = -1;
+	struct sockaddr_in addr;
+	socklen_t addr_len = sizeof(addr);
+	KSI_TcpClient *tcp = NULL;
+	KSI_RequestHandle *handle = NULL;
+	unsigned char *request = NULL;
+	const unsigned char *raw = NULL;
+	size_t raw_len = 0;
+	int httpStatus = 0;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+
+	lfd = socket(AF_INET, SOCK_STREAM, 0);
+	CuAssert(tc, "Unable to create socket.", lfd >= 0);
+	res = bind(lfd, (struct sockaddr *)&addr, sizeof(addr));
+	CuAssert(tc, "Unable to bind socket.", res == 0 && listen(lfd, 1) == 0);
+	res = getsockname(lfd, (struct sockaddr *)&addr, &addr_len);
+	CuAssert(tc, "Unable to get the port.", res == 0);
+
+	res = KSI_TcpClient_new(ctx, &tcp);
+	CuAssert(tc, "Unable to create TCP client.", res == KSI_OK && tcp != NULL);
+
+	res = KSI_RequestHandle_new(ctx, (const unsigned char *)"req", 3, &handle);
+	CuAssert(tc, "Unable to create request handle.", res == KSI_OK && handle != NULL);
+
+	res = KSI_strdup("GET / HTTP/1.1\r\nHost: localhost\r\n\r\n", (char **)&request);
+	CuAssert(tc, "Unable to create request.", res == KSI_OK);
+
+	res = KSI_TcpClient_sendHttpRequest(tcp, handle, "127.0.0.1", ntohs(addr.sin_port), request, strlen((char *)request), &httpStatus);
+	CuAssert(tc, "Unable to send HTTP request.", res == KSI_OK);
+
+	/* Start the request, so the connection is waiting in the backlog. */
+	res = KSI_RequestHandle_perform(handle, 0);
+	CuAssert(tc, "Request should be in progress.", res == KSI_ASYNC_NOT_FINISHED);
+
+	cfd = accept(lfd, NULL, NULL);
+	CuAssert(tc, "Unable to accept the connection.", cfd >= 0);
+	res = (int)write(cfd, response, sizeof(response) - 1);
+	CuAssert(tc, "Unable to write the response.", res == (int)sizeof(response) - 1);
+
+	res = KSI_RequestHandle_getResponse(handle, &raw, &raw_len);
+	CuAssert(tc, "Unable to receive the response.", res == KSI_OK);
+	CuAssert(tc, "Chunked body not decoded.", raw_len == 5 && !memcmp(raw, "abcde", 5));
+	CuAssert(tc, "HTTP status not reported.", httpStatus == 200);
+
+	/* The kept-alive connection is returned to the pool. */
+	CuAssert(tc, "Connection should be pooled.", tcp->poolSize == 1);
+
+	KSI_RequestHandle_free(handle);
+	KSI_TcpClient_free(tcp);
+	close(cfd);
+	close(lfd);
+}
+#endif
+
 CuSuite* KSITest_NET_getSuite(void) {
 	CuSuite* suite = CuSuiteNew();
 
 	suite->preTest = preTest;
 
 	SUITE_ADD_TEST(suite, testSigning);
+	SUITE_ADD_TEST(suite, testSigningCoalesced);
 	SUITE_ADD_TEST(suite, testAggreAuthFailure);
 	SUITE_ADD_TEST(suite, testExtending);
 	SUITE_ADD_TEST(suite, testExtendTo);
 	SUITE_ADD_TEST(suite, testExtenderWrongData);
+	SUITE_ADD_TEST(suite, testExtendToCached);
+#ifndef _WIN32
+	SUITE_ADD_TEST(suite, testExtendToCalendarFile);
+#endif
 	SUITE_ADD_TEST(suite, testExtAuthFailure);
 	SUITE_ADD_TEST(suite, testExtendingWithoutPublication);
 	SUITE_ADD_TEST(suite, testExtendingToNULL);
@@ -784,6 +1202,13 @@ CuSuite* KSITest_NET_getSuite(void) {
 	SUITE_ADD_TEST(suite, testUrlSplit);
 	SUITE_ADD_TEST(suite, testSmartServiceSetters);
 	SUITE_ADD_TEST(suite, testLocalAggregationSigning);
+	SUITE_ADD_TEST(suite, testTcpClientPoolSettings);
+	SUITE_ADD_TEST(suite, testRequestHandlePerformBlockingFallback);
+	SUITE_ADD_TEST(suite, testRequestDeadline);
+	SUITE_ADD_TEST(suite, testResolverCache);
+#ifndef _WIN32
+	SUITE_ADD_TEST(suite, testTcpClientHttpFraming);
+#endif
 
 	return suite;
 }
@@ -20,6 +20,7 @@
 #include <string.h>
 #include <ksi/publicationsfile.h>
 #include <ksi/pkitruststore.h>
+#include <ksi/net.h>
 #include "all_tests.h"
 
 extern KSI_CTX *ctx;
@@ -281,6 +282,47 @@ static void testFindPublicationByPubStr(CuTest *tc) {
 
 }
 
+static void testReloadPublicationsFile(CuTest *tc) {
+	int res;
+	KSI_PublicationsFile *first = NULL;
+	KSI_PublicationsFile *second = NULL;
+	KSI_PublicationsFile *third = NULL;
+	KSI_PublicationRecord *pubRec = NULL;
+	KSI_uint64_t start;
+
+	KSI_ERR_clearErrors(ctx);
+
+	res = KSI_receivePublicationsFile(ctx, &first);
+	CuAssert(tc, "Unable to get publications file.", res == KSI_OK && first != NULL);
+
+	res = KSI_CTX_setPublicationsFileTtl(ctx, 1, 0);
+	CuAssert(tc, "Unable to set the publications file time to live.", res == KSI_OK);
+
+	start = KSI_getTimeMs();
+	while (KSI_getTimeMs() < start + 2);
+
+	res = KSI_receivePublicationsFile(ctx, &second);
+	CuAssert(tc, "Unable to reload publications file.", res == KSI_OK && second != NULL);
+	CuAssert(tc, "Publications file should have been reloaded.", first != second);
+
+	/* The replaced file must stay usable. */
+	res = KSI_PublicationsFile_getPublicationDataByPublicationString(first, "AAAAAA-CTJR3I-AANBWU-RY76YF-7TH2M5-KGEZVA-WLLRGD-3GKYBG-AM5WWV-4MCLSP-XPRDDI-UFMHBA", &pubRec);
+	CuAssert(tc, "Unable to use the replaced publications file.", res == KSI_OK && pubRec != NULL);
+
+	res = KSI_CTX_setPublicationsFileTtl(ctx, 3600 * 1000, 0);
+	CuAssert(tc, "Unable to set the publications file time to live.", res == KSI_OK);
+
+	res = KSI_receivePublicationsFile(ctx, &third);
+	CuAssert(tc, "Unable to get publications file.", res == KSI_OK && third == second);
+
+	/* The mock network client has no publications file URL for the reloading thread. */
+	res = KSI_CTX_setPublicationsFileTtl(ctx, 3600 * 1000, 1);
+	CuAssert(tc, "Background reloading should require the publications file URL.", res == KSI_PUBLICATIONS_FILE_NOT_CONFIGURED);
+
+	res = KSI_CTX_setPublicationsFileTtl(ctx, 0, 0);
+	CuAssert(tc, "Unable to disable reloading the publications file.", res == KSI_OK);
+}
+
 static void testFindPublicationByTime(CuTest *tc) {
 	int res;
 	KSI_PublicationsFile *pubFile = NULL;
@@ -609,6 +651,7 @@ CuSuite* KSITest_Publicationsfile_getSuite(void) {
 	SUITE_ADD_TEST(suite, testVerifyPublicationsFile);
 	SUITE_ADD_TEST(suite, testPublicationStringEncodingAndDecoding);
 	SUITE_ADD_TEST(suite, testFindPublicationByPubStr);
+	SUITE_ADD_TEST(suite, testReloadPublicationsFile);
 	SUITE_ADD_TEST(suite, testFindPublicationByTime);
 	SUITE_ADD_TEST(suite, testFindPublicationRef);
 	SUITE_ADD_TEST(suite, testSerializePublicationsFile);
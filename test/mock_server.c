@@ -0,0 +1,1744 @@
+/*
+ * Copyright 2013-2015 Guardtime, Inc.
+ *
+ * This file is part of the Guardtime client SDK.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES, CONDITIONS, OR OTHER LICENSES OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * "Guardtime" and "KSI" are trademarks or registered trademarks of
+ * Guardtime, Inc., and no license to trademarks is granted; Guardtime
+ * reserves and retains all trademark rights.
+ */
+
+/*
+ * Local stand-in for the aggregator and the extender, meant for load and regression
+ * testing of the network clients on a single machine. The server accepts the TLV
+ * protocol over plain TCP and the same PDUs posted over HTTP/1.1, verifies the HMAC
+ * of the requests and answers with aggregation and calendar hash chains that verify
+ * against each other: the requests are aggregated into rounds, one round per
+ * calendar second, and the calendar is a single hash tree over the round roots.
+ *
+ * The calendar begins when the server is started, earlier seconds are filled with
+ * placeholder values, so only the signatures issued by the same server process can
+ * be extended. Responses carry no calendar authentication records.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include <ksi/ksi.h>
+#include <ksi/hashchain.h>
+#include <ksi/http_parser.h>
+
+/** Maximum size of a TLV encoded PDU. */
+#define MOCK_MAX_PDU_LEN (0xffff + 4)
+/** Number of buckets in the calendar node cache. */
+#define MOCK_CACHE_BUCKETS 0x10000
+/** Aggregation trees deeper than this are not supported, limits the level of the requests. */
+#define MOCK_MAX_TREE_DEPTH 64
+/** Imprint length of the SHA-256 hash values used by the server. */
+#define MOCK_IMPRINT_LEN 33
+
+#define AGGR_PDU_TAG 0x200
+#define EXT_PDU_TAG 0x300
+
+typedef struct Slot_st Slot;
+typedef struct Connection_st Connection;
+typedef struct PendingReq_st PendingReq;
+typedef struct CacheNode_st CacheNode;
+
+/** Server configuration, see #usage. */
+static struct {
+	const char *bindAddr;
+	int tcp;
+	unsigned tcpPort;
+	int http;
+	unsigned httpPort;
+	const char *user;
+	const char *key;
+	unsigned roundMs;
+	unsigned latencyMs;
+	unsigned jitterMs;
+	double errorRate;
+	double dropRate;
+	unsigned seed;
+	int verbose;
+} conf = { "127.0.0.1", 0, 0, 0, 0, "anon", "anon", 1000, 0, 0, 0.0, 0.0, 0, 0 };
+
+/**
+ * A response slot of a connection. The slots are created in the order of the requests and
+ * filled when the response is ready. The HTTP responses are written in the order of the
+ * slots, the TCP responses as soon as they are ready.
+ */
+struct Slot_st {
+	/** Serialized response PDU, \c NULL for a bodiless HTTP error. */
+	unsigned char *raw;
+	size_t raw_len;
+	/** Set when the response is ready. */
+	int filled;
+	/** The response is not written before this time (monotonic milliseconds). */
+	unsigned long long notBefore;
+	/** HTTP status code of the response. */
+	int httpStatus;
+	/** HTTP version of the request. */
+	unsigned short httpMajor;
+	unsigned short httpMinor;
+	/** Whether the HTTP connection stays open after this response. */
+	int keepAlive;
+	Slot *next;
+};
+
+struct Connection_st {
+	int fd;
+	int isHttp;
+	/** Random state of the reader thread, used for the latency and error injection. */
+	unsigned rand;
+
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	/** Slots in the order of the requests. */
+	Slot *head;
+	Slot *tail;
+	/** Set by the reader thread when no more slots are added. */
+	int readerDone;
+	/** Set when the connection has failed, the remaining responses are discarded. */
+	int broken;
+};
+
+/** An aggregation request waiting for the end of its round. */
+struct PendingReq_st {
+	Connection *conn;
+	Slot *slot;
+	KSI_uint64_t requestId;
+	unsigned char imprint[KSI_MAX_IMPRINT_LEN];
+	size_t imprint_len;
+	unsigned level;
+	PendingReq *next;
+};
+
+/** A cached calendar tree node covering the leaves from \c lo to \c lo + \c r. */
+struct CacheNode_st {
+	time_t lo;
+	time_t r;
+	unsigned char imprint[MOCK_IMPRINT_LEN];
+	CacheNode *next;
+};
+
+/** The calendar, shared by all threads. */
+static struct {
+	pthread_mutex_t lock;
+	/** Time of the first round, the leaves before it are placeholders. */
+	time_t start;
+	/** Round root hashes, one per closed round. */
+	unsigned char (*leaves)[MOCK_IMPRINT_LEN];
+	size_t leaves_len;
+	size_t leaves_size;
+	/** Calendar tree nodes computed so far, they never change. */
+	CacheNode *cache[MOCK_CACHE_BUCKETS];
+} calendar;
+
+/** Requests of the open round. */
+static struct {
+	pthread_mutex_t lock;
+	PendingReq *head;
+	PendingReq *tail;
+	size_t count;
+} round_;
+
+static struct {
+	pthread_mutex_t lock;
+	unsigned long long aggregated;
+	unsigned long long extended;
+	unsigned long long injectedErrors;
+	unsigned long long rejected;
+	unsigned long long dropped;
+	unsigned long long connections;
+} stats;
+
+static volatile sig_atomic_t stopped = 0;
+
+#define STAT_INC(field) do { pthread_mutex_lock(&stats.lock); stats.field++; pthread_mutex_unlock(&stats.lock); } while (0)
+
+static unsigned long long nowMs(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int chance(unsigned *state, double percent) {
+	return percent > 0 && rand_r(state) < percent / 100.0 * RAND_MAX;
+}
+
+static unsigned long long responseTime(unsigned *state) {
+	unsigned long long t = nowMs() + conf.latencyMs;
+	if (conf.jitterMs > 0) t += (unsigned)rand_r(state) % (conf.jitterMs + 1);
+	return t;
+}
+
+static time_t highBit(time_t n) {
+	n |= (n >>  1);
+	n |= (n >>  2);
+	n |= (n >>  4);
+	n |= (n >>  8);
+	n |= (n >> 16);
+	n |= (n >> 32);
+	return n - (n >> 1);
+}
+
+/**
+ * Calculates SHA-256 over the concatenation of the inputs and stores the imprint of the result.
+ */
+static int hashImprints(KSI_CTX *ctx, const unsigned char *a, size_t a_len, const unsigned char *b, size_t b_len, unsigned char tail, unsigned char *out) {
+	int res = KSI_UNKNOWN_ERROR;
+	unsigned char buf[2 * KSI_MAX_IMPRINT_LEN + 1];
+	KSI_DataHash *hsh = NULL;
+	const unsigned char *imprint = NULL;
+	size_t imprint_len;
+
+	memcpy(buf, a, a_len);
+	memcpy(buf + a_len, b, b_len);
+	buf[a_len + b_len] = tail;
+
+	res = KSI_DataHash_create(ctx, buf, a_len + b_len + 1, KSI_HASHALG_SHA2_256, &hsh);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_DataHash_getImprint(hsh, &imprint, &imprint_len);
+	if (res != KSI_OK) goto cleanup;
+
+	memcpy(out, imprint, MOCK_IMPRINT_LEN);
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_DataHash_free(hsh);
+
+	return res;
+}
+
+/**
+ * Deterministic placeholder hash value, used for the round seeds and the calendar
+ * subtrees before the start of the server.
+ */
+static int placeholder(KSI_CTX *ctx, char kind, time_t lo, time_t r, unsigned char *out) {
+	unsigned char buf[17];
+	int i;
+
+	buf[0] = (unsigned char)kind;
+	for (i = 0; i < 8; i++) {
+		buf[1 + i] = (unsigned char)((KSI_uint64_t)lo >> (56 - 8 * i));
+		buf[9 + i] = (unsigned char)((KSI_uint64_t)r >> (56 - 8 * i));
+	}
+
+	return hashImprints(ctx, buf, sizeof(buf), (const unsigned char *)&conf.seed, sizeof(conf.seed), 0, out);
+}
+
+/**
+ * Hash value of the calendar tree node covering the leaves from \c lo to \c lo + \c r. The
+ * tree is built like the calendar of the KSI service: the left subtree is the largest
+ * perfect tree, the rest of the leaves are in the right subtree. Must be called with the
+ * calendar lock held.
+ */
+static int calendarNode(KSI_CTX *ctx, time_t lo, time_t r, unsigned char *out) {
+	int res = KSI_UNKNOWN_ERROR;
+	unsigned char left[MOCK_IMPRINT_LEN];
+	unsigned char right[MOCK_IMPRINT_LEN];
+	CacheNode *node = NULL;
+	size_t bucket;
+	time_t h;
+
+	/* Nobody can descend into the subtrees before the start, so they are not calculated. */
+	if (lo + r < calendar.start) {
+		return placeholder(ctx, 'c', lo, r, out);
+	}
+
+	if (r == 0) {
+		memcpy(out, calendar.leaves[lo - calendar.start], MOCK_IMPRINT_LEN);
+		return KSI_OK;
+	}
+
+	bucket = (size_t)((KSI_uint64_t)(lo * 31 + r) % MOCK_CACHE_BUCKETS);
+	for (node = calendar.cache[bucket]; node != NULL; node = node->next) {
+		if (node->lo == lo && node->r == r) {
+			memcpy(out, node->imprint, MOCK_IMPRINT_LEN);
+			return KSI_OK;
+		}
+	}
+
+	h = highBit(r);
+
+	res = calendarNode(ctx, lo, h - 1, left);
+	if (res != KSI_OK) goto cleanup;
+
+	res = calendarNode(ctx, lo + h, r - h, right);
+	if (res != KSI_OK) goto cleanup;
+
+	res = hashImprints(ctx, left, MOCK_IMPRINT_LEN, right, MOCK_IMPRINT_LEN, 0xff, out);
+	if (res != KSI_OK) goto cleanup;
+
+	node = malloc(sizeof(CacheNode));
+	if (node == NULL) {
+		res = KSI_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+
+	node->lo = lo;
+	node->r = r;
+	memcpy(node->imprint, out, MOCK_IMPRINT_LEN);
+	node->next = calendar.cache[bucket];
+	calendar.cache[bucket] = node;
+
+	res = KSI_OK;
+
+cleanup:
+
+	return res;
+}
+
+static int newLink(KSI_CTX *ctx, int isLeft, const unsigned char *imprint, size_t imprint_len, unsigned levelCorrection, KSI_HashChainLink **link) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_HashChainLink *tmp = NULL;
+	KSI_DataHash *hsh = NULL;
+	KSI_Integer *lc = NULL;
+
+	res = KSI_HashChainLink_new(ctx, &tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_HashChainLink_setIsLeft(tmp, isLeft);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_DataHash_fromImprint(ctx, imprint, imprint_len, &hsh);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_HashChainLink_setImprint(tmp, hsh);
+	if (res != KSI_OK) goto cleanup;
+	hsh = NULL;
+
+	if (levelCorrection > 0) {
+		res = KSI_Integer_new(ctx, levelCorrection, &lc);
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_HashChainLink_setLevelCorrection(tmp, lc);
+		if (res != KSI_OK) goto cleanup;
+		lc = NULL;
+	}
+
+	*link = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_Integer_free(lc);
+	KSI_DataHash_free(hsh);
+	KSI_HashChainLink_free(tmp);
+
+	return res;
+}
+
+/**
+ * Creates the calendar hash chain from the round \c aggrTime to the root of the calendar
+ * at \c pubTime. Both rounds must be closed.
+ */
+static int calendarChain(KSI_CTX *ctx, time_t aggrTime, time_t pubTime, KSI_CalendarHashChain **chain) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_CalendarHashChain *tmp = NULL;
+	KSI_LIST(KSI_HashChainLink) *links = NULL;
+	KSI_HashChainLink *link = NULL;
+	KSI_DataHash *hsh = NULL;
+	KSI_Integer *tm = NULL;
+	unsigned char imprint[MOCK_IMPRINT_LEN];
+	time_t lo = 0;
+	time_t r = pubTime;
+	time_t h;
+
+	res = KSI_HashChainLinkList_new(&links);
+	if (res != KSI_OK) goto cleanup;
+
+	pthread_mutex_lock(&calendar.lock);
+
+	/* Descend from the root, the links are prepended so the chain starts from the leaf. */
+	while (r > 0) {
+		h = highBit(r);
+		if (aggrTime - lo < h) {
+			res = calendarNode(ctx, lo + h, r - h, imprint);
+			r = h - 1;
+			if (res == KSI_OK) res = newLink(ctx, 1, imprint, MOCK_IMPRINT_LEN, 0, &link);
+		} else {
+			res = calendarNode(ctx, lo, h - 1, imprint);
+			lo += h;
+			r -= h;
+			if (res == KSI_OK) res = newLink(ctx, 0, imprint, MOCK_IMPRINT_LEN, 0, &link);
+		}
+		if (res == KSI_OK) res = KSI_HashChainLinkList_insertAt(links, 0, link);
+		if (res != KSI_OK) break;
+		link = NULL;
+	}
+
+	if (res == KSI_OK) res = calendarNode(ctx, aggrTime, 0, imprint);
+
+	pthread_mutex_unlock(&calendar.lock);
+
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_CalendarHashChain_new(ctx, &tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_DataHash_fromImprint(ctx, imprint, MOCK_IMPRINT_LEN, &hsh);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_CalendarHashChain_setInputHash(tmp, hsh);
+	if (res != KSI_OK) goto cleanup;
+	hsh = NULL;
+
+	res = KSI_Integer_new(ctx, (KSI_uint64_t)pubTime, &tm);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_CalendarHashChain_setPublicationTime(tmp, tm);
+	if (res != KSI_OK) goto cleanup;
+	tm = NULL;
+
+	res = KSI_Integer_new(ctx, (KSI_uint64_t)aggrTime, &tm);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_CalendarHashChain_setAggregationTime(tmp, tm);
+	if (res != KSI_OK) goto cleanup;
+	tm = NULL;
+
+	res = KSI_CalendarHashChain_setHashChain(tmp, links);
+	if (res != KSI_OK) goto cleanup;
+	links = NULL;
+
+	*chain = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_Integer_free(tm);
+	KSI_DataHash_free(hsh);
+	KSI_HashChainLink_free(link);
+	KSI_HashChainLinkList_free(links);
+	KSI_CalendarHashChain_free(tmp);
+
+	return res;
+}
+
+static int newHeader(KSI_CTX *ctx, KSI_Header **header) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_Header *tmp = NULL;
+	KSI_Utf8String *loginId = NULL;
+
+	res = KSI_Header_new(ctx, &tmp);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_Utf8String_new(ctx, conf.user, strlen(conf.user) + 1, &loginId);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_Header_setLoginId(tmp, loginId);
+	if (res != KSI_OK) goto cleanup;
+	loginId = NULL;
+
+	*header = tmp;
+	tmp = NULL;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_Utf8String_free(loginId);
+	KSI_Header_free(tmp);
+
+	return res;
+}
+
+/**
+ * Encloses the aggregation response into a PDU with the HMAC and serializes it. The
+ * response is freed.
+ */
+static int serializeAggregationResp(KSI_CTX *ctx, KSI_AggregationResp *resp, unsigned char **raw, size_t *raw_len) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_AggregationPdu *pdu = NULL;
+	KSI_Header *header = NULL;
+
+	res = KSI_AggregationPdu_new(ctx, &pdu);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_AggregationPdu_setResponse(pdu, resp);
+	if (res != KSI_OK) goto cleanup;
+	resp = NULL;
+
+	res = newHeader(ctx, &header);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_AggregationPdu_setHeader(pdu, header);
+	if (res != KSI_OK) goto cleanup;
+	header = NULL;
+
+	res = KSI_AggregationPdu_updateHmac(pdu, KSI_getHashAlgorithmByName("default"), conf.key);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_AggregationPdu_serialize(pdu, raw, raw_len);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_Header_free(header);
+	KSI_AggregationResp_free(resp);
+	KSI_AggregationPdu_free(pdu);
+
+	return res;
+}
+
+/**
+ * Encloses the extension response into a PDU with the HMAC and serializes it. The
+ * response is freed.
+ */
+static int serializeExtendResp(KSI_CTX *ctx, KSI_ExtendResp *resp, unsigned char **raw, size_t *raw_len) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_ExtendPdu *pdu = NULL;
+	KSI_Header *header = NULL;
+
+	res = KSI_ExtendPdu_new(ctx, &pdu);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_ExtendPdu_setResponse(pdu, resp);
+	if (res != KSI_OK) goto cleanup;
+	resp = NULL;
+
+	res = newHeader(ctx, &header);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_ExtendPdu_setHeader(pdu, header);
+	if (res != KSI_OK) goto cleanup;
+	header = NULL;
+
+	res = KSI_ExtendPdu_updateHmac(pdu, KSI_getHashAlgorithmByName("default"), conf.key);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_ExtendPdu_serialize(pdu, raw, raw_len);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_Header_free(header);
+	KSI_ExtendResp_free(resp);
+	KSI_ExtendPdu_free(pdu);
+
+	return res;
+}
+
+/**
+ * Serializes an error PDU, used when the request can not be authenticated.
+ */
+static int serializeErrorPdu(KSI_CTX *ctx, int isExtend, KSI_uint64_t status, const char *msg, unsigned char **raw, size_t *raw_len) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_AggregationPdu *aggrPdu = NULL;
+	KSI_ExtendPdu *extPdu = NULL;
+	KSI_ErrorPdu *err = NULL;
+	KSI_Integer *st = NULL;
+	KSI_Utf8String *str = NULL;
+
+	res = KSI_ErrorPdu_new(ctx, &err);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_Integer_new(ctx, status, &st);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_ErrorPdu_setStatus(err, st);
+	if (res != KSI_OK) goto cleanup;
+	st = NULL;
+
+	res = KSI_Utf8String_new(ctx, msg, strlen(msg) + 1, &str);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_ErrorPdu_setErrorMessage(err, str);
+	if (res != KSI_OK) goto cleanup;
+	str = NULL;
+
+	if (isExtend) {
+		res = KSI_ExtendPdu_new(ctx, &extPdu);
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_ExtendPdu_setError(extPdu, err);
+		if (res != KSI_OK) goto cleanup;
+		err = NULL;
+
+		res = KSI_ExtendPdu_serialize(extPdu, raw, raw_len);
+	} else {
+		res = KSI_AggregationPdu_new(ctx, &aggrPdu);
+		if (res != KSI_OK) goto cleanup;
+
+		res = KSI_AggregationPdu_setError(aggrPdu, err);
+		if (res != KSI_OK) goto cleanup;
+		err = NULL;
+
+		res = KSI_AggregationPdu_serialize(aggrPdu, raw, raw_len);
+	}
+
+cleanup:
+
+	KSI_Utf8String_free(str);
+	KSI_Integer_free(st);
+	KSI_ErrorPdu_free(err);
+	KSI_ExtendPdu_free(extPdu);
+	KSI_AggregationPdu_free(aggrPdu);
+
+	return res;
+}
+
+/**
+ * Serializes a response with an error status. The request id is mandatory in the responses.
+ */
+static int serializeStatus(KSI_CTX *ctx, int isExtend, KSI_uint64_t requestId, KSI_uint64_t status, const char *msg, unsigned char **raw, size_t *raw_len) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_AggregationResp *aggrResp = NULL;
+	KSI_ExtendResp *extResp = NULL;
+	KSI_Integer *id = NULL;
+	KSI_Integer *st = NULL;
+	KSI_Utf8String *str = NULL;
+
+	res = KSI_Integer_new(ctx, requestId, &id);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_Integer_new(ctx, status, &st);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_Utf8String_new(ctx, msg, strlen(msg) + 1, &str);
+	if (res != KSI_OK) goto cleanup;
+
+	if (isExtend) {
+		res = KSI_ExtendResp_new(ctx, &extResp);
+		if (res != KSI_OK) goto cleanup;
+
+		KSI_ExtendResp_setRequestId(extResp, id);
+		KSI_ExtendResp_setStatus(extResp, st);
+		KSI_ExtendResp_setErrorMsg(extResp, str);
+		id = NULL;
+		st = NULL;
+		str = NULL;
+
+		res = serializeExtendResp(ctx, extResp, raw, raw_len);
+		extResp = NULL;
+	} else {
+		res = KSI_AggregationResp_new(ctx, &aggrResp);
+		if (res != KSI_OK) goto cleanup;
+
+		KSI_AggregationResp_setRequestId(aggrResp, id);
+		KSI_AggregationResp_setStatus(aggrResp, st);
+		KSI_AggregationResp_setErrorMsg(aggrResp, str);
+		id = NULL;
+		st = NULL;
+		str = NULL;
+
+		res = serializeAggregationResp(ctx, aggrResp, raw, raw_len);
+		aggrResp = NULL;
+	}
+
+cleanup:
+
+	KSI_Utf8String_free(str);
+	KSI_Integer_free(st);
+	KSI_Integer_free(id);
+
+	return res;
+}
+
+static Slot *addSlot(Connection *conn) {
+	Slot *slot = calloc(1, sizeof(Slot));
+
+	if (slot == NULL) return NULL;
+
+	slot->httpStatus = 200;
+	slot->keepAlive = 1;
+
+	pthread_mutex_lock(&conn->lock);
+	if (conn->tail == NULL) {
+		conn->head = slot;
+	} else {
+		conn->tail->next = slot;
+	}
+	conn->tail = slot;
+	pthread_mutex_unlock(&conn->lock);
+
+	return slot;
+}
+
+/**
+ * Fills the slot with the response and wakes up the writer of the connection. The
+ * ownership of \c raw is taken.
+ */
+static void fillSlot(Connection *conn, Slot *slot, unsigned char *raw, size_t raw_len, unsigned long long notBefore) {
+	pthread_mutex_lock(&conn->lock);
+	slot->raw = raw;
+	slot->raw_len = raw_len;
+	if (slot->notBefore < notBefore) slot->notBefore = notBefore;
+	slot->filled = 1;
+	pthread_cond_signal(&conn->cond);
+	pthread_mutex_unlock(&conn->lock);
+}
+
+/**
+ * Builds the aggregation tree of the round and answers all of its requests. The leftmost
+ * leaf of every round is a seed value, so each request has at least one link in its chain.
+ */
+static int closeRound(KSI_CTX *ctx, time_t roundTime, PendingReq *reqs, size_t count) {
+	int res = KSI_UNKNOWN_ERROR;
+	typedef struct {
+		unsigned char imprint[KSI_MAX_IMPRINT_LEN];
+		size_t imprint_len;
+		unsigned level;
+		size_t parent;
+		size_t sibling;
+		int isLeft;
+	} TreeNode;
+	TreeNode *nodes = NULL;
+	size_t nodes_len = 0;
+	size_t *layer = NULL;
+	size_t layer_len;
+	size_t root;
+	size_t i;
+	size_t j;
+	PendingReq *req = NULL;
+	KSI_CalendarHashChain *calChain = NULL;
+	unsigned char (*leaves)[MOCK_IMPRINT_LEN] = NULL;
+
+	nodes = calloc(2 * (count + 1), sizeof(TreeNode));
+	layer = calloc(count + 1, sizeof(size_t));
+	if (nodes == NULL || layer == NULL) {
+		res = KSI_OUT_OF_MEMORY;
+		goto cleanup;
+	}
+
+	res = placeholder(ctx, 's', roundTime, 0, nodes[0].imprint);
+	if (res != KSI_OK) goto cleanup;
+	nodes[0].imprint_len = MOCK_IMPRINT_LEN;
+	nodes_len = 1;
+
+	for (req = reqs; req != NULL; req = req->next) {
+		memcpy(nodes[nodes_len].imprint, req->imprint, req->imprint_len);
+		nodes[nodes_len].imprint_len = req->imprint_len;
+		nodes[nodes_len].level = req->level;
+		nodes_len++;
+	}
+
+	for (i = 0; i < nodes_len; i++) layer[i] = i;
+	layer_len = nodes_len;
+
+	/* Join the nodes of the layer pairwise, an odd node is carried to the next layer. */
+	while (layer_len > 1) {
+		for (i = 0, j = 0; i < layer_len; i += 2, j++) {
+			size_t l = layer[i];
+			size_t r;
+			TreeNode *node = &nodes[nodes_len];
+
+			if (i + 1 == layer_len) {
+				layer[j] = l;
+				continue;
+			}
+			r = layer[i + 1];
+
+			node->level = (nodes[l].level > nodes[r].level ? nodes[l].level : nodes[r].level) + 1;
+			res = hashImprints(ctx, nodes[l].imprint, nodes[l].imprint_len, nodes[r].imprint, nodes[r].imprint_len, (unsigned char)node->level, node->imprint);
+			if (res != KSI_OK) goto cleanup;
+			node->imprint_len = MOCK_IMPRINT_LEN;
+
+			nodes[l].parent = nodes_len;
+			nodes[l].sibling = r;
+			nodes[l].isLeft = 1;
+			nodes[r].parent = nodes_len;
+			nodes[r].sibling = l;
+			nodes[r].isLeft = 0;
+
+			layer[j] = nodes_len++;
+		}
+		layer_len = j;
+	}
+	root = layer[0];
+
+	/* Publish the round root as the next calendar leaf. */
+	pthread_mutex_lock(&calendar.lock);
+	if (calendar.leaves_len == calendar.leaves_size) {
+		size_t size = calendar.leaves_size * 2 + 64;
+		leaves = realloc(calendar.leaves, size * MOCK_IMPRINT_LEN);
+		if (leaves != NULL) {
+			calendar.leaves = leaves;
+			calendar.leaves_size = size;
+		}
+	}
+	if (calendar.leaves_len < calendar.leaves_size) {
+		memcpy(calendar.leaves[calendar.leaves_len++], nodes[root].imprint, MOCK_IMPRINT_LEN);
+		res = KSI_OK;
+	} else {
+		res = KSI_OUT_OF_MEMORY;
+	}
+	pthread_mutex_unlock(&calendar.lock);
+	if (res != KSI_OK) goto cleanup;
+
+	if (count == 0) goto cleanup;
+
+	res = calendarChain(ctx, roundTime, roundTime, &calChain);
+	if (res != KSI_OK) goto cleanup;
+
+	for (req = reqs, i = 1; req != NULL; req = req->next, i++) {
+		KSI_AggregationResp *resp = NULL;
+		KSI_AggregationHashChain *aggrChain = NULL;
+		KSI_LIST(KSI_AggregationHashChain) *aggrChains = NULL;
+		KSI_LIST(KSI_HashChainLink) *links = NULL;
+		KSI_LIST(KSI_Integer) *chainIndex = NULL;
+		KSI_HashChainLink *link = NULL;
+		KSI_Integer *integer = NULL;
+		KSI_DataHash *hsh = NULL;
+		KSI_uint64_t index = 1;
+		unsigned char *raw = NULL;
+		size_t raw_len = 0;
+		size_t n;
+		int bits[MOCK_MAX_TREE_DEPTH];
+		int depth = 0;
+
+		res = KSI_HashChainLinkList_new(&links);
+		if (res != KSI_OK) goto response;
+
+		for (n = i; n != root; n = nodes[n].parent) {
+			const TreeNode *sibling = &nodes[nodes[n].sibling];
+
+			res = newLink(ctx, nodes[n].isLeft, sibling->imprint, sibling->imprint_len, nodes[nodes[n].parent].level - nodes[n].level - 1, &link);
+			if (res != KSI_OK) goto response;
+
+			res = KSI_HashChainLinkList_append(links, link);
+			if (res != KSI_OK) goto response;
+			link = NULL;
+
+			bits[depth++] = nodes[n].isLeft;
+		}
+
+		/* The chain index holds the directions from the root to the leaf after a leading 1 bit. */
+		while (depth > 0) index = (index << 1) | (KSI_uint64_t)bits[--depth];
+
+		res = KSI_AggregationHashChain_new(ctx, &aggrChain);
+		if (res != KSI_OK) goto response;
+
+		res = KSI_AggregationHashChain_setChain(aggrChain, links);
+		if (res != KSI_OK) goto response;
+		links = NULL;
+
+		res = KSI_DataHash_fromImprint(ctx, req->imprint, req->imprint_len, &hsh);
+		if (res != KSI_OK) goto response;
+
+		res = KSI_AggregationHashChain_setInputHash(aggrChain, hsh);
+		if (res != KSI_OK) goto response;
+		hsh = NULL;
+
+		res = KSI_Integer_new(ctx, KSI_HASHALG_SHA2_256, &integer);
+		if (res != KSI_OK) goto response;
+
+		res = KSI_AggregationHashChain_setAggrHashId(aggrChain, integer);
+		if (res != KSI_OK) goto response;
+		integer = NULL;
+
+		res = KSI_Integer_new(ctx, (KSI_uint64_t)roundTime, &integer);
+		if (res != KSI_OK) goto response;
+
+		res = KSI_AggregationHashChain_setAggregationTime(aggrChain, integer);
+		if (res != KSI_OK) goto response;
+		integer = NULL;
+
+		res = KSI_IntegerList_new(&chainIndex);
+		if (res != KSI_OK) goto response;
+
+		res = KSI_Integer_new(ctx, index, &integer);
+		if (res != KSI_OK) goto response;
+
+		res = KSI_IntegerList_append(chainIndex, integer);
+		if (res != KSI_OK) goto response;
+		integer = NULL;
+
+		res = KSI_AggregationHashChain_setChainIndex(aggrChain, chainIndex);
+		if (res != KSI_OK) goto response;
+		chainIndex = NULL;
+
+		res = KSI_AggregationHashChainList_new(&aggrChains);
+		if (res != KSI_OK) goto response;
+
+		res = KSI_AggregationHashChainList_append(aggrChains, aggrChain);
+		if (res != KSI_OK) goto response;
+		aggrChain = NULL;
+
+		res = KSI_AggregationResp_new(ctx, &resp);
+		if (res != KSI_OK) goto response;
+
+		res = KSI_AggregationResp_setAggregationChainList(resp, aggrChains);
+		if (res != KSI_OK) goto response;
+		aggrChains = NULL;
+
+		/* All the responses of the round share the same calendar chain. */
+		res = KSI_CalendarHashChain_ref(calChain);
+		if (res != KSI_OK) goto response;
+
+		res = KSI_AggregationResp_setCalendarChain(resp, calChain);
+		if (res != KSI_OK) {
+			KSI_CalendarHashChain_free(calChain);
+			goto response;
+		}
+
+		res = KSI_Integer_new(ctx, req->requestId, &integer);
+		if (res != KSI_OK) goto response;
+
+		res = KSI_AggregationResp_setRequestId(resp, integer);
+		if (res != KSI_OK) goto response;
+		integer = NULL;
+
+		res = KSI_Integer_new(ctx, 0, &integer);
+		if (res != KSI_OK) goto response;
+
+		res = KSI_AggregationResp_setStatus(resp, integer);
+		if (res != KSI_OK) goto response;
+		integer = NULL;
+
+		res = serializeAggregationResp(ctx, resp, &raw, &raw_len);
+		resp = NULL;
+
+response:
+
+		if (res != KSI_OK) {
+			KSI_free(raw);
+			raw = NULL;
+			serializeStatus(ctx, 0, req->requestId, 0x0200, "Unable to build the response.", &raw, &raw_len);
+		}
+
+		fillSlot(req->conn, req->slot, raw, raw_len, 0);
+
+		KSI_DataHash_free(hsh);
+		KSI_Integer_free(integer);
+		KSI_HashChainLink_free(link);
+		KSI_IntegerList_free(chainIndex);
+		KSI_HashChainLinkList_free(links);
+		KSI_AggregationHashChain_free(aggrChain);
+		KSI_AggregationHashChainList_free(aggrChains);
+		KSI_AggregationResp_free(resp);
+	}
+
+	res = KSI_OK;
+
+cleanup:
+
+	KSI_CalendarHashChain_free(calChain);
+	free(layer);
+	free(nodes);
+
+	return res;
+}
+
+static void *roundThread(void *arg) {
+	KSI_CTX *ctx = NULL;
+	unsigned long long start = nowMs();
+	unsigned long long n;
+
+	(void)arg;
+
+	if (KSI_CTX_new(&ctx) != KSI_OK) {
+		fprintf(stderr, "Unable to create KSI context.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (n = 0; ; n++) {
+		PendingReq *reqs = NULL;
+		size_t count;
+		unsigned long long now = nowMs();
+		unsigned long long closeAt = start + (n + 1) * conf.roundMs;
+		int res;
+
+		if (closeAt > now) {
+			struct timespec ts;
+			ts.tv_sec = (closeAt - now) / 1000;
+			ts.tv_nsec = (long)((closeAt - now) % 1000) * 1000000;
+			while (nanosleep(&ts, &ts) != 0 && errno == EINTR);
+		}
+
+		pthread_mutex_lock(&round_.lock);
+		reqs = round_.head;
+		count = round_.count;
+		round_.head = NULL;
+		round_.tail = NULL;
+		round_.count = 0;
+		pthread_mutex_unlock(&round_.lock);
+
+		res = closeRound(ctx, calendar.start + (time_t)n, reqs, count);
+		if (res != KSI_OK) {
+			fprintf(stderr, "Unable to close round %llu: %s\n", n, KSI_getErrorString(res));
+			exit(EXIT_FAILURE);
+		}
+
+		if (conf.verbose && count > 0) {
+			printf("Round %lld: %lu request(s).\n", (long long)(calendar.start + (time_t)n), (unsigned long)count);
+			fflush(stdout);
+		}
+
+		while (reqs != NULL) {
+			PendingReq *next = reqs->next;
+			free(reqs);
+			reqs = next;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Checks the login id and the HMAC of the request PDU.
+ */
+static int authenticate(KSI_Header *header, KSI_DataHash *hmac, void *pdu, int (*calculateHmac)(void *, KSI_HashAlgorithm, const char *, KSI_DataHash **)) {
+	int res = KSI_UNKNOWN_ERROR;
+	KSI_Utf8String *loginId = NULL;
+	KSI_HashAlgorithm algo_id;
+	KSI_DataHash *actual = NULL;
+
+	if (header == NULL || hmac == NULL) goto cleanup;
+
+	res = KSI_Header_getLoginId(header, &loginId);
+	if (res != KSI_OK || loginId == NULL || strcmp(KSI_Utf8String_cstr(loginId), conf.user) != 0) {
+		res = KSI_SERVICE_AUTHENTICATION_FAILURE;
+		goto cleanup;
+	}
+
+	res = KSI_DataHash_extract(hmac, &algo_id, NULL, NULL);
+	if (res != KSI_OK) goto cleanup;
+
+	res = calculateHmac(pdu, algo_id, conf.key, &actual);
+	if (res != KSI_OK) goto cleanup;
+
+	res = KSI_DataHash_equals(hmac, actual) ? KSI_OK : KSI_SERVICE_AUTHENTICATION_FAILURE;
+
+cleanup:
+
+	KSI_DataHash_free(actual);
+
+	return res;
+}
+
+static void handleAggregation(KSI_CTX *ctx, Connection *conn, Slot *slot, const unsigned char *raw, size_t raw_len) {
+	int res;
+	KSI_AggregationPdu *pdu = NULL;
+	KSI_Header *header = NULL;
+	KSI_DataHash *hmac = NULL;
+	KSI_AggregationReq *req = NULL;
+	KSI_Integer *requestId = NULL;
+	KSI_Integer *level = NULL;
+	KSI_DataHash *hsh = NULL;
+	const unsigned char *imprint = NULL;
+	size_t imprint_len = 0;
+	PendingReq *pending = NULL;
+	unsigned char *resp = NULL;
+	size_t resp_len = 0;
+	KSI_uint64_t id = 0;
+
+	res = KSI_AggregationPdu_parse(ctx, raw, raw_len, &pdu);
+	if (res == KSI_OK) res = KSI_AggregationPdu_getHeader(pdu, &header);
+	if (res == KSI_OK) res = KSI_AggregationPdu_getHmac(pdu, &hmac);
+	if (res == KSI_OK) res = KSI_AggregationPdu_getRequest(pdu, &req);
+	if (res != KSI_OK || req == NULL) {
+		STAT_INC(rejected);
+		serializeErrorPdu(ctx, 0, 0x0101, "Unable to parse the aggregation request.", &resp, &resp_len);
+		goto cleanup;
+	}
+
+	res = authenticate(header, hmac, pdu, (int (*)(void *, KSI_HashAlgorithm, const char *, KSI_DataHash **))KSI_AggregationPdu_calculateHmac);
+	if (res != KSI_OK) {
+		STAT_INC(rejected);
+		serializeErrorPdu(ctx, 0, 0x0102, "The request could not be authenticated.", &resp, &resp_len);
+		goto cleanup;
+	}
+
+	KSI_AggregationReq_getRequestId(req, &requestId);
+	KSI_AggregationReq_getRequestHash(req, &hsh);
+	KSI_AggregationReq_getRequestLevel(req, &level);
+	id = KSI_Integer_getUInt64(requestId);
+
+	if (hsh == NULL || KSI_DataHash_getImprint(hsh, &imprint, &imprint_len) != KSI_OK ||
+			KSI_Integer_getUInt64(level) > 0xff - MOCK_MAX_TREE_DEPTH) {
+		STAT_INC(rejected);
+		serializeStatus(ctx, 0, id, 0x0101, "Invalid request hash or level.", &resp, &resp_len);
+		goto cleanup;
+	}
+
+	if (chance(&conn->rand, conf.errorRate)) {
+		STAT_INC(injectedErrors);
+		serializeStatus(ctx, 0, id, 0x0300, "Injected upstream error.", &resp, &resp_len);
+		goto cleanup;
+	}
+
+	pending = calloc(1, sizeof(PendingReq));
+	if (pending == NULL) {
+		serializeStatus(ctx, 0, id, 0x0200, "Out of memory.", &resp, &resp_len);
+		goto cleanup;
+	}
+
+	pending->conn = conn;
+	pending->slot = slot;
+	pending->requestId = id;
+	memcpy(pending->imprint, imprint, imprint_len);
+	pending->imprint_len = imprint_len;
+	pending->level = (unsigned)KSI_Integer_getUInt64(level);
+
+	/* The latency starts with the request, the round may end later. */
+	slot->notBefore = responseTime(&conn->rand);
+
+	pthread_mutex_lock(&round_.lock);
+	if (round_.tail == NULL) {
+		round_.head = pending;
+	} else {
+		round_.tail->next = pending;
+	}
+	round_.tail = pending;
+	round_.count++;
+	pthread_mutex_unlock(&round_.lock);
+
+	STAT_INC(aggregated);
+
+	KSI_AggregationPdu_free(pdu);
+	return;
+
+cleanup:
+
+	fillSlot(conn, slot, resp, resp_len, responseTime(&conn->rand));
+	KSI_AggregationPdu_free(pdu);
+}
+
+static void handleExtension(KSI_CTX *ctx, Connection *conn, Slot *slot, const unsigned char *raw, size_t raw_len) {
+	int res;
+	KSI_ExtendPdu *pdu = NULL;
+	KSI_Header *header = NULL;
+	KSI_DataHash *hmac = NULL;
+	KSI_ExtendReq *req = NULL;
+	KSI_ExtendResp *extResp = NULL;
+	KSI_Integer *requestId = NULL;
+	KSI_Integer *aggrTime = NULL;
+	KSI_Integer *pubTime = NULL;
+	KSI_Integer *integer = NULL;
+	KSI_CalendarHashChain *chain = NULL;
+	unsigned char *resp = NULL;
+	size_t resp_len = 0;
+	KSI_uint64_t id = 0;
+	time_t last;
+	time_t from;
+	time_t to;
+
+	res = KSI_ExtendPdu_parse(ctx, raw, raw_len, &pdu);
+	if (res == KSI_OK) res = KSI_ExtendPdu_getHeader(pdu, &header);
+	if (res == KSI_OK) res = KSI_ExtendPdu_getHmac(pdu, &hmac);
+	if (res == KSI_OK) res = KSI_ExtendPdu_getRequest(pdu, &req);
+	if (res != KSI_OK || req == NULL) {
+		STAT_INC(rejected);
+		serializeErrorPdu(ctx, 1, 0x0101, "Unable to parse the extension request.", &resp, &resp_len);
+		goto cleanup;
+	}
+
+	res = authenticate(header, hmac, pdu, (int (*)(void *, KSI_HashAlgorithm, const char *, KSI_DataHash **))KSI_ExtendPdu_calculateHmac);
+	if (res != KSI_OK) {
+		STAT_INC(rejected);
+		serializeErrorPdu(ctx, 1, 0x0102, "The request could not be authenticated.", &resp, &resp_len);
+		goto cleanup;
+	}
+
+	KSI_ExtendReq_getRequestId(req, &requestId);
+	KSI_ExtendReq_getAggregationTime(req, &aggrTime);
+	KSI_ExtendReq_getPublicationTime(req, &pubTime);
+	id = KSI_Integer_getUInt64(requestId);
+
+	pthread_mutex_lock(&calendar.lock);
+	last = calendar.start + (time_t)calendar.leaves_len - 1;
+	pthread_mutex_unlock(&calendar.lock);
+
+	if (aggrTime == NULL) {
+		STAT_INC(rejected);
+		serializeStatus(ctx, 1, id, 0x0101, "Missing aggregation time.", &resp, &resp_len);
+		goto cleanup;
+	}
+
+	from = (time_t)KSI_Integer_getUInt64(aggrTime);
+	to = pubTime != NULL ? (time_t)KSI_Integer_getUInt64(pubTime) : last;
+
+	if (from < calendar.start) {
+		STAT_INC(rejected);
+		serializeStatus(ctx, 1, id, 0x0105, "The request time is before the start of the calendar.", &resp, &resp_len);
+		goto cleanup;
+	}
+
+	if (from > last || to > last) {
+		STAT_INC(rejected);
+		serializeStatus(ctx, 1, id, 0x0107, "The request time is in the future.", &resp, &resp_len);
+		goto cleanup;
+	}
+
+	if (from > to) {
+		STAT_INC(rejected);
+		serializeStatus(ctx, 1, id, 0x0104, "The aggregation time is after the publication time.", &resp, &resp_len);
+		goto cleanup;
+	}
+
+	if (chance(&conn->rand, conf.errorRate)) {
+		STAT_INC(injectedErrors);
+		serializeStatus(ctx, 1, id, 0x0300, "Injected upstream error.", &resp, &resp_len);
+		goto cleanup;
+	}
+
+	res = calendarChain(ctx, from, to, &chain);
+	if (res == KSI_OK) res = KSI_ExtendResp_new(ctx, &extResp);
+	if (res == KSI_OK) res = KSI_ExtendResp_setCalendarHashChain(extResp, chain);
+	if (res == KSI_OK) {
+		chain = NULL;
+		res = KSI_Integer_new(ctx, id, &integer);
+	}
+	if (res == KSI_OK) res = KSI_ExtendResp_setRequestId(extResp, integer);
+	if (res == KSI_OK) {
+		integer = NULL;
+		res = KSI_Integer_new(ctx, 0, &integer);
+	}
+	if (res == KSI_OK) res = KSI_ExtendResp_setStatus(extResp, integer);
+	if (res == KSI_OK) {
+		integer = NULL;
+		res = KSI_Integer_new(ctx, (KSI_uint64_t)last, &integer);
+	}
+	if (res == KSI_OK) res = KSI_ExtendResp_setLastTime(extResp, integer);
+	if (res == KSI_OK) {
+		integer = NULL;
+		res = serializeExtendResp(ctx, extResp, &resp, &resp_len);
+		extResp = NULL;
+	}
+	if (res != KSI_OK) {
+		KSI_free(resp);
+		resp = NULL;
+		serializeStatus(ctx, 1, id, 0x0200, "Unable to build the response.", &resp, &resp_len);
+		goto cleanup;
+	}
+
+	STAT_INC(extended);
+
+cleanup:
+
+	fillSlot(conn, slot, resp, resp_len, responseTime(&conn->rand));
+
+	KSI_Integer_free(integer);
+	KSI_CalendarHashChain_free(chain);
+	KSI_ExtendResp_free(extResp);
+	KSI_ExtendPdu_free(pdu);
+}
+
+/**
+ * Routes the PDU by its tag. Returns 0 if the connection must be closed.
+ */
+static int dispatch(KSI_CTX *ctx, Connection *conn, Slot *slot, const unsigned char *raw, size_t raw_len) {
+	unsigned tag;
+
+	if (chance(&conn->rand, conf.dropRate)) {
+		STAT_INC(dropped);
+		return 0;
+	}
+
+	tag = (raw_len >= 2 && (raw[0] & 0x80)) ? (((unsigned)raw[0] & 0x1f) << 8) | raw[1] : 0;
+
+	switch (tag) {
+		case AGGR_PDU_TAG:
+			handleAggregation(ctx, conn, slot, raw, raw_len);
+			return 1;
+		case EXT_PDU_TAG:
+			handleExtension(ctx, conn, slot, raw, raw_len);
+			return 1;
+		default:
+			STAT_INC(rejected);
+			if (!conn->isHttp) return 0;
+			slot->httpStatus = 400;
+			fillSlot(conn, slot, NULL, 0, 0);
+			return 1;
+	}
+}
+
+/**
+ * Closes the connection abruptly, the responses not written yet are discarded.
+ */
+static void dropConnection(Connection *conn) {
+	pthread_mutex_lock(&conn->lock);
+	conn->broken = 1;
+	pthread_mutex_unlock(&conn->lock);
+	shutdown(conn->fd, SHUT_RDWR);
+}
+
+static int writeAll(int fd, const unsigned char *buf, size_t len) {
+	while (len > 0) {
+		ssize_t c = send(fd, buf, len, MSG_NOSIGNAL);
+		if (c < 0) {
+			if (errno == EINTR) continue;
+			return 0;
+		}
+		buf += c;
+		len -= (size_t)c;
+	}
+	return 1;
+}
+
+static int writeSlot(Connection *conn, Slot *slot) {
+	char hdr[256];
+	int len;
+
+	if (conn->isHttp) {
+		const char *reason = slot->httpStatus == 200 ? "OK" : slot->httpStatus == 400 ? "Bad Request" : "Method Not Allowed";
+
+		len = snprintf(hdr, sizeof(hdr),
+				"HTTP/%u.%u %d %s\r\n"
+				"Content-Type: application/ksi-response\r\n"
+				"Content-Length: %lu\r\n"
+				"Connection: %s\r\n"
+				"\r\n",
+				slot->httpMajor, slot->httpMinor, slot->httpStatus, reason,
+				(unsigned long)slot->raw_len, slot->keepAlive ? "keep-alive" : "close");
+		if (!writeAll(conn->fd, (unsigned char *)hdr, (size_t)len)) return 0;
+	}
+
+	return slot->raw == NULL || writeAll(conn->fd, slot->raw, slot->raw_len);
+}
+
+/**
+ * Writes the responses of the connection when they are ready, closes and frees the
+ * connection after the reader has finished and all the responses are written.
+ */
+static void *writerThread(void *arg) {
+	Connection *conn = arg;
+
+	pthread_mutex_lock(&conn->lock);
+	for (;;) {
+		unsigned long long now = nowMs();
+		unsigned long long wake = 0;
+		Slot *prev = NULL;
+		Slot *slot = NULL;
+
+		for (slot = conn->head; slot != NULL; prev = slot, slot = slot->next) {
+			if (slot->filled && slot->notBefore <= now) break;
+			if (slot->filled && (wake == 0 || slot->notBefore < wake)) wake = slot->notBefore;
+			/* The HTTP responses must be written in the order of the requests. */
+			if (conn->isHttp) {
+				slot = NULL;
+				break;
+			}
+		}
+
+		if (slot != NULL) {
+			int broken = conn->broken;
+
+			if (prev == NULL) {
+				conn->head = slot->next;
+			} else {
+				prev->next = slot->next;
+			}
+			if (conn->tail == slot) conn->tail = prev;
+			pthread_mutex_unlock(&conn->lock);
+
+			if (!broken && !writeSlot(conn, slot)) broken = 1;
+			if (conn->isHttp && !slot->keepAlive) broken = 1;
+
+			free(slot->raw);
+			free(slot);
+
+			pthread_mutex_lock(&conn->lock);
+			if (broken) conn->broken = 1;
+			continue;
+		}
+
+		if (conn->readerDone && conn->head == NULL) break;
+
+		if (wake != 0) {
+			struct timespec ts;
+			clock_gettime(CLOCK_REALTIME, &ts);
+			ts.tv_sec += (time_t)((wake - now) / 1000);
+			ts.tv_nsec += (long)((wake - now) % 1000) * 1000000;
+			if (ts.tv_nsec >= 1000000000) {
+				ts.tv_sec++;
+				ts.tv_nsec -= 1000000000;
+			}
+			pthread_cond_timedwait(&conn->cond, &conn->lock, &ts);
+		} else {
+			pthread_cond_wait(&conn->cond, &conn->lock);
+		}
+	}
+	pthread_mutex_unlock(&conn->lock);
+
+	close(conn->fd);
+	pthread_mutex_destroy(&conn->lock);
+	pthread_cond_destroy(&conn->cond);
+	free(conn);
+
+	return NULL;
+}
+
+static void readTlv(KSI_CTX *ctx, Connection *conn) {
+	unsigned char *buf = NULL;
+	size_t len = 0;
+
+	buf = malloc(MOCK_MAX_PDU_LEN);
+	if (buf == NULL) return;
+
+	for (;;) {
+		size_t hdr_len;
+		size_t pdu_len;
+		ssize_t c;
+
+		/* Consume all the complete PDUs in the buffer. */
+		while (len >= 2) {
+			Slot *slot = NULL;
+
+			hdr_len = (buf[0] & 0x80) ? 4 : 2;
+			if (len < hdr_len) break;
+			pdu_len = hdr_len + (hdr_len == 4 ? ((size_t)buf[2] << 8) | buf[3] : buf[1]);
+			if (len < pdu_len) break;
+
+			slot = addSlot(conn);
+			if (slot == NULL || !dispatch(ctx, conn, slot, buf, pdu_len)) {
+				if (slot != NULL) fillSlot(conn, slot, NULL, 0, 0);
+				dropConnection(conn);
+				goto cleanup;
+			}
+
+			memmove(buf, buf + pdu_len, len - pdu_len);
+			len -= pdu_len;
+		}
+
+		c = recv(conn->fd, buf + len, MOCK_MAX_PDU_LEN - len, 0);
+		if (c < 0 && errno == EINTR) continue;
+		if (c <= 0) break;
+		len += (size_t)c;
+	}
+
+cleanup:
+
+	free(buf);
+}
+
+typedef struct {
+	unsigned char *body;
+	size_t body_len;
+	size_t body_size;
+	int complete;
+} HttpRequest;
+
+static int onMessageBegin(http_parser *parser) {
+	HttpRequest *req = parser->data;
+	req->body_len = 0;
+	return 0;
+}
+
+static int onBody(http_parser *parser, const char *at, size_t length) {
+	HttpRequest *req = parser->data;
+
+	if (req->body_len + length > MOCK_MAX_PDU_LEN) return 1;
+
+	if (req->body_len + length > req->body_size) {
+		unsigned char *tmp = realloc(req->body, req->body_len + length);
+		if (tmp == NULL) return 1;
+		req->body = tmp;
+		req->body_size = req->body_len + length;
+	}
+
+	memcpy(req->body + req->body_len, at, length);
+	req->body_len += length;
+
+	return 0;
+}
+
+static int onMessageComplete(http_parser *parser) {
+	HttpRequest *req = parser->data;
+	req->complete = 1;
+	/* Handle one request at a time, so the slots are added in order. */
+	http_parser_pause(parser, 1);
+	return 0;
+}
+
+static void readHttp(KSI_CTX *ctx, Connection *conn) {
+	http_parser parser;
+	http_parser_settings settings;
+	HttpRequest req;
+	char buf[0x4000];
+	int open = 1;
+
+	memset(&settings, 0, sizeof(settings));
+	settings.on_message_begin = onMessageBegin;
+	settings.on_body = onBody;
+	settings.on_message_complete = onMessageComplete;
+
+	memset(&req, 0, sizeof(req));
+	http_parser_init(&parser, HTTP_REQUEST);
+	parser.data = &req;
+
+	while (open) {
+		ssize_t c = recv(conn->fd, buf, sizeof(buf), 0);
+		size_t off = 0;
+
+		if (c < 0 && errno == EINTR) continue;
+		if (c <= 0) break;
+
+		while (open && off < (size_t)c) {
+			off += http_parser_execute(&parser, &settings, buf + off, (size_t)c - off);
+
+			if (HTTP_PARSER_ERRNO(&parser) == HPE_PAUSED) {
+				http_parser_pause(&parser, 0);
+			} else if (HTTP_PARSER_ERRNO(&parser) != HPE_OK) {
+				open = 0;
+				break;
+			}
+
+			if (req.complete) {
+				Slot *slot = addSlot(conn);
+
+				req.complete = 0;
+				if (slot == NULL) {
+					open = 0;
+					break;
+				}
+
+				slot->httpMajor = parser.http_major;
+				slot->httpMinor = parser.http_minor;
+				slot->keepAlive = http_should_keep_alive(&parser);
+				if (!slot->keepAlive) open = 0;
+
+				if (parser.method != HTTP_POST) {
+					slot->httpStatus = 405;
+					fillSlot(conn, slot, NULL, 0, 0);
+				} else if (!dispatch(ctx, conn, slot, req.body, req.body_len)) {
+					fillSlot(conn, slot, NULL, 0, 0);
+					dropConnection(conn);
+					open = 0;
+				}
+			}
+		}
+	}
+
+	free(req.body);
+}
+
+static void *readerThread(void *arg) {
+	Connection *conn = arg;
+	KSI_CTX *ctx = NULL;
+	pthread_t writer;
+
+	if (pthread_create(&writer, NULL, writerThread, conn) != 0) {
+		close(conn->fd);
+		free(conn);
+		return NULL;
+	}
+	pthread_detach(writer);
+
+	if (KSI_CTX_new(&ctx) == KSI_OK) {
+		if (conn->isHttp) {
+			readHttp(ctx, conn);
+		} else {
+			readTlv(ctx, conn);
+		}
+	}
+
+	/* The connection belongs to the writer from now on. */
+	pthread_mutex_lock(&conn->lock);
+	conn->readerDone = 1;
+	pthread_cond_signal(&conn->cond);
+	pthread_mutex_unlock(&conn->lock);
+
+	KSI_CTX_free(ctx);
+
+	return NULL;
+}
+
+static int listenOn(unsigned port, unsigned *bound) {
+	struct sockaddr_in addr;
+	socklen_t addr_len = sizeof(addr);
+	int fd;
+	int on = 1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons((unsigned short)port);
+	if (inet_pton(AF_INET, conf.bindAddr, &addr.sin_addr) != 1) {
+		fprintf(stderr, "Invalid bind address: %s\n", conf.bindAddr);
+		return -1;
+	}
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0) return -1;
+
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 128) != 0 ||
+			getsockname(fd, (struct sockaddr *)&addr, &addr_len) != 0) {
+		perror("Unable to listen");
+		close(fd);
+		return -1;
+	}
+
+	*bound = ntohs(addr.sin_port);
+
+	return fd;
+}
+
+static void onSignal(int sig) {
+	(void)sig;
+	stopped = 1;
+}
+
+static void usage(const char *prog) {
+	fprintf(stderr,
+			"Usage: %s [-t port] [-H port] [options]\n"
+			"Local stand-in for the KSI aggregator and extender.\n"
+			"\n"
+			"  -t port   Listen for TLV requests over TCP (ksi+tcp:// URLs), 0 picks a free port.\n"
+			"  -H port   Listen for requests posted over HTTP (http:// URLs), 0 picks a free port.\n"
+			"  -b addr   IPv4 address to listen on (default 127.0.0.1).\n"
+			"  -u user   Login id of the clients (default anon).\n"
+			"  -k key    HMAC key of the clients (default anon).\n"
+			"  -r ms     Length of an aggregation round (default 1000). Shorter rounds make the\n"
+			"            calendar run ahead of the clock, as each round is one calendar second.\n"
+			"  -l ms     Minimum latency of the responses (default 0).\n"
+			"  -j ms     Random latency added on top of -l (default 0).\n"
+			"  -e pct    Percentage of requests answered with an upstream error (default 0).\n"
+			"  -d pct    Percentage of requests answered by closing the connection (default 0).\n"
+			"  -s seed   Seed of the placeholder values and the injected faults (default 0).\n"
+			"  -v        Print the size of every round.\n",
+			prog);
+}
+
+int main(int argc, char **argv) {
+	int res = EXIT_FAILURE;
+	struct pollfd fds[2];
+	int isHttp[2];
+	unsigned nfds = 0;
+	unsigned i;
+	unsigned bound;
+	unsigned connId = 0;
+	pthread_t roundTid;
+	struct sigaction sa;
+	int c;
+
+	while ((c = getopt(argc, argv, "t:H:b:u:k:r:l:j:e:d:s:v")) != -1) {
+		switch (c) {
+			case 't': conf.tcpPort = (unsigned)atoi(optarg); conf.tcp = 1; break;
+			case 'H': conf.httpPort = (unsigned)atoi(optarg); conf.http = 1; break;
+			case 'b': conf.bindAddr = optarg; break;
+			case 'u': conf.user = optarg; break;
+			case 'k': conf.key = optarg; break;
+			case 'r': conf.roundMs = (unsigned)atoi(optarg); break;
+			case 'l': conf.latencyMs = (unsigned)atoi(optarg); break;
+			case 'j': conf.jitterMs = (unsigned)atoi(optarg); break;
+			case 'e': conf.errorRate = atof(optarg); break;
+			case 'd': conf.dropRate = atof(optarg); break;
+			case 's': conf.seed = (unsigned)atoi(optarg); break;
+			case 'v': conf.verbose = 1; break;
+			default:
+				usage(argv[0]);
+				goto cleanup;
+		}
+	}
+
+	if ((!conf.tcp && !conf.http) || conf.roundMs == 0) {
+		usage(argv[0]);
+		goto cleanup;
+	}
+
+	if (conf.tcp) isHttp[nfds++] = 0;
+	if (conf.http) isHttp[nfds++] = 1;
+
+	for (i = 0; i < nfds; i++) {
+		fds[i].fd = listenOn(isHttp[i] ? conf.httpPort : conf.tcpPort, &bound);
+		if (fds[i].fd < 0) goto cleanup;
+		fds[i].events = POLLIN;
+
+		printf("Listening for %s requests on %s:%u\n", isHttp[i] ? "HTTP" : "TCP", conf.bindAddr, bound);
+	}
+	fflush(stdout);
+
+	pthread_mutex_init(&calendar.lock, NULL);
+	pthread_mutex_init(&round_.lock, NULL);
+	pthread_mutex_init(&stats.lock, NULL);
+	calendar.start = time(NULL);
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = onSignal;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	if (pthread_create(&roundTid, NULL, roundThread, NULL) != 0) {
+		fprintf(stderr, "Unable to start the round thread.\n");
+		goto cleanup;
+	}
+	pthread_detach(roundTid);
+
+	while (!stopped) {
+		/* Wake up now and then to notice the signals. */
+		if (poll(fds, nfds, 500) <= 0) continue;
+
+		for (i = 0; i < nfds; i++) {
+			Connection *conn = NULL;
+			pthread_t reader;
+			int fd;
+			int on = 1;
+
+			if (!(fds[i].revents & POLLIN)) continue;
+
+			fd = accept(fds[i].fd, NULL, NULL);
+			if (fd < 0) continue;
+
+			setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+			conn = calloc(1, sizeof(Connection));
+			if (conn == NULL) {
+				close(fd);
+				continue;
+			}
+
+			conn->fd = fd;
+			conn->isHttp = isHttp[i];
+			conn->rand = conf.seed + ++connId;
+			pthread_mutex_init(&conn->lock, NULL);
+			pthread_cond_init(&conn->cond, NULL);
+
+			if (pthread_create(&reader, NULL, readerThread, conn) != 0) {
+				close(fd);
+				free(conn);
+				continue;
+			}
+			pthread_detach(reader);
+
+			STAT_INC(connections);
+		}
+	}
+
+	pthread_mutex_lock(&stats.lock);
+	printf("Connections: %llu, aggregated: %llu, extended: %llu, injected errors: %llu, dropped: %llu, rejected: %llu\n",
+			stats.connections, stats.aggregated, stats.extended, stats.injectedErrors, stats.dropped, stats.rejected);
+	pthread_mutex_unlock(&stats.lock);
+
+	res = EXIT_SUCCESS;
+
+cleanup:
+
+	return res;
+}
@@ -186,6 +186,62 @@ static void testValidExtenderTcpUri(CuTest* tc) {
 	KSI_UriClient_free(uri);
 }
 
+static void testAddAggregators(CuTest* tc) {
+	int res;
+	KSI_UriClient *uri = NULL;
+	KSI_Config *conf = NULL;
+	KSI_LIST(KSI_Utf8String) *parentUri = NULL;
+	KSI_Utf8String *str = NULL;
+	size_t i;
+
+	res = KSI_UriClient_new(ctx, &uri);
+	CuAssert(tc, "Unable to create URI client.", res == KSI_OK && uri != NULL);
+
+	res = KSI_UriClient_addAggregator(uri, validHttpUri[0], "dummy", "dummy");
+	CuAssert(tc, "Unable to add the first aggregator.", res == KSI_OK);
+	CuAssert(tc, "The first aggregator should be the primary endpoint.", uri->aggregators.count == 1 && uri->aggregators.endpoints[0].client == NULL);
+	CuAssert(tc, "Aggregator client should be the HTTP client", uri->pAggregationClient == (KSI_NetworkClient *)uri->httpClient);
+
+	res = KSI_UriClient_addAggregator(uri, validTcpUri[0], "dummy", "dummy");
+	CuAssert(tc, "Unable to add a TCP aggregator.", res == KSI_OK && uri->aggregators.count == 2);
+	CuAssert(tc, "Additional endpoint should have its own client.", uri->aggregators.endpoints[1].client != NULL);
+	CuAssert(tc, "Primary aggregator should not change.", uri->pAggregationClient == (KSI_NetworkClient *)uri->httpClient);
+
+	res = KSI_UriClient_addAggregator(uri, invalidUri[0], "dummy", "dummy");
+	CuAssert(tc, "Invalid aggregator URI should fail.", res != KSI_OK && uri->aggregators.count == 2);
+
+	res = KSI_UriClient_setAggregator(uri, validHttpUri[1], "dummy", "dummy");
+	CuAssert(tc, "Setting the aggregator should remove the added endpoints.", res == KSI_OK && uri->aggregators.count == 1);
+
+	/* Seed the aggregators from the configuration. */
+	res = KSI_Config_new(ctx, &conf);
+	CuAssert(tc, "Unable to create configuration.", res == KSI_OK && conf != NULL);
+
+	res = KSI_Utf8StringList_new(&parentUri);
+	CuAssert(tc, "Unable to create URI list.", res == KSI_OK && parentUri != NULL);
+
+	for (i = 0; i < 2; i++) {
+		res = KSI_Utf8String_new(ctx, validHttpUri[i + 2], strlen(validHttpUri[i + 2]) + 1, &str);
+		CuAssert(tc, "Unable to create URI string.", res == KSI_OK && str != NULL);
+
+		res = KSI_Utf8StringList_append(parentUri, str);
+		CuAssert(tc, "Unable to append URI.", res == KSI_OK);
+		str = NULL;
+	}
+
+	res = KSI_Config_setParentUri(conf, parentUri);
+	CuAssert(tc, "Unable to set parent URIs.", res == KSI_OK);
+
+	res = KSI_UriClient_addAggregatorsFromConfig(uri, conf, "dummy", "dummy");
+	CuAssert(tc, "Unable to add aggregators from configuration.", res == KSI_OK && uri->aggregators.count == 3);
+
+	res = KSI_UriClient_setHedging(uri, 1);
+	CuAssert(tc, "Unable to enable hedging.", res == KSI_OK && uri->hedging);
+
+	KSI_Config_free(conf);
+	KSI_UriClient_free(uri);
+}
+
 static void testInvalidExtenderUri(CuTest* tc) {
 	int res;
 	KSI_UriClient *uri = NULL;
@@ -248,6 +304,7 @@ CuSuite* KSITest_uriClient_getSuite(void) {
 	SUITE_ADD_TEST(suite, testValidExtenderTcpUri);
 	SUITE_ADD_TEST(suite, testInvalidExtenderUri);
 	SUITE_ADD_TEST(suite, testInvalidAggregatorUri);
+	SUITE_ADD_TEST(suite, testAddAggregators);
 
 	return suite;
 }